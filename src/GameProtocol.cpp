@@ -2,47 +2,51 @@
 #include "room.h"
 #include "server.h"
 #include "roomManager.h"
-#include <iostream>
+#include "logger.h"
 #include <algorithm>
+#include <cctype>
 
 GameProtocol::GameProtocol(Server* server)
     : server_(server) {
 }
 
 void GameProtocol::handleCommand(const std::string& username, const std::string& msg, const std::string& channel) {
-    std::cout << "[DEBUG] GameProtocol::handleCommand called with username: " << username << ", msg: " << msg << ", channel: " << channel << std::endl;
+    LOG_TRACE("PROTO", LogFields().room(channel).user(username), "Command: ", msg);
     
     if (!server_) {
-        std::cout << "[DEBUG] No server set in GameProtocol!" << std::endl;
+        LOG_ERROR("PROTO", "No server set in GameProtocol!");
         return;
     }
         
     // Get the current room for this channel
-    Room* room = server_->getRoomManager().getCurrentRoom(channel);
+    std::shared_ptr<Room> room = server_->getRoomManager().getCurrentRoom(channel);
     if (!room) {
-        std::cout << "[TWITCH] No mapped room for Twitch channel: " << channel << std::endl;
+        LOG_DEBUG("TWITCH", "No mapped room for Twitch channel: ", channel);
         return;
     }
-    std::cout << "[DEBUG] Found current room for channel " << channel << std::endl;
 
+    // Commands are matched case-insensitively; guesses go on as typed and
+    // the room's GuessMatcher does the Unicode-aware folding.
     std::string lower = msg;
-    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
 
     // --- Join ---
     if (lower.rfind("!join", 0) == 0) {
-        std::cout << "[PROTO] " << username << " joined the game\n";
+        LOG_INFO("PROTO", LogFields().room(channel).user(username), "Joined the game");
         room->join(nullptr, username); // Twitch users have no Session - this will broadcast the join message
         return;
     }
 
     // --- Guess ---
     if (lower.rfind("!guess ", 0) == 0) {
-        std::string guess = lower.substr(7);
-        std::cout << "[PROTO] " << username << " guessed: " << guess << "\n";
+        if (!server_->getRoomManager().allowInput(*room, "u" + username, RateClass::guess)) return;
+        std::string guess = msg.substr(7);
+        LOG_TRACE("PROTO", LogFields().room(channel).user(username), "Guessed: ", guess);
         if (room) {
             room->handleGuess(username, guess);
         } else {
-            std::cout << "[ERROR] Room is null when processing guess from " << username << std::endl;
+            LOG_ERROR("PROTO", LogFields().user(username), "Room is null when processing guess");
         }
         return;
     }
@@ -50,11 +54,12 @@ void GameProtocol::handleCommand(const std::string& username, const std::string&
     // --- Start round (streamer only) ---
     if (lower == "!start") {
         std::string word = ""; // TODO: fetch from FastAPI
-        std::cout << "[PROTO] Starting round with word: " << word << "\n";
+        LOG_INFO("PROTO", LogFields().room(channel), "Starting round");
         room->startRound(word);
         return;
     }
 
     // --- Fallback: treat any message as a guess attempt ---
-    room->handleGuess(username, lower);
+    if (!server_->getRoomManager().allowInput(*room, "u" + username, RateClass::guess)) return;
+    room->handleGuess(username, msg);
 }
@@ -1,60 +1,126 @@
 ﻿#include "TwitchBotManager.h"
 #include "TwitchClient.h"
 #include "server.h"
-#include <iostream>
+#include "logger.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cctype>
+
+namespace {
+// Twitch names channels "#name" in lower case, and echoes them that way.
+std::string normalizeChannel(const std::string& channel) {
+    std::string name = channel;
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (name.empty() || name[0] != '#') name.insert(name.begin(), '#');
+    return name;
+}
+}
 
 bool TwitchBotManager::spawnBot(const std::string& oauth,
     const std::string& nick,
     const std::string& channel) {
-    auto it = m_bots.find(channel);
-    if (it != m_bots.end()) {
-        std::cout << "[WARN] Bot for channel " << channel
-            << " already exists, ignoring spawn.\n";
+    std::string name = normalizeChannel(channel);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_channels.find(name);
+    if (it != m_channels.end()) {
+        LOG_WARN("TWITCH", "Bot for channel ", name, " already exists, ignoring spawn");
         return false;
     }
 
-    auto bot = std::make_shared<TwitchClient>(m_io, m_server, oauth, nick, channel);
-
-    // attach GameProtocol
-    if (gameProtocol_) {
-        bot->setGameProtocol(gameProtocol_);
-    }
+    ConnectionPtr conn = pick(oauth, nick);
+    if (!conn) conn = open(oauth, nick);
+    assign(conn, name);
 
-    m_bots[channel] = bot;
-    bot->connect();
-
-    std::cout << "[INFO] Bot spawned for channel " << channel << "\n";
+    LOG_INFO("TWITCH", "Bot spawned for channel ", name, " (", conn->channels.size(), " on its connection)");
     return true;
 }
 
 void TwitchBotManager::stopBot(const std::string& channel) {
-    auto it = m_bots.find(channel);
-    if (it != m_bots.end()) {
-        std::cout << "[INFO] Stopping bot for channel " << channel << "\n";
-        it->second->disconnect();
-        m_bots.erase(it);
+    std::string name = normalizeChannel(channel);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_channels.find(name);
+    if (it != m_channels.end()) {
+        LOG_INFO("TWITCH", "Stopping bot for channel ", name);
+        ConnectionPtr conn = it->second;
+        release(conn, name);
+        if (conn->channels.empty()) close(conn);
     }
     else {
-        std::cout << "[WARN] Tried to stop bot for channel "
-            << channel << " but none exists.\n";
+        LOG_WARN("TWITCH", "Tried to stop bot for channel ", name, " but none exists");
+    }
+}
+
+
+TwitchBotManager::ConnectionPtr TwitchBotManager::pick(const std::string& oauth, const std::string& nick, const Connection* except) {
+    // The fullest live connection with room: new channels fill existing
+    // sockets before opening another.
+    std::size_t limit = std::max<std::size_t>(1, TwitchClient::defaults().channelsPerConnection);
+    ConnectionPtr best;
+    for (const auto& conn : m_pool) {
+        if (conn.get() == except || !conn->up || conn->channels.size() >= limit) continue;
+        if (conn->oauth != oauth || conn->nick != nick) continue;
+        if (!best || conn->channels.size() > best->channels.size()) best = conn;
     }
+    return best;
 }
 
-void TwitchBotManager::setCurrentRoom(const std::string& channel, const std::string& roomName) {
-    std::cout << "[DEBUG] setCurrentRoom called for channel: " << channel << ", room: " << roomName << std::endl;
-    std::cout << "[DEBUG] m_bots size: " << m_bots.size() << std::endl;
-    for (auto& pair : m_bots) {
-        std::cout << "[DEBUG] Bot in map: " << pair.first << std::endl;
+TwitchBotManager::ConnectionPtr TwitchBotManager::open(const std::string& oauth, const std::string& nick) {
+    auto conn = std::make_shared<Connection>();
+    conn->oauth = oauth;
+    conn->nick = nick;
+    conn->client = std::make_shared<TwitchClient>(m_io, m_server, oauth, nick);
+
+    // attach GameProtocol
+    if (gameProtocol_) {
+        conn->client->setGameProtocol(gameProtocol_);
     }
-    
-    auto it = m_bots.find(channel);
-    if (it != m_bots.end()) {
-        it->second->setCurrentRoom(channel, roomName);
-        std::cout << "[DEBUG] Set current room for channel " << channel
-            << " to: " << roomName << std::endl;
+    std::weak_ptr<Connection> weak = conn;
+    conn->client->setStateHandler([this, weak](bool up) { onState(weak, up); });
+
+    m_pool.push_back(conn);
+    Metrics::instance().ircConnections.fetch_add(1, std::memory_order_relaxed);
+    conn->client->connect();
+    return conn;
+}
+
+void TwitchBotManager::assign(const ConnectionPtr& conn, const std::string& channel) {
+    conn->channels.push_back(channel);
+    m_channels[channel] = conn;
+    conn->client->join(channel);
+}
+
+void TwitchBotManager::release(const ConnectionPtr& conn, const std::string& channel) {
+    conn->channels.erase(std::remove(conn->channels.begin(), conn->channels.end(), channel), conn->channels.end());
+    m_channels.erase(channel);
+    conn->client->part(channel);
+}
+
+void TwitchBotManager::close(const ConnectionPtr& conn) {
+    conn->client->disconnect();
+    m_pool.erase(std::remove(m_pool.begin(), m_pool.end(), conn), m_pool.end());
+    Metrics::instance().ircConnections.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void TwitchBotManager::onState(const std::weak_ptr<Connection>& weak, bool up) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ConnectionPtr conn = weak.lock();
+    if (!conn || std::find(m_pool.begin(), m_pool.end(), conn) == m_pool.end()) return;
+    conn->up = up;
+    if (up) return;
+
+    // Its channels are dark until it reconnects: move what fits elsewhere.
+    std::vector<std::string> channels = conn->channels;
+    std::size_t moved = 0;
+    for (const auto& channel : channels) {
+        ConnectionPtr target = pick(conn->oauth, conn->nick, conn.get());
+        if (!target) break;
+        release(conn, channel);
+        assign(target, channel);
+        ++moved;
     }
-    else {
-        std::cout << "[WARN] No bot found for channel " << channel
-            << " when setting room " << roomName << std::endl;
+    if (moved) {
+        Metrics::instance().ircChannelsMoved.fetch_add(moved, std::memory_order_relaxed);
+        LOG_INFO("TWITCH", "Moved ", moved, " of ", channels.size(), " channels off a lost connection for ", conn->nick);
     }
+    if (conn->channels.empty()) close(conn);
 }
@@ -1,13 +1,21 @@
 ﻿#pragma once
 #include <unordered_map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "TwitchClient.h"
 #include "server.h"
 #include "GameProtocol.h"
 
 class Server;
 
+// Schedules channels onto a pool of TwitchClient connections. Channels
+// sharing a login (oauth and nick) share connections, up to
+// TwitchOptions::channelsPerConnection each; a connection is opened when
+// every one is full and closed when its last channel leaves. When a
+// connection goes down, its channels move to live connections with room to
+// spare, and whatever does not fit waits for it to reconnect.
 class TwitchBotManager {
 public:
     TwitchBotManager(boost::asio::io_context& io, Server& server)
@@ -18,14 +26,33 @@ public:
         const std::string& nick,
         const std::string& channel);
     void stopBot(const std::string& channel);
-    void setCurrentRoom(const std::string& channel, const std::string& roomName);
 
     // attach a shared GameProtocol to all bots
     void setGameProtocol(std::shared_ptr<GameProtocol> gp) { gameProtocol_ = gp; }
 
 private:
+    struct Connection {
+        std::shared_ptr<TwitchClient> client;
+        std::string oauth;
+        std::string nick;
+        std::vector<std::string> channels;
+        bool up = true; // until it reports otherwise
+    };
+    using ConnectionPtr = std::shared_ptr<Connection>;
+
+    // Under m_mutex.
+    ConnectionPtr pick(const std::string& oauth, const std::string& nick, const Connection* except = nullptr);
+    ConnectionPtr open(const std::string& oauth, const std::string& nick);
+    void assign(const ConnectionPtr& conn, const std::string& channel);
+    void release(const ConnectionPtr& conn, const std::string& channel);
+    void close(const ConnectionPtr& conn);
+
+    void onState(const std::weak_ptr<Connection>& weak, bool up); // from the connection's strand
+
     boost::asio::io_context& m_io;
     Server& m_server;
-    std::unordered_map<std::string, std::shared_ptr<TwitchClient>> m_bots;
+    std::mutex m_mutex;
+    std::vector<ConnectionPtr> m_pool;
+    std::unordered_map<std::string, ConnectionPtr> m_channels; // "#name" -> its connection
     std::shared_ptr<GameProtocol> gameProtocol_; // NEW
 };
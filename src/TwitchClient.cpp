@@ -1,166 +1,425 @@
 ﻿#include "TwitchClient.h"
 #include "server.h"
-#include <iostream>
+#include "logger.h"
+#include "ircMessage.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cctype>
+#include <random>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 
+namespace {
+TwitchOptions g_defaults; // written once by main before any io thread starts
+
+std::mt19937& engine() {
+    thread_local std::mt19937 rng{ std::random_device{}() };
+    return rng;
+}
+
+bool sameNick(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](unsigned char x, unsigned char y) {
+        return std::tolower(x) == std::tolower(y);
+    });
+}
+}
+
+TwitchClient::Link::Link(const boost::asio::strand<boost::asio::io_context::executor_type>& strand, const IrcSendOptions& send)
+    : socket(strand),
+    outbox(send),
+    sendTimer(strand) {
+}
+
 TwitchClient::TwitchClient(boost::asio::io_context& io,
     Server& server,
     const std::string& oauth,
-    const std::string& nick,
-    const std::string& channel)
-    : m_resolver(io),
-    m_socket(io),
+    const std::string& nick)
+    : m_strand(boost::asio::make_strand(io)),
+    m_resolver(m_strand),
+    m_reconnectTimer(m_strand),
     m_server(server),
     m_oauth(oauth),
-    m_nick(nick),
-    m_channel(channel),
-    m_channelRooms() {
+    m_nick(nick) {
 }
 
 void TwitchClient::connect() {
     auto self = shared_from_this();
-    auto endpoints = m_resolver.resolve("irc.chat.twitch.tv", "6667");
-    boost::asio::async_connect(m_socket, endpoints,
-        [self](boost::system::error_code ec, const auto&) {
-            if (!ec) {
-                self->login();
-            }
-            else {
-                std::cerr << "Twitch connect error: " << ec.message() << "\n";
+    boost::asio::dispatch(m_strand, [self]() {
+        if (!self->m_closing && !self->m_link && !self->m_pending) self->openLink();
+    });
+}
+
+void TwitchClient::openLink() {
+    auto link = std::make_shared<Link>(m_strand, g_defaults.send);
+    m_pending = link;
+    if (m_link) Metrics::instance().ircReconnectAttempts.fetch_add(1, std::memory_order_relaxed);
+
+    auto self = shared_from_this();
+    m_resolver.async_resolve(g_defaults.host, g_defaults.port,
+        [self, link](boost::system::error_code ec, boost::asio::ip::tcp::resolver::results_type endpoints) {
+            if (link->dead) return;
+            if (ec) {
+                self->linkFailed(link, "Resolve", ec);
+                return;
             }
+            boost::asio::async_connect(link->socket, endpoints,
+                [self, link](boost::system::error_code ec, const auto&) {
+                    if (link->dead) return;
+                    if (ec) {
+                        self->linkFailed(link, "Connect", ec);
+                        return;
+                    }
+                    self->login(link);
+                });
         });
 }
 
-void TwitchClient::login() {
+void TwitchClient::login(const LinkPtr& link) {
+    link->connected = true;
+
+    // The JOINs rejoin every channel after a reconnect as well.
+    link->outbox.push(IrcPriority::control, "CAP REQ :twitch.tv/tags twitch.tv/commands twitch.tv/membership");
+    link->outbox.push(IrcPriority::control, "PASS " + m_oauth);
+    link->outbox.push(IrcPriority::control, "NICK " + m_nick);
+    for (const auto& channel : m_channels)
+        link->outbox.push(IrcPriority::join, "JOIN " + channel);
+    pump(link);
+
+    doRead(link);
+}
+
+void TwitchClient::join(const std::string& channel) {
+    auto self = shared_from_this();
+    boost::asio::dispatch(m_strand, [self, channel]() {
+        if (self->m_closing || !self->m_channels.insert(channel).second) return;
+        self->pushLive(IrcPriority::join, "JOIN " + channel);
+    });
+}
+
+void TwitchClient::part(const std::string& channel) {
     auto self = shared_from_this();
-    m_buffer.consume(m_buffer.size());
+    boost::asio::dispatch(m_strand, [self, channel]() {
+        if (!self->m_channels.erase(channel)) return;
+        self->pushLive(IrcPriority::control, "PART " + channel);
+        for (const LinkPtr& link : { self->m_link, self->m_pending, self->m_retiring })
+            if (link) link->joined.erase(channel);
+        self->maybeRetire();
+    });
+}
+
+void TwitchClient::say(const std::string& channel, const std::string& text) {
+    // One line per announcement: a CR or LF would start a command of its own.
+    std::string line = "PRIVMSG " + channel + " :" + text;
+    std::replace_if(line.begin(), line.end(), [](char c) { return c == '\r' || c == '\n'; }, ' ');
+    send(std::move(line), IrcPriority::chat);
+}
 
-    send("CAP REQ :twitch.tv/tags twitch.tv/commands twitch.tv/membership\r\n");
-    send("PASS " + m_oauth + "\r\n");
-    send("NICK " + m_nick + "\r\n");
-    send("JOIN " + m_channel + "\r\n");
+void TwitchClient::send(std::string line, IrcPriority priority) {
+    auto self = shared_from_this();
+    boost::asio::dispatch(m_strand, [self, line = std::move(line), priority]() mutable {
+        if (self->m_closing && priority != IrcPriority::control) return;
+        // While m_link is down its queue keeps filling; the replacement
+        // adopts it once logged in.
+        const LinkPtr& link = self->m_link ? self->m_link : self->m_pending;
+        if (!link) return;
+        if (!link->outbox.push(priority, std::move(line)))
+            Metrics::instance().ircChatDropped.fetch_add(1, std::memory_order_relaxed);
+        self->pump(link);
+    });
+}
 
-    doRead();
+void TwitchClient::pushLive(IrcPriority priority, const std::string& line) {
+    // A link that has not logged in yet sends the channel list on login.
+    for (const LinkPtr& link : { m_link, m_pending }) {
+        if (!link || !link->connected || link->dead || link->closing) continue;
+        link->outbox.push(priority, line);
+        pump(link);
+    }
 }
 
-void TwitchClient::send(const std::string& msg) {
+void TwitchClient::pump(const LinkPtr& link) {
+    if (!link->connected || link->dead || link->writing) return;
+
+    IrcSendQueue::Clock::duration retryIn;
+    std::size_t lines = link->outbox.take(IrcSendQueue::Clock::now(), link->writeBuffer, retryIn);
+    if (lines == 0) {
+        if (retryIn > IrcSendQueue::Clock::duration::zero()) {
+            if (link->timerArmed) return;
+            link->timerArmed = true;
+            Metrics::instance().ircThrottled.fetch_add(1, std::memory_order_relaxed);
+            auto self = shared_from_this();
+            link->sendTimer.expires_after(retryIn);
+            link->sendTimer.async_wait([self, link](boost::system::error_code ec) {
+                link->timerArmed = false;
+                if (!ec) self->pump(link);
+            });
+        }
+        else if (link->closing) {
+            // QUIT is out.
+            closeLink(link);
+            if (link == m_link) LOG_INFO("TWITCH", "Disconnected ", m_nick);
+        }
+        return;
+    }
+
+    link->writing = true;
     auto self = shared_from_this();
-    auto buffer = std::make_shared<std::string>(msg);
-    boost::asio::async_write(m_socket, boost::asio::buffer(*buffer),
-        [self, buffer](boost::system::error_code ec, std::size_t) {
+    boost::asio::async_write(link->socket, boost::asio::buffer(link->writeBuffer),
+        [self, link, lines](boost::system::error_code ec, std::size_t bytes) {
+            link->writing = false;
             if (ec) {
-                std::cerr << "Twitch send error: " << ec.message() << "\n";
+                self->linkFailed(link, "Send", ec);
+                return;
             }
+            auto& metrics = Metrics::instance();
+            metrics.ircWrites.fetch_add(1, std::memory_order_relaxed);
+            metrics.ircLinesSent.fetch_add(lines, std::memory_order_relaxed);
+            metrics.ircBytesSent.fetch_add(bytes, std::memory_order_relaxed);
+            self->pump(link);
         });
 }
 
 void TwitchClient::disconnect() {
-    if (m_socket.is_open()) {
-        std::string partCmd = "PART " + m_channel + "\r\n";
-        boost::asio::write(m_socket, boost::asio::buffer(partCmd));
-
-        std::string quitCmd = "QUIT\r\n";
-        boost::asio::write(m_socket, boost::asio::buffer(quitCmd));
-
-        boost::system::error_code ec;
-        m_socket.close(ec);
+    auto self = shared_from_this();
+    boost::asio::dispatch(m_strand, [self]() {
+        if (self->m_closing) return;
+        self->m_closing = true;
+        self->m_reconnectTimer.cancel();
+        self->m_resolver.cancel();
+        if (self->m_pending) self->closeLink(self->m_pending); // a connect still in flight fails with operation_aborted
+        if (self->m_retiring) self->closeLink(self->m_retiring);
 
-        if (!ec) {
-            std::cout << "[INFO] Disconnected from channel " << m_channel << "\n";
-        }
-        else {
-            std::cout << "[ERROR] Failed to close socket for " << m_channel
-                << ": " << ec.message() << "\n";
+        LinkPtr link = self->m_link;
+        if (!link || link->dead) return;
+        if (!link->connected) {
+            self->closeLink(link);
+            return;
         }
+        // QUIT leaves every channel at once.
+        link->closing = true;
+        link->outbox.dropBudgeted();
+        link->outbox.push(IrcPriority::control, "QUIT");
+        self->pump(link);
+    });
+}
+
+void TwitchClient::closeLink(const LinkPtr& link) {
+    link->dead = true;
+    link->connected = false;
+    boost::system::error_code ec;
+    link->sendTimer.cancel();
+    link->socket.close(ec);
+    if (ec) {
+        LOG_ERROR("TWITCH", "Failed to close socket for ", m_nick, ": ", ec.message());
     }
+    if (link == m_pending) m_pending.reset();
+    if (link == m_retiring) m_retiring.reset();
+    // A dead m_link stays until its replacement has taken over its queue.
+}
+
+void TwitchClient::linkFailed(const LinkPtr& link, const char* what, boost::system::error_code ec) {
+    if (link->dead) return;
+    bool current = link == m_link;
+    bool pending = link == m_pending;
+    closeLink(link);
+    if (m_closing) return;
+
+    LOG_WARN("TWITCH", what, " error on ", m_nick, " (", m_channels.size(), " channels): ", ec.message());
+    if (current && !m_downSince) m_downSince = std::chrono::steady_clock::now();
+    // A retiring link has been replaced already; the others need one.
+    if (current || pending) scheduleReconnect();
+    // No link is reading the channels now, unless a RECONNECT had one
+    // ready: the current link may still be up.
+    if (!m_link || m_link->dead) setState(false);
+}
+
+void TwitchClient::setState(bool up) {
+    if (m_down == !up) return;
+    m_down = !up;
+    if (m_onState) m_onState(up);
 }
 
-void TwitchClient::doRead() {
+void TwitchClient::scheduleReconnect() {
+    if (m_closing || m_pending || m_reconnectArmed) return;
+
+    // Equal jitter: at least half the backoff, so retries still spread out
+    // as they grow, and the rest at random.
+    auto base = std::max<std::chrono::milliseconds::rep>(1, g_defaults.reconnectBase.count());
+    auto cap = std::max(base, static_cast<std::chrono::milliseconds::rep>(g_defaults.reconnectMax.count()));
+    auto backoff = base;
+    for (unsigned i = 0; i < m_attempt && backoff < cap; ++i) backoff *= 2;
+    backoff = std::min(backoff, cap);
+    std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter(0, backoff / 2);
+    std::chrono::milliseconds delay(backoff - backoff / 2 + jitter(engine()));
+    ++m_attempt;
+
+    LOG_INFO("TWITCH", "Reconnecting ", m_nick, " in ", delay.count(), " ms (attempt ", m_attempt, ")");
+    m_reconnectArmed = true;
     auto self = shared_from_this();
-    boost::asio::async_read_until(m_socket, m_buffer, "\r\n",
-        [self](boost::system::error_code ec, std::size_t) {
-            if (!ec) {
-                std::istream is(&self->m_buffer);
-                std::string line;
-
-                while (std::getline(is, line)) {
-                    if (!line.empty() && line.back() == '\r')
-                        line.pop_back();
-                    if (line.empty()) continue;
-
-                    std::cout << "[RAW] " << line << "\n";
-
-                    // PING/PONG
-                    if (line.rfind("PING", 0) == 0) {
-                        self->send("PONG :tmi.twitch.tv\r\n");
-                        continue;
-                    }
+    m_reconnectTimer.expires_after(delay);
+    m_reconnectTimer.async_wait([self](boost::system::error_code ec) {
+        self->m_reconnectArmed = false;
+        if (!ec && !self->m_closing && !self->m_pending) self->openLink();
+    });
+}
 
-                    // Connected
-                    if (line.find(" 001 ") != std::string::npos) {
-                        json okMsg = {
-                            {"type","status"},
-                            {"status","ok"},
-                            {"message","Bot connected to Twitch IRC"},
-                            {"channel", self->m_channel}
-                        };
-                        self->m_server.onClientMessage(nullptr, okMsg.dump());
-                        continue;
-                    }
+void TwitchClient::onWelcome(const LinkPtr& link) {
+    if (link != m_pending) return;
+    m_pending.reset();
+    LinkPtr previous = std::move(m_link);
+    m_link = link;
+    m_attempt = 0;
 
-                    // PRIVMSG (chat)
-                    if (line.find("PRIVMSG") != std::string::npos) {
-                        // Extract username
-                        std::string username;
-                        if (line[0] == '@') {
-                            size_t dnPos = line.find("display-name=");
-                            if (dnPos != std::string::npos) {
-                                size_t end = line.find(';', dnPos);
-                                if (end == std::string::npos) end = line.find(' ', dnPos);
-                                if (end != std::string::npos)
-                                    username = line.substr(dnPos + 13, end - (dnPos + 13));
-                            }
-                            if (username.empty()) {
-                                size_t loginPos = line.find("login=");
-                                if (loginPos != std::string::npos) {
-                                    size_t end = line.find(';', loginPos);
-                                    if (end == std::string::npos) end = line.find(' ', loginPos);
-                                    if (end != std::string::npos)
-                                        username = line.substr(loginPos + 6, end - (loginPos + 6));
-                                }
-                            }
-                        }
-                        if (username.empty()) {
-                            size_t exMark = line.find('!');
-                            if (exMark != std::string::npos && exMark > 1)
-                                username = line.substr(1, exMark - 1);
-                        }
-
-                        // Extract message
-                        std::string message;
-                        size_t lastColon = line.rfind(':');
-                        if (lastColon != std::string::npos)
-                            message = line.substr(lastColon + 1);
-
-                        std::cout << "[CHAT] " << username << ": " << message << "\n";
-
-                        // Forward into GameProtocol
-                        if (self->gameProtocol_) {
-                            self->gameProtocol_->handleCommand(username, message, self->m_channel);
-                        }
-                    }
-                }
+    auto& metrics = Metrics::instance();
+    if (previous) {
+        m_reconnected = true;
+        metrics.ircReconnects.fetch_add(1, std::memory_order_relaxed);
+        link->outbox.adopt(previous->outbox);
+        if (!previous->dead) {
+            // RECONNECT: the old link keeps reading until the new one has
+            // joined, so no chat is missed in between.
+            if (m_retiring) closeLink(m_retiring);
+            m_retiring = std::move(previous);
+        }
+    }
+    if (m_downSince) {
+        auto down = std::chrono::steady_clock::now() - *m_downSince;
+        metrics.ircDowntimeMs.fetch_add(
+            static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(down).count()),
+            std::memory_order_relaxed);
+        m_downSince.reset();
+    }
+    pump(link);
 
-                self->doRead();
-            }
-            else {
-                std::cerr << "Twitch read error: " << ec.message() << "\n";
+    // JOINs echoed before 001
+    for (const auto& channel : link->joined) onJoined(channel);
+    maybeRetire();
+    setState(true);
+}
+
+void TwitchClient::onJoined(const std::string& channel) {
+    json okMsg = {
+        {"type","status"},
+        {"status","ok"},
+        {"message", m_reconnected ? "Bot reconnected to Twitch IRC" : "Bot connected to Twitch IRC"},
+        {"channel", channel}
+    };
+    m_server.onClientMessage(nullptr, okMsg.dump());
+}
+
+void TwitchClient::maybeRetire() {
+    LinkPtr old = m_retiring;
+    if (!old || old->closing || !m_link) return;
+    for (const auto& channel : m_channels)
+        if (!m_link->joined.count(channel)) return;
+    old->closing = true;
+    old->outbox.dropBudgeted();
+    old->outbox.push(IrcPriority::control, "QUIT");
+    pump(old);
+}
+
+void TwitchClient::doRead(const LinkPtr& link) {
+    auto self = shared_from_this();
+    boost::asio::async_read_until(link->socket, link->buffer, "\r\n",
+        [self, link](boost::system::error_code ec, std::size_t) {
+            if (link->dead) return;
+            if (ec) {
+                self->linkFailed(link, "Read", ec);
+                return;
             }
+            // Every complete line in the buffer, parsed where it lies; a
+            // partial line stays for the next read.
+            auto data = link->buffer.data();
+            std::string_view pending(static_cast<const char*>(data.data()), data.size());
+            std::size_t consumed = 0;
+            for (std::size_t eol; !link->dead && (eol = pending.find('\n', consumed)) != std::string_view::npos; consumed = eol + 1)
+                self->handleLine(link, pending.substr(consumed, eol - consumed));
+            if (link->dead) return;
+            link->buffer.consume(consumed);
+
+            self->doRead(link);
         });
 }
 
-void TwitchClient::setCurrentRoom(const std::string& channel, const std::string& roomName) {
-    m_channelRooms[channel] = roomName;
+void TwitchClient::handleLine(const LinkPtr& link, std::string_view line) {
+    IrcMessage msg;
+    if (!IrcMessage::parse(line, msg)) return;
+
+    LOG_TRACE("TWITCH", "RAW ", line);
+
+    // PING/PONG, on the link that was pinged
+    if (msg.command == "PING") {
+        std::string_view token = msg.lastParam();
+        link->outbox.push(IrcPriority::control,
+            "PONG :" + std::string(token.empty() ? std::string_view("tmi.twitch.tv") : token));
+        pump(link);
+        return;
+    }
+
+    // Connected
+    if (msg.command == "001") {
+        onWelcome(link);
+        return;
+    }
+
+    // The server is about to go away: log in elsewhere first.
+    if (msg.command == "RECONNECT") {
+        Metrics::instance().ircReconnectRequests.fetch_add(1, std::memory_order_relaxed);
+        LOG_INFO("TWITCH", "Server asked ", m_nick, " to reconnect");
+        if (link == m_link && !m_closing && !m_pending) {
+            m_reconnectTimer.cancel();
+            openLink();
+        }
+        return;
+    }
+
+    // Everything below is about one channel, named by the first parameter.
+    if (msg.paramCount == 0) return;
+    m_lineChannel.assign(msg.param(0));
+    if (!m_channels.count(m_lineChannel)) return;
+
+    // Our own JOIN echoed: once the new link is in everywhere, the old one
+    // can go.
+    if (msg.command == "JOIN" && sameNick(msg.nick(), m_nick)) {
+        if (!link->joined.insert(m_lineChannel).second) return;
+        if (link == m_link) {
+            onJoined(m_lineChannel);
+            maybeRetire();
+        }
+        return;
+    }
+
+    if (msg.command == "PART" && sameNick(msg.nick(), m_nick)) {
+        link->joined.erase(m_lineChannel);
+        return;
+    }
+
+    // PRIVMSG (chat): "PRIVMSG #channel :text", the text may hold colons.
+    // A retiring link's chat stops where the new link's starts.
+    if (msg.command == "PRIVMSG" && msg.paramCount >= 2 && !link->closing) {
+        if (link == m_retiring && m_link && m_link->joined.count(m_lineChannel)) return;
+
+        std::string_view username = IrcMessage::unescape(msg.tag("display-name"), m_tagScratch);
+        if (username.empty()) username = msg.tag("login");
+        if (username.empty()) username = msg.nick();
+        m_lineUser.assign(username);
+        m_lineText.assign(msg.lastParam());
+
+        LOG_TRACE("CHAT", LogFields().room(m_lineChannel).user(m_lineUser), m_lineText);
+
+        // Forward into GameProtocol
+        if (gameProtocol_) {
+            gameProtocol_->handleCommand(m_lineUser, m_lineText, m_lineChannel);
+        }
+    }
+}
+
+void TwitchClient::setDefaults(const TwitchOptions& options) {
+    g_defaults = options;
 }
+
+TwitchOptions TwitchClient::defaults() {
+    return g_defaults;
+}
+
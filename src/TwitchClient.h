@@ -1,37 +1,126 @@
 ﻿#pragma once
 #include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include "server.h"
-#include <unordered_map>
+#include <unordered_set>
 #include "GameProtocol.h"   // NEW include
+#include "ircSendQueue.h"
+
+// TWITCH_IRC_*, TWITCH_RECONNECT_* and TWITCH_CHANNELS_PER_CONNECTION in
+// config.json; pointing host at a local stand-in keeps tests and
+// benchmarks off irc.chat.twitch.tv.
+struct TwitchOptions {
+    std::string host = "irc.chat.twitch.tv";
+    std::string port = "6667";
+    IrcSendOptions send;
+    // Delay before reconnect attempt n is base * 2^n capped at max, then
+    // jittered down by up to half so bots dropped together spread out.
+    std::chrono::milliseconds reconnectBase{ 1000 };
+    std::chrono::milliseconds reconnectMax{ 60000 };
+    // TwitchBotManager opens another connection past this many channels.
+    std::size_t channelsPerConnection = 100;
+};
+
+// One bot connection, JOINed to any number of channels. Everything
+// (resolve, connect, reads, writes and timers) runs on m_strand; the public
+// methods may be called from any thread. Each TCP connection is a Link with
+// its own IrcSendQueue, so writes never overlap and stay within Twitch's
+// limits. Chat is routed to GameProtocol by the PRIVMSG target.
+//
+// A lost connection is replaced with jittered exponential backoff, and the
+// replacement rejoins every channel. A RECONNECT from the server opens the
+// replacement first: it takes over writes once logged in (001), and the old
+// link keeps delivering a channel's chat until the new one has rejoined it.
 class TwitchClient : public std::enable_shared_from_this<TwitchClient> {
 public:
     TwitchClient(boost::asio::io_context& io,
         Server& server,
         const std::string& oauth,
-        const std::string& nick,
-        const std::string& channel);
+        const std::string& nick);
 
     void connect();
+    // Sends QUIT behind anything already queued (chat announcements
+    // excepted), then closes. No reconnects after this.
     void disconnect();
-    void setCurrentRoom(const std::string& channel, const std::string& roomName);
+    // channel is "#name" in lower case. Joins now if logged in, otherwise
+    // on login.
+    void join(const std::string& channel);
+    void part(const std::string& channel);
+    // Chat announcement in one of the bot's channels, sent as budget allows.
+    void say(const std::string& channel, const std::string& text);
     void setGameProtocol(std::shared_ptr<GameProtocol> gp) { gameProtocol_ = gp; }
+    // Called on the client's strand with false when the connection is lost
+    // (not for RECONNECT or disconnect()), and with true once a replacement
+    // has logged in. Set before connect().
+    void setStateHandler(std::function<void(bool up)> handler) { m_onState = std::move(handler); }
+
+    // Process-wide defaults (TWITCH_IRC_* in config.json).
+    static void setDefaults(const TwitchOptions& options);
+    static TwitchOptions defaults();
 
 private:
-    void login();
-    void doRead();
-    void send(const std::string& msg);
+    struct Link {
+        Link(const boost::asio::strand<boost::asio::io_context::executor_type>& strand, const IrcSendOptions& send);
 
+        boost::asio::ip::tcp::socket socket;
+        boost::asio::streambuf buffer;
+        IrcSendQueue outbox;
+        std::string writeBuffer; // the write in flight
+        boost::asio::steady_timer sendTimer;
+        std::unordered_set<std::string> joined; // our JOIN echoed back
+        bool connected = false;  // TCP up, login queued
+        bool writing = false;
+        bool timerArmed = false;
+        bool closing = false;    // QUIT queued; close once written
+        bool dead = false;       // closed; late handlers ignore it
+    };
+    using LinkPtr = std::shared_ptr<Link>;
+
+    void openLink(); // resolve, connect and log in a replacement for m_link
+    void login(const LinkPtr& link);
+    void doRead(const LinkPtr& link);
+    void handleLine(const LinkPtr& link, std::string_view line); // one IRC line, without "\n"
+    void onWelcome(const LinkPtr& link);
+    void onJoined(const std::string& channel); // m_link is in channel
+    void linkFailed(const LinkPtr& link, const char* what, boost::system::error_code ec);
+    void closeLink(const LinkPtr& link);
+    void maybeRetire(); // once m_link has joined every channel, QUIT m_retiring
+    void scheduleReconnect();
+    void setState(bool up);
+    void send(std::string line, IrcPriority priority); // to m_link; line without "\r\n"
+    void pushLive(IrcPriority priority, const std::string& line); // to every logged-in link but a retiring one
+    void pump(const LinkPtr& link); // starts the next coalesced write, or a timer if lines wait for budget
+
+    boost::asio::strand<boost::asio::io_context::executor_type> m_strand;
     boost::asio::ip::tcp::resolver m_resolver;
-    boost::asio::ip::tcp::socket m_socket;
-    boost::asio::streambuf m_buffer;
+    boost::asio::steady_timer m_reconnectTimer;
+
+    LinkPtr m_link;     // takes writes; may be dead while a replacement is on its way
+    LinkPtr m_pending;  // connecting or logging in
+    LinkPtr m_retiring; // replaced after RECONNECT, still reading until the new link has joined
+    unsigned m_attempt = 0; // reconnects since the last successful login
+    bool m_reconnectArmed = false;
+    bool m_reconnected = false; // m_link replaced an earlier link
+    bool m_down = false;        // last reported to m_onState
+    std::optional<std::chrono::steady_clock::time_point> m_downSince;
+    bool m_closing = false;
 
     Server& m_server;
     std::string m_oauth;
     std::string m_nick;
-    std::string m_channel;
-    std::unordered_map<std::string, std::string> m_channelRooms; // Track current room per channel
+    std::unordered_set<std::string> m_channels;
+    std::function<void(bool)> m_onState;
+    // Reused per line so reading chat doesn't allocate once they have grown.
+    std::string m_tagScratch;
+    std::string m_lineChannel;
+    std::string m_lineUser;
+    std::string m_lineText;
 
     std::shared_ptr<GameProtocol> gameProtocol_;
 };
@@ -0,0 +1,209 @@
+#include "canvasCheckpoint.h"
+#include "canvasRaster.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+std::string base64(const std::string& in) {
+    static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((in.size() + 2) / 3 * 4);
+    std::size_t i = 0;
+    for (; i + 2 < in.size(); i += 3) {
+        std::uint32_t v = (std::uint32_t(static_cast<unsigned char>(in[i])) << 16) |
+            (std::uint32_t(static_cast<unsigned char>(in[i + 1])) << 8) |
+            static_cast<unsigned char>(in[i + 2]);
+        out += kAlphabet[(v >> 18) & 63];
+        out += kAlphabet[(v >> 12) & 63];
+        out += kAlphabet[(v >> 6) & 63];
+        out += kAlphabet[v & 63];
+    }
+    if (i < in.size()) {
+        std::uint32_t v = std::uint32_t(static_cast<unsigned char>(in[i])) << 16;
+        if (i + 1 < in.size()) v |= std::uint32_t(static_cast<unsigned char>(in[i + 1])) << 8;
+        out += kAlphabet[(v >> 18) & 63];
+        out += kAlphabet[(v >> 12) & 63];
+        out += i + 1 < in.size() ? kAlphabet[(v >> 6) & 63] : '=';
+        out += '=';
+    }
+    return out;
+}
+
+// Strokes copied out of the room's store for one job: points for all of
+// them back to back, so the job never touches the store.
+struct StrokeBatch {
+    struct Stroke {
+        std::uint32_t rgb;
+        float width;
+        std::size_t offset;
+        std::size_t count;
+    };
+    std::vector<Stroke> strokes;
+    std::vector<float> xs;
+    std::vector<float> ys;
+};
+
+}
+
+struct CanvasCheckpointer::State {
+    std::mutex mutex;
+    std::shared_ptr<const CanvasRaster> raster; // covers the first `strokes` strokes
+    MessagePtr message;
+    std::size_t strokes = 0;
+    std::size_t jobTarget = 0;   // strokes the job in flight will cover, 0 if none
+    std::uint64_t generation = 0; // bumped whenever the raster is thrown away
+    bool unrenderable = false;
+
+    void invalidate() {
+        ++generation;
+        raster.reset();
+        message.reset();
+        strokes = 0;
+        jobTarget = 0;
+        unrenderable = false;
+    }
+};
+
+CheckpointService& CheckpointService::instance() {
+    static CheckpointService service;
+    return service;
+}
+
+void CheckpointService::configure(const CheckpointOptions& options) {
+    shutdown();
+    m_options = options;
+    m_options.interval = std::max<std::size_t>(1, m_options.interval);
+    m_options.threads = std::max<std::size_t>(1, m_options.threads);
+    if (m_options.enabled) {
+        m_pool = std::make_unique<boost::asio::thread_pool>(m_options.threads);
+        LOG_INFO("CANVAS", "Raster checkpoints every ", m_options.interval, " strokes at ",
+            m_options.width, "x", m_options.height, " on ", m_options.threads, " thread(s)");
+    }
+}
+
+void CheckpointService::shutdown() {
+    if (!m_pool) return;
+    m_pool->stop();
+    m_pool->join();
+    m_pool.reset();
+}
+
+CanvasCheckpointer::CanvasCheckpointer()
+    : m_state(std::make_shared<State>()) {
+}
+
+void CanvasCheckpointer::afterAppend(const StrokeStore& store, std::string_view room) {
+    auto& service = CheckpointService::instance();
+    if (!service.enabled()) return;
+    const CheckpointOptions& opts = service.options();
+
+    std::shared_ptr<const CanvasRaster> base;
+    auto batch = std::make_shared<StrokeBatch>();
+    std::size_t target;
+    std::uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        State& st = *m_state;
+        if (st.jobTarget || st.unrenderable) return;
+        target = store.size() > opts.keepTail ? store.size() - opts.keepTail : 0;
+        if (target < st.strokes + opts.interval) return;
+
+        std::size_t points = 0;
+        for (std::size_t i = st.strokes; i < target; ++i) {
+            StrokeStore::StrokeView stroke = store[i];
+            if (stroke.kind == StrokeStore::Kind::raw) {
+                st.unrenderable = true;
+                LOG_DEBUG("CANVAS", LogFields().room(room), "Stroke ", i, " cannot be rasterized; checkpoints off until undo/clear");
+                return;
+            }
+            points += stroke.count;
+        }
+        batch->strokes.reserve(target - st.strokes);
+        batch->xs.reserve(points);
+        batch->ys.reserve(points);
+        for (std::size_t i = st.strokes; i < target; ++i) {
+            StrokeStore::StrokeView stroke = store[i];
+            batch->strokes.push_back({ stroke.rgb, stroke.width, batch->xs.size(), stroke.count });
+            batch->xs.insert(batch->xs.end(), stroke.xs, stroke.xs + stroke.count);
+            batch->ys.insert(batch->ys.end(), stroke.ys, stroke.ys + stroke.count);
+        }
+
+        st.jobTarget = target;
+        generation = st.generation;
+        base = st.raster;
+    }
+
+    std::string roomName(room);
+    CheckpointOptions jobOpts = opts;
+    std::weak_ptr<State> weak = m_state;
+    service.post([weak, base, batch, target, generation, roomName, jobOpts]() {
+        auto start = std::chrono::steady_clock::now();
+        auto raster = base ? std::make_shared<CanvasRaster>(*base)
+            : std::make_shared<CanvasRaster>(jobOpts.width, jobOpts.height, jobOpts.background);
+        for (const auto& s : batch->strokes)
+            raster->drawStroke(s.rgb, s.width, batch->xs.data() + s.offset, batch->ys.data() + s.offset, s.count);
+        std::string png = raster->encodePng(jobOpts.pngLevel);
+
+        auto& metrics = Metrics::instance();
+        auto state = weak.lock();
+        if (!state) return; // room is gone
+        if (png.empty()) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->generation == generation) state->jobTarget = 0;
+            LOG_WARN("CANVAS", LogFields().room(roomName), "PNG encoding failed");
+            return;
+        }
+
+        nlohmann::json msg = {
+            {"type", "checkpoint"},
+            {"room", roomName},
+            {"payload", {
+                {"format", "png"},
+                {"width", raster->width()},
+                {"height", raster->height()},
+                {"strokes", target},
+                {"data", base64(png)}
+            }}
+        };
+        MessagePtr message = makeMessage(msg.dump(), MessageClass::control);
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->generation != generation) {
+            metrics.checkpointsDiscarded.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        state->raster = std::move(raster);
+        state->message = std::move(message);
+        state->strokes = target;
+        state->jobTarget = 0;
+        metrics.checkpointsBuilt.fetch_add(1, std::memory_order_relaxed);
+        metrics.checkpointStrokes.fetch_add(batch->strokes.size(), std::memory_order_relaxed);
+        metrics.checkpointMicros.fetch_add(static_cast<std::uint64_t>(micros), std::memory_order_relaxed);
+        LOG_DEBUG("CANVAS", LogFields().room(roomName), "Checkpoint at ", target, " strokes: ",
+            batch->strokes.size(), " rasterized, ", png.size(), " bytes PNG, ", micros, " us");
+    });
+}
+
+void CanvasCheckpointer::afterUndo(std::size_t size) {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    if (size < std::max(m_state->strokes, m_state->jobTarget) || m_state->unrenderable)
+        m_state->invalidate();
+}
+
+void CanvasCheckpointer::afterClear() {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->invalidate();
+}
+
+CanvasCheckpointer::Checkpoint CanvasCheckpointer::latest() const {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return { m_state->message, m_state->strokes };
+}
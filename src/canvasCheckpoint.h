@@ -0,0 +1,80 @@
+#pragma once
+#include <boost/asio/thread_pool.hpp>
+#include <boost/asio/post.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include "outboundMessage.h"
+#include "strokeStore.h"
+
+// Raster checkpoints: every so often a room's stroke history is flattened
+// into a PNG on a background pool, so a late joiner that opted in ("hello"
+// {"checkpoint":true}) gets one image plus the strokes drawn since, instead
+// of every stroke of the round.
+struct CheckpointOptions {
+    bool enabled = false;
+    int width = 1280;                   // canvas size in px, as drawn by clients
+    int height = 720;
+    std::uint32_t background = 0xFFFFFF;
+    std::size_t interval = 1000;        // strokes past the last checkpoint before the next
+    std::size_t keepTail = 64;          // newest strokes never flattened, so undo rarely invalidates
+    int pngLevel = 6;
+    std::size_t threads = 1;
+};
+
+// Process-wide pool the checkpoint jobs run on. Configured once from main
+// before the server starts; rasterizing never runs on an io thread.
+class CheckpointService {
+public:
+    static CheckpointService& instance();
+
+    void configure(const CheckpointOptions& options);
+    const CheckpointOptions& options() const { return m_options; }
+    bool enabled() const { return m_options.enabled && m_pool; }
+
+    template <typename F>
+    void post(F&& fn) {
+        if (m_pool) boost::asio::post(*m_pool, std::forward<F>(fn));
+    }
+
+    // Abandons queued jobs and joins the pool.
+    void shutdown();
+
+private:
+    CheckpointService() = default;
+
+    CheckpointOptions m_options;
+    std::unique_ptr<boost::asio::thread_pool> m_pool;
+};
+
+// One room's checkpoints. Room calls the after*() hooks on its strand
+// with the history they refer to; jobs hold only the shared state below, so
+// a room may go away while one is still running.
+//
+// A checkpoint extends the previous raster with the strokes since, so each
+// stroke is rasterized once. Undoing a stroke that a checkpoint (or a job in
+// flight) already covers, or clearing, discards the raster; the next append
+// starts again from an empty canvas. Strokes kept verbatim (StrokeStore::
+// Kind::raw) cannot be rasterized, so a room holding one gets no checkpoints
+// until it is undone or cleared.
+class CanvasCheckpointer {
+public:
+    struct Checkpoint {
+        MessagePtr message; // {"type":"checkpoint",...}, nullptr if none yet
+        std::size_t strokes = 0; // history prefix the image covers
+    };
+
+    CanvasCheckpointer();
+
+    void afterAppend(const StrokeStore& store, std::string_view room);
+    void afterUndo(std::size_t size);
+    void afterClear();
+
+    Checkpoint latest() const;
+
+private:
+    struct State;
+    std::shared_ptr<State> m_state;
+};
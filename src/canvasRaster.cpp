@@ -0,0 +1,237 @@
+#include "canvasRaster.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <boost/beast/zlib/deflate_stream.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GUESSIO_RASTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace zlib = boost::beast::zlib;
+
+namespace {
+bool g_simdEnabled = true;
+
+// 0xRRGGBB to the in-memory 0x00BBGGRR used by the pixel buffer.
+std::uint32_t toPixel(std::uint32_t rgb) {
+    return ((rgb >> 16) & 0xFF) | (rgb & 0xFF00) | ((rgb & 0xFF) << 16);
+}
+
+const std::array<std::uint32_t, 256>& crcTable() {
+    static const std::array<std::uint32_t, 256> table = [] {
+        std::array<std::uint32_t, 256> t{};
+        for (std::uint32_t n = 0; n < 256; ++n) {
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    return table;
+}
+
+std::uint32_t crc32(std::uint32_t crc, const char* data, std::size_t size) {
+    const auto& table = crcTable();
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+std::uint32_t adler32(const std::string& data) {
+    constexpr std::uint32_t kMod = 65521;
+    constexpr std::size_t kBlock = 5552; // largest run before the sums can overflow
+    std::uint32_t a = 1, b = 0;
+    for (std::size_t i = 0; i < data.size();) {
+        std::size_t end = std::min(data.size(), i + kBlock);
+        for (; i < end; ++i) {
+            a += static_cast<unsigned char>(data[i]);
+            b += a;
+        }
+        a %= kMod;
+        b %= kMod;
+    }
+    return (b << 16) | a;
+}
+
+void putBE32(std::string& out, std::uint32_t v) {
+    out += static_cast<char>(v >> 24);
+    out += static_cast<char>(v >> 16);
+    out += static_cast<char>(v >> 8);
+    out += static_cast<char>(v);
+}
+
+void appendChunk(std::string& out, const char* type, const std::string& data) {
+    putBE32(out, static_cast<std::uint32_t>(data.size()));
+    std::size_t start = out.size();
+    out.append(type, 4);
+    out += data;
+    putBE32(out, crc32(0, out.data() + start, out.size() - start));
+}
+
+// zlib stream (RFC 1950) around Beast's raw deflate.
+std::string zlibCompress(const std::string& raw, int level) {
+    zlib::deflate_stream stream;
+    stream.reset(level, 15, 8, zlib::Strategy::normal);
+
+    std::string out(2 + stream.upper_bound(raw.size()) + 4, '\0');
+    out[0] = '\x78';
+    out[1] = '\x9C';
+
+    zlib::z_params zs;
+    zs.next_in = raw.data();
+    zs.avail_in = raw.size();
+    zs.next_out = &out[2];
+    zs.avail_out = out.size() - 2;
+
+    boost::system::error_code ec;
+    stream.write(zs, zlib::Flush::finish, ec);
+    if (ec != zlib::error::end_of_stream) return std::string();
+
+    out.resize(2 + zs.total_out);
+    putBE32(out, adler32(raw));
+    return out;
+}
+}
+
+CanvasRaster::CanvasRaster(int width, int height, std::uint32_t backgroundRgb)
+    : m_width(std::max(1, width)),
+    m_height(std::max(1, height)),
+    m_pixels(std::make_unique<std::uint32_t[]>(std::size_t(m_width) * m_height)) {
+    std::fill_n(m_pixels.get(), std::size_t(m_width) * m_height, toPixel(backgroundRgb));
+}
+
+CanvasRaster::CanvasRaster(const CanvasRaster& other)
+    : m_width(other.m_width),
+    m_height(other.m_height),
+    m_pixels(std::make_unique<std::uint32_t[]>(std::size_t(m_width) * m_height)) {
+    std::memcpy(m_pixels.get(), other.m_pixels.get(), std::size_t(m_width) * m_height * sizeof(std::uint32_t));
+}
+
+void CanvasRaster::setSimdEnabled(bool enabled) {
+    g_simdEnabled = enabled;
+}
+
+std::uint32_t CanvasRaster::pixel(int x, int y) const {
+    std::uint32_t p = m_pixels[std::size_t(y) * m_width + x];
+    return toPixel(p); // the swap is its own inverse
+}
+
+void CanvasRaster::drawStroke(std::uint32_t rgb, float width, const float* xs, const float* ys, std::size_t count) {
+    if (count == 0) return;
+    const float radius = std::max(width * 0.5f, 0.5f);
+    const std::uint32_t color = toPixel(rgb);
+    if (count == 1) {
+        fillCapsule(xs[0], ys[0], xs[0], ys[0], radius, color);
+        return;
+    }
+    for (std::size_t i = 1; i < count; ++i)
+        fillCapsule(xs[i - 1], ys[i - 1], xs[i], ys[i], radius, color);
+}
+
+// For each pixel centre p: t = clamp(dot(p - a, e) / |e|^2, 0, 1) with
+// e = b - a, and p is inside when |p - a - t*e|^2 <= r^2. The scalar loop
+// mirrors the SSE2 one operation for operation, including maxps/minps
+// semantics, so the choice of path never changes a pixel.
+void CanvasRaster::fillCapsule(float ax, float ay, float bx, float by, float radius, std::uint32_t color) {
+    const float fx0 = std::floor(std::min(ax, bx) - radius);
+    const float fx1 = std::ceil(std::max(ax, bx) + radius);
+    const float fy0 = std::floor(std::min(ay, by) - radius);
+    const float fy1 = std::ceil(std::max(ay, by) + radius);
+    if (!(fx1 >= 0.0f && fy1 >= 0.0f && fx0 < float(m_width) && fy0 < float(m_height))) return;
+    const int x0 = static_cast<int>(std::max(fx0, 0.0f));
+    const int x1 = static_cast<int>(std::min(fx1, float(m_width - 1)));
+    const int y0 = static_cast<int>(std::max(fy0, 0.0f));
+    const int y1 = static_cast<int>(std::min(fy1, float(m_height - 1)));
+
+    const float ex = bx - ax;
+    const float ey = by - ay;
+    const float len2 = ex * ex + ey * ey;
+    const float inv = len2 > 0.0f ? 1.0f / len2 : 0.0f;
+    const float r2 = radius * radius;
+
+    for (int y = y0; y <= y1; ++y) {
+        const float dy = (float(y) + 0.5f) - ay;
+        const float dyey = dy * ey;
+        std::uint32_t* row = m_pixels.get() + std::size_t(y) * m_width;
+        int x = x0;
+
+#ifdef GUESSIO_RASTER_SSE2
+        if (g_simdEnabled) {
+            const __m128 vax = _mm_set1_ps(ax);
+            const __m128 vex = _mm_set1_ps(ex);
+            const __m128 vey = _mm_set1_ps(ey);
+            const __m128 vinv = _mm_set1_ps(inv);
+            const __m128 vr2 = _mm_set1_ps(r2);
+            const __m128 vdy = _mm_set1_ps(dy);
+            const __m128 vdyey = _mm_set1_ps(dyey);
+            const __m128 half = _mm_set1_ps(0.5f);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128i vcolor = _mm_set1_epi32(static_cast<int>(color));
+            const __m128i lanes = _mm_setr_epi32(0, 1, 2, 3);
+            for (; x + 3 <= x1; x += 4) {
+                __m128 px = _mm_add_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x), lanes)), half);
+                __m128 dx = _mm_sub_ps(px, vax);
+                __m128 t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(dx, vex), vdyey), vinv);
+                t = _mm_min_ps(_mm_max_ps(t, zero), one);
+                __m128 qx = _mm_sub_ps(dx, _mm_mul_ps(t, vex));
+                __m128 qy = _mm_sub_ps(vdy, _mm_mul_ps(t, vey));
+                __m128 d2 = _mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy));
+                __m128i inside = _mm_castps_si128(_mm_cmple_ps(d2, vr2));
+                __m128i* p = reinterpret_cast<__m128i*>(row + x);
+                __m128i old = _mm_loadu_si128(p);
+                _mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(inside, vcolor), _mm_andnot_si128(inside, old)));
+            }
+        }
+#endif
+
+        for (; x <= x1; ++x) {
+            float dx = (float(x) + 0.5f) - ax;
+            float t = (dx * ex + dyey) * inv;
+            t = t > 0.0f ? t : 0.0f;
+            t = t < 1.0f ? t : 1.0f;
+            float qx = dx - t * ex;
+            float qy = dy - t * ey;
+            if (qx * qx + qy * qy <= r2) row[x] = color;
+        }
+    }
+}
+
+std::string CanvasRaster::encodePng(int level) const {
+    // Filter type 0 (none) on every row: strokes are flat colour, so plain
+    // LZ77 runs already do well and encoding stays a straight copy.
+    const std::size_t rowBytes = 1 + std::size_t(m_width) * 3;
+    std::string raw(rowBytes * m_height, '\0');
+    for (int y = 0; y < m_height; ++y) {
+        char* dst = &raw[std::size_t(y) * rowBytes + 1];
+        const std::uint32_t* src = m_pixels.get() + std::size_t(y) * m_width;
+        for (int x = 0; x < m_width; ++x) {
+            std::uint32_t p = src[x];
+            *dst++ = static_cast<char>(p);
+            *dst++ = static_cast<char>(p >> 8);
+            *dst++ = static_cast<char>(p >> 16);
+        }
+    }
+
+    std::string idat = zlibCompress(raw, level);
+    if (idat.empty()) return std::string();
+
+    std::string ihdr;
+    putBE32(ihdr, static_cast<std::uint32_t>(m_width));
+    putBE32(ihdr, static_cast<std::uint32_t>(m_height));
+    ihdr += '\x08'; // bit depth
+    ihdr += '\x02'; // truecolour RGB
+    ihdr.append(3, '\0'); // deflate, adaptive filtering, no interlace
+
+    std::string out;
+    out.reserve(idat.size() + 64);
+    out.append("\x89PNG\r\n\x1a\n", 8);
+    appendChunk(out, "IHDR", ihdr);
+    appendChunk(out, "IDAT", idat);
+    appendChunk(out, "IEND", std::string());
+    return out;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Fixed-size RGB raster that strokes are flattened into for checkpoints.
+//
+// A stroke is drawn as the union of round-capped segments ("capsules") of
+// radius width/2 between consecutive points; a pixel is painted, opaque and
+// without anti-aliasing, when its centre lies inside. Painting is the only
+// operation, so replaying the same strokes in the same order always gives
+// the same pixels. The inside test uses single-precision adds, multiplies
+// and min/max only, evaluated in the same order by the SSE2 path and the
+// scalar fallback, so both produce identical bytes (build without FP
+// contraction, which MSVC's default /fp:precise already guarantees).
+//
+// Not thread-safe; a checkpoint job owns its raster while drawing.
+class CanvasRaster {
+public:
+    CanvasRaster(int width, int height, std::uint32_t backgroundRgb = 0xFFFFFF);
+    CanvasRaster(const CanvasRaster& other); // checkpoints extend a copy of the last one
+    CanvasRaster& operator=(const CanvasRaster&) = delete;
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    // Points in px, as stored by StrokeStore. Anything off the canvas is clipped.
+    void drawStroke(std::uint32_t rgb, float width, const float* xs, const float* ys, std::size_t count);
+
+    // Pixel (x, y) as 0xRRGGBB.
+    std::uint32_t pixel(int x, int y) const;
+
+    // 8-bit RGB PNG, unfiltered rows, deflated at the given zlib level.
+    // Deterministic for a given raster and level. Empty on failure.
+    std::string encodePng(int level = 6) const;
+
+    // Forces the scalar fallback, for comparing against the SIMD path.
+    static void setSimdEnabled(bool enabled);
+
+private:
+    void fillCapsule(float ax, float ay, float bx, float by, float radius, std::uint32_t color);
+
+    int m_width;
+    int m_height;
+    std::unique_ptr<std::uint32_t[]> m_pixels; // 0x00BBGGRR, row-major
+};
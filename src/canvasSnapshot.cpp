@@ -0,0 +1,77 @@
+#include "canvasSnapshot.h"
+#include <string>
+#include <nlohmann/json.hpp>
+
+MessagePtr CanvasSnapshot::frame(const StrokeStore& store) {
+    const bool current = m_frame && m_validBytes + 1 == m_frame->size();
+    if (current && m_starts.size() == store.size()) return m_frame;
+
+    auto& metrics = Metrics::instance();
+    metrics.canvasSnapshotBuilds.fetch_add(1, std::memory_order_relaxed);
+
+    std::string body;
+    if (m_frame) {
+        body.reserve(m_validBytes + (store.size() - m_starts.size()) * 64 + 1);
+        body.assign(m_frame->payload(), 0, m_validBytes);
+    }
+    else {
+        body = "[";
+    }
+    for (std::size_t i = m_starts.size(); i < store.size(); ++i) {
+        m_starts.push_back(body.size());
+        if (body.size() > 1) body += ',';
+        store.appendJsonMessage(body, store[i]);
+    }
+    m_validBytes = body.size();
+    body += ']';
+
+    // Never dropped: a late joiner without it has no canvas at all.
+    m_frame = makeMessage(std::move(body), MessageClass::control);
+    return m_frame;
+}
+
+MessagePtr CanvasSnapshot::since(const StrokeStore& store, std::size_t first, bool array, std::string_view room) {
+    MessagePtr all = frame(store);
+    if (first == 0 && array) return all;
+    if (first == 0 && m_history && m_historyOf == all) return m_history;
+
+    // Each stroke's bytes start at its separator; the first one has none.
+    std::string_view strokes;
+    if (first < m_starts.size()) {
+        strokes = std::string_view(all->payload()).substr(m_starts[first], m_validBytes - m_starts[first]);
+        if (first > 0) strokes.remove_prefix(1);
+    }
+
+    std::string body;
+    body.reserve(strokes.size() + room.size() + 48);
+    if (!array) {
+        body += R"({"type":"history","room":)";
+        body += nlohmann::json(room).dump();
+        body += R"(,"payload":)";
+    }
+    body += '[';
+    body += strokes;
+    body += ']';
+    if (!array) body += '}';
+
+    MessagePtr msg = makeMessage(std::move(body), MessageClass::control);
+    if (first == 0) {
+        m_history = msg;
+        m_historyOf = all;
+    }
+    return msg;
+}
+
+void CanvasSnapshot::truncate(std::size_t size) {
+    if (size >= m_starts.size()) return;
+    m_validBytes = m_starts[size];
+    m_starts.resize(size);
+}
+
+void CanvasSnapshot::clear() {
+    m_frame.reset();
+    m_history.reset();
+    m_historyOf.reset();
+    m_starts.clear();
+    m_validBytes = 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include "outboundMessage.h"
+#include "strokeStore.h"
+
+// A room's whole canvas as one pre-serialized frame: the JSON array of every
+// stroke's draw message, i.e. exactly what a batch-capable client would get
+// if the strokes were replayed through its envelope.
+//
+// Built lazily and incrementally. frame() only serializes strokes appended
+// since the last call and reuses the bytes already written for the rest;
+// undo truncates to the recorded offset of the removed stroke. The returned
+// message is cached until the history changes, so every session joining in
+// between queues the same buffer (and the same deflated copy).
+//
+// Not thread-safe; used on its Room's strand together with its StrokeStore.
+class CanvasSnapshot {
+public:
+    // Up-to-date frame for store, which must be the store this snapshot has
+    // been following.
+    MessagePtr frame(const StrokeStore& store);
+
+    // Strokes from first on, as one frame: the bare array when array is
+    // set, else wrapped for clients that don't read array envelopes as
+    //   {"type":"history","room":r,"payload":[..]}
+    // The wrapped whole canvas is cached like frame(); a tail (first > 0,
+    // the strokes since a checkpoint) is built per call.
+    MessagePtr since(const StrokeStore& store, std::size_t first, bool array, std::string_view room);
+
+    // The store shrank to size strokes (undo).
+    void truncate(std::size_t size);
+    void clear();
+
+private:
+    MessagePtr m_frame;               // "[..]"; may hold strokes since undone
+    std::vector<std::size_t> m_starts; // payload offset of each stroke's separator
+    std::size_t m_validBytes = 0;     // payload prefix still current, without ']'
+    MessagePtr m_history;             // m_historyOf wrapped as a "history" message
+    MessagePtr m_historyOf;
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <boost/beast/core/role.hpp>
+#include <boost/beast/core/stream_traits.hpp>
+#include <boost/beast/websocket/teardown.hpp>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// The TCP socket under a Session's websocket stream. Session writes its
+// prebuilt frames straight to the socket, and Beast's read loop writes on
+// its own too (pong replies to client pings, close frames). Every write from
+// either side passes through one gate here and is written in full before
+// the next one starts, so frames can never interleave. Strand only.
+class FrameSocket {
+public:
+    using executor_type = boost::asio::ip::tcp::socket::executor_type;
+
+    explicit FrameSocket(boost::asio::ip::tcp::socket socket)
+        : m_socket(std::move(socket)) {
+    }
+
+    executor_type get_executor() noexcept { return m_socket.get_executor(); }
+    boost::asio::ip::tcp::socket& socket() { return m_socket; }
+
+    template <class MutableBufferSequence, class ReadHandler>
+    void async_read_some(const MutableBufferSequence& buffers, ReadHandler&& handler) {
+        m_socket.async_read_some(buffers, std::forward<ReadHandler>(handler));
+    }
+
+    // Beast's writes. Writing everything is a valid write_some.
+    template <class ConstBufferSequence, class WriteHandler>
+    void async_write_some(const ConstBufferSequence& buffers, WriteHandler&& handler) {
+        async_write_all(buffers, std::forward<WriteHandler>(handler));
+    }
+
+    // Writes all of buffers once every earlier write has finished. The
+    // buffers must stay valid until the handler runs.
+    template <class ConstBufferSequence, class WriteHandler>
+    void async_write_all(const ConstBufferSequence& buffers, WriteHandler&& handler) {
+        // Held by shared_ptr so the queued write stays copyable for
+        // std::function; Beast's handlers are move-only.
+        auto h = std::make_shared<std::decay_t<WriteHandler>>(std::forward<WriteHandler>(handler));
+        enter([this, buffers, h]() {
+            boost::asio::async_write(m_socket, buffers, [this, h](boost::system::error_code ec, std::size_t bytes) {
+                leave();
+                (*h)(ec, bytes);
+            });
+        });
+    }
+
+private:
+    void enter(std::function<void()> write) {
+        if (m_writing) {
+            m_waiting.push_back(std::move(write));
+            return;
+        }
+        m_writing = true;
+        write();
+    }
+
+    void leave() {
+        if (m_waiting.empty()) {
+            m_writing = false;
+            return;
+        }
+        // The gate stays taken and passes to the next writer.
+        boost::asio::post(m_socket.get_executor(), std::move(m_waiting.front()));
+        m_waiting.pop_front();
+    }
+
+    boost::asio::ip::tcp::socket m_socket;
+    bool m_writing = false;
+    std::deque<std::function<void()>> m_waiting;
+};
+
+// Beast closes the socket on timeouts and failed handshakes, and tears it
+// down after the closing handshake.
+inline void beast_close_socket(FrameSocket& s) {
+    boost::beast::close_socket(s.socket());
+}
+
+inline void teardown(boost::beast::role_type role, FrameSocket& s, boost::system::error_code& ec) {
+    boost::beast::websocket::teardown(role, s.socket(), ec);
+}
+
+template <class TeardownHandler>
+void async_teardown(boost::beast::role_type role, FrameSocket& s, TeardownHandler&& handler) {
+    boost::beast::websocket::async_teardown(role, s.socket(), std::forward<TeardownHandler>(handler));
+}
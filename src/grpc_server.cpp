@@ -1,5 +1,5 @@
 #include <grpcpp/grpcpp.h>
-#include <iostream>
+#include "logger.h"
 
 #include "../proto/proto_gen/guessio.grpc.pb.h"
 #include "../proto/proto_gen/guessio.pb.h"
@@ -20,13 +20,13 @@ using guessio::GuessReply;
 class GuessServiceImpl final : public GuessService::Service {
 public:
     Status JoinGame(g::ServerContext* context, const JoinRequest* request, JoinReply* reply) override {
-        std::cout << "[gRPC] " << request->username() << " joined!" << std::endl;
+        LOG_INFO("gRPC", LogFields().user(request->username()), "Joined");
         reply->set_message("Welcome " + request->username() + "!");
         return g::Status::OK;
     }
 
     Status MakeGuess(g::ServerContext* context, const GuessRequest* request, GuessReply* reply) override {
-        std::cout << "[gRPC] " << request->username() << " guessed: " << request->guess() << std::endl;
+        LOG_TRACE("gRPC", LogFields().user(request->username()), "Guessed: ", request->guess());
         reply->set_correct(request->guess() == "apple");
         reply->set_hint("Try again!");
         return g::Status::OK;
@@ -42,7 +42,7 @@ void StartGrpcServer() {
     builder.RegisterService(&service);
 
     std::unique_ptr<g::Server> server(builder.BuildAndStart());
-    std::cout << "[gRPC] Listening on " << server_address << std::endl;
+    LOG_INFO("gRPC", "Listening on ", server_address);
 
     server->Wait();
 }
@@ -0,0 +1,252 @@
+#include "guessMatcher.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GUESSIO_MATCH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+MatchOptions g_defaults; // written once by main before any io thread starts
+
+// U+00C0..U+017F (Latin-1 Supplement, Latin Extended-A) folded to their
+// lowercase ASCII base letter. '*' expands to two letters (see foldLatin),
+// '.' has no ASCII base and is kept.
+constexpr char32_t kLatinFirst = 0xC0;
+constexpr char kLatinBase[] =
+    "aaaaaa*ceeeeiiiidnooooo.ouuuuy**"
+    "aaaaaa*ceeeeiiiidnooooo.ouuuuy*y"
+    "aaaaaaccccccccddddeeeeeeeeeegggg"
+    "gggghhhhiiiiiiiiii**jjkk.lllllll"
+    "lllnnnnnn...oooooo**rrrrrrssssss"
+    "ssttttttuuuuuuuuuuuuwwyyyzzzzzzs";
+constexpr char32_t kLatinLast = kLatinFirst + sizeof(kLatinBase) - 2;
+
+// Invalid UTF-8 becomes U+FFFD, one byte at a time.
+char32_t decodeUtf8(std::string_view text, std::size_t& i) {
+    auto byte = [&](std::size_t k) { return static_cast<unsigned char>(text[k]); };
+    unsigned char lead = byte(i);
+    std::size_t len = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC2 ? 2 : 0;
+    if (len == 0 || lead > 0xF4 || i + len > text.size()) {
+        ++i;
+        return 0xFFFD;
+    }
+    char32_t cp = lead & (0x7F >> len);
+    for (std::size_t k = 1; k < len; ++k) {
+        unsigned char b = byte(i + k);
+        if ((b & 0xC0) != 0x80) {
+            ++i;
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (b & 0x3F);
+    }
+    if ((len == 3 && cp < 0x800) || (len == 4 && (cp < 0x10000 || cp > 0x10FFFF)) ||
+        (cp >= 0xD800 && cp <= 0xDFFF)) {
+        ++i;
+        return 0xFFFD;
+    }
+    i += len;
+    return cp;
+}
+
+bool isCombiningMark(char32_t c) {
+    return (c >= 0x0300 && c <= 0x036F) || (c >= 0x1AB0 && c <= 0x1AFF) ||
+        (c >= 0x1DC0 && c <= 0x1DFF) || (c >= 0x20D0 && c <= 0x20FF) ||
+        (c >= 0xFE20 && c <= 0xFE2F);
+}
+
+bool isZeroWidth(char32_t c) {
+    return (c >= 0x200B && c <= 0x200D) || c == 0x2060 || c == 0xFEFF;
+}
+
+bool isSpace(char32_t c) {
+    return c == ' ' || (c >= 0x09 && c <= 0x0D) || c == 0x85 || c == 0xA0 || c == 0x1680 ||
+        (c >= 0x2000 && c <= 0x200A) || c == 0x2028 || c == 0x2029 || c == 0x202F ||
+        c == 0x205F || c == 0x3000;
+}
+
+// Greek with tonos or dialytika, to the plain lowercase letter.
+char32_t foldGreekAccent(char32_t c) {
+    switch (c) {
+    case 0x0386: case 0x03AC: return 0x03B1;
+    case 0x0388: case 0x03AD: return 0x03B5;
+    case 0x0389: case 0x03AE: return 0x03B7;
+    case 0x038A: case 0x03AA: case 0x03AF: case 0x03CA: case 0x0390: return 0x03B9;
+    case 0x038C: case 0x03CC: return 0x03BF;
+    case 0x038E: case 0x03AB: case 0x03CD: case 0x03CB: case 0x03B0: return 0x03C5;
+    case 0x038F: case 0x03CE: return 0x03C9;
+    default: return 0;
+    }
+}
+
+// Collects folded code points, dropping leading and trailing whitespace and
+// collapsing runs of it to one space.
+class Folder {
+public:
+    explicit Folder(std::u32string& out) : m_out(out) {}
+
+    void emit(char32_t c) {
+        if (isSpace(c)) {
+            m_space = !m_out.empty();
+            return;
+        }
+        if (m_space) {
+            m_out.push_back(' ');
+            m_space = false;
+        }
+        m_out.push_back(c);
+    }
+
+    void fold(char32_t c) {
+        if (c < 0x80) {
+            emit(c >= 'A' && c <= 'Z' ? c + 0x20 : c);
+        } else if (c >= kLatinFirst && c <= kLatinLast) {
+            foldLatin(c);
+        } else if (c >= 0x0386 && c <= 0x03CE) {
+            char32_t plain = foldGreekAccent(c);
+            if (plain) emit(plain);
+            else if (c >= 0x0391 && c <= 0x03A9) emit(c + 0x20);
+            else emit(c == 0x03C2 ? 0x03C3 : c); // final sigma
+        } else if (c >= 0x0400 && c <= 0x042F) {
+            c += c < 0x0410 ? 0x50 : 0x20;
+            emit(c == 0x0451 ? 0x0435 : c); // ё is written е
+        } else if (c == 0x0451) {
+            emit(0x0435);
+        } else if (c >= 0xFF01 && c <= 0xFF5E) {
+            fold(c - 0xFEE0); // fullwidth ASCII
+        } else if (!isCombiningMark(c) && !isZeroWidth(c)) {
+            emit(c);
+        }
+    }
+
+private:
+    void foldLatin(char32_t c) {
+        char base = kLatinBase[c - kLatinFirst];
+        if (base == '.') {
+            emit(c == 0x014A ? 0x014B : c); // Ŋ
+        } else if (base != '*') {
+            emit(static_cast<char32_t>(base));
+        } else {
+            const char* pair = c == 0xC6 || c == 0xE6 ? "ae"
+                : c == 0xDE || c == 0xFE ? "th"
+                : c == 0xDF ? "ss"
+                : c == 0x132 || c == 0x133 ? "ij"
+                : "oe"; // 0x152, 0x153
+            emit(static_cast<char32_t>(pair[0]));
+            emit(static_cast<char32_t>(pair[1]));
+        }
+    }
+
+    std::u32string& m_out;
+    bool m_space = false;
+};
+}
+
+GuessMatcher::GuessMatcher(const std::string& answer, const MatchOptions& options) {
+    normalize(answer, m_answer);
+    if (m_answer.empty() || m_answer.size() > 64) return;
+
+    m_bound = std::min(options.closeDistance, m_answer.size() / 4);
+    for (std::size_t i = 0; i < m_answer.size(); ++i) {
+        char32_t c = m_answer[i];
+        std::uint64_t bit = std::uint64_t(1) << i;
+        if (c < m_asciiPeq.size()) {
+            m_asciiPeq[c] |= bit;
+            continue;
+        }
+        auto it = std::find_if(m_widePeq.begin(), m_widePeq.end(), [c](const auto& e) { return e.first == c; });
+        if (it != m_widePeq.end()) it->second |= bit;
+        else m_widePeq.emplace_back(c, bit);
+    }
+}
+
+GuessMatcher::Match GuessMatcher::match(std::string_view guess) const {
+    thread_local std::u32string normalized;
+    normalize(guess, normalized);
+    return matchNormalized(normalized);
+}
+
+GuessMatcher::Match GuessMatcher::matchNormalized(const std::u32string& guess) const {
+    if (guess == m_answer) return Match::exact;
+    if (m_bound == 0) return Match::miss;
+    std::size_t m = m_answer.size();
+    std::size_t n = guess.size();
+    if ((m > n ? m - n : n - m) > m_bound) return Match::miss; // each edit changes the length by at most one
+    return distanceWithin(guess, m_bound) <= m_bound ? Match::close : Match::miss;
+}
+
+void GuessMatcher::normalize(std::string_view text, std::u32string& out) {
+    out.clear();
+    out.reserve(text.size());
+    Folder folder(out);
+
+    // Chat is nearly all ASCII: lowercase 16 bytes at a time until the first
+    // block holding a multi-byte sequence, then decode from there.
+    std::size_t i = 0;
+#ifdef GUESSIO_MATCH_SSE2
+    const __m128i beforeA = _mm_set1_epi8('A' - 1);
+    const __m128i afterZ = _mm_set1_epi8('Z' + 1);
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    alignas(16) char lowered[16];
+    for (; i + 16 <= text.size(); i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i));
+        if (_mm_movemask_epi8(v)) break; // a byte >= 0x80
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, beforeA), _mm_cmplt_epi8(v, afterZ));
+        _mm_store_si128(reinterpret_cast<__m128i*>(lowered), _mm_or_si128(v, _mm_and_si128(upper, caseBit)));
+        for (char c : lowered) folder.emit(static_cast<char32_t>(c));
+    }
+#endif
+    while (i < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c < 0x80) {
+            folder.emit(c >= 'A' && c <= 'Z' ? c + 0x20 : c);
+            ++i;
+            continue;
+        }
+        folder.fold(decodeUtf8(text, i));
+    }
+}
+
+std::uint64_t GuessMatcher::peq(char32_t c) const {
+    if (c < m_asciiPeq.size()) return m_asciiPeq[c];
+    for (const auto& e : m_widePeq) {
+        if (e.first == c) return e.second;
+    }
+    return 0;
+}
+
+// Levenshtein distance from m_answer to guess with Myers' bit-vector
+// algorithm, in Hyyrö's formulation for whole-string distance: one column of
+// the DP matrix per guess character, 64 rows at a time. Gives up with
+// bound + 1 as soon as the remaining characters could not bring the
+// distance back within bound.
+std::size_t GuessMatcher::distanceWithin(const std::u32string& guess, std::size_t bound) const {
+    const std::size_t n = guess.size();
+    const std::uint64_t last = std::uint64_t(1) << (m_answer.size() - 1);
+    std::uint64_t pv = ~std::uint64_t(0);
+    std::uint64_t mv = 0;
+    std::size_t score = m_answer.size();
+    for (std::size_t j = 0; j < n; ++j) {
+        std::uint64_t eq = peq(guess[j]);
+        std::uint64_t xv = eq | mv;
+        std::uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        std::uint64_t ph = mv | ~(xh | pv);
+        std::uint64_t mh = pv & xh;
+        if (ph & last) ++score;
+        else if (mh & last) --score;
+        if (score > bound + (n - j - 1)) return bound + 1;
+        ph = (ph << 1) | 1; // row 0 grows by one per column
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return score;
+}
+
+void GuessMatcher::setDefaults(const MatchOptions& options) {
+    g_defaults = options;
+}
+
+MatchOptions GuessMatcher::defaults() {
+    return g_defaults;
+}
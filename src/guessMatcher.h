@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// How forgiving "close guess" feedback is (CLOSE_GUESS_DISTANCE in
+// config.json). A guess is close when it is at most this many edits from
+// the answer, further capped at one edit per four letters of the answer so
+// short words never count as close. 0 turns close guesses off.
+struct MatchOptions {
+    std::size_t closeDistance = 2;
+};
+
+// One round's answer, normalized once so each guess costs a normalization
+// and, when the lengths allow it, one bit-parallel edit distance. Matching
+// ignores case, diacritics and extra whitespace: "Crème  Brûlée" is
+// "creme brulee". Immutable after construction, so it may be shared.
+class GuessMatcher {
+public:
+    enum class Match { miss, close, exact };
+
+    GuessMatcher() = default;
+    GuessMatcher(const std::string& answer, const MatchOptions& options);
+
+    Match match(std::string_view guess) const;
+    // For a guess already passed through normalize().
+    Match matchNormalized(const std::u32string& guess) const;
+
+    // Case folds (Latin, Greek, Cyrillic, fullwidth ASCII), strips
+    // diacritics, trims and collapses whitespace. Invalid UTF-8 bytes become
+    // U+FFFD. out is overwritten.
+    static void normalize(std::string_view text, std::u32string& out);
+
+    // Process-wide default (CLOSE_GUESS_DISTANCE in config.json).
+    static void setDefaults(const MatchOptions& options);
+    static MatchOptions defaults();
+
+private:
+    std::size_t distanceWithin(const std::u32string& guess, std::size_t bound) const;
+    std::uint64_t peq(char32_t c) const;
+
+    std::u32string m_answer;
+    std::size_t m_bound = 0; // close if within this many edits
+    // Myers' pattern bitmasks: bit i set where m_answer[i] == c. Only built
+    // for answers of at most 64 code points; longer ones match exactly.
+    std::array<std::uint64_t, 128> m_asciiPeq{};
+    std::vector<std::pair<char32_t, std::uint64_t>> m_widePeq;
+};
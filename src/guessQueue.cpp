@@ -0,0 +1,77 @@
+#include "guessQueue.h"
+#include <algorithm>
+
+namespace {
+GuessOptions g_defaults; // written once by main before any io thread starts
+}
+
+bool GuessQueue::push(std::string user, std::string word, std::size_t maxPending) {
+    if (m_pending.size() >= maxPending) return false;
+    m_pending.push_back({ std::move(user), std::move(word) });
+    return true;
+}
+
+void GuessQueue::clear() {
+    m_pending.clear();
+    m_seen.clear();
+    m_tickSeen.clear();
+}
+
+GuessQueue::Verdict GuessQueue::adjudicate(const GuessMatcher& matcher, std::size_t recentLimit, std::size_t maxSeen) {
+    Verdict verdict;
+    m_tickSeen.clear();
+    std::u32string normalized;
+    std::string key;
+    std::vector<std::size_t> wrong;
+    std::vector<std::size_t> close;
+    wrong.reserve(m_pending.size());
+    for (std::size_t i = 0; i < m_pending.size(); ++i) {
+        GuessMatcher::normalize(m_pending[i].word, normalized);
+        GuessMatcher::Match match = matcher.matchNormalized(normalized);
+        if (match == GuessMatcher::Match::exact) {
+            verdict.correct = true;
+            verdict.winner = std::move(m_pending[i]);
+            m_pending.clear();
+            return verdict;
+        }
+
+        key.assign(m_pending[i].user);
+        key += '\0';
+        key.append(reinterpret_cast<const char*>(normalized.data()), normalized.size() * sizeof(char32_t));
+        bool fresh;
+        if (m_seen.size() < maxSeen) {
+            fresh = m_seen.insert(key).second;
+        } else {
+            // Full: what is remembered still repeats, anything else only
+            // within this tick.
+            fresh = !m_seen.count(key) && m_tickSeen.insert(key).second;
+            if (fresh) ++verdict.unremembered;
+        }
+        if (!fresh) {
+            ++verdict.duplicates;
+            continue;
+        }
+        wrong.push_back(i);
+        if (match == GuessMatcher::Match::close && close.size() < recentLimit) close.push_back(i);
+    }
+    verdict.wrong = wrong.size();
+
+    verdict.close.reserve(close.size());
+    for (std::size_t i : close) verdict.close.push_back(m_pending[i]);
+
+    std::size_t first = wrong.size() > recentLimit ? wrong.size() - recentLimit : 0;
+    verdict.recent.reserve(wrong.size() - first);
+    for (std::size_t i = first; i < wrong.size(); ++i)
+        verdict.recent.push_back(std::move(m_pending[wrong[i]]));
+
+    m_pending.clear();
+    return verdict;
+}
+
+void GuessQueue::setDefaults(const GuessOptions& options) {
+    g_defaults = options;
+}
+
+GuessOptions GuessQueue::defaults() {
+    return g_defaults;
+}
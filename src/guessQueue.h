@@ -0,0 +1,58 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "guessMatcher.h"
+
+// Chat guesses are not judged one by one: a room queues them and settles
+// the queue once per tick (GUESS_* in config.json).
+struct GuessOptions {
+    std::chrono::milliseconds tick{ 100 };
+    std::size_t recentLimit = 20;  // wrong guesses listed in a tick's summary
+    std::size_t maxPending = 4096; // queued per tick; the rest are dropped
+    std::size_t maxSeen = 16384;   // wrong guesses remembered per round
+};
+
+// One room's guesses for the current tick, plus the wrong guesses already
+// reported this round so repeats are dropped. At most maxSeen are
+// remembered; past that, new wrong guesses are only deduplicated within
+// their own tick. Not thread-safe; lives on the room's strand.
+class GuessQueue {
+public:
+    struct Guess {
+        std::string user;
+        std::string word;
+    };
+
+    struct Verdict {
+        bool correct = false;
+        Guess winner;                 // first correct guess of the tick, if any
+        std::size_t wrong = 0;        // wrong guesses not seen before this round
+        std::size_t duplicates = 0;   // same user and word again this round
+        std::size_t unremembered = 0; // wrong ones past maxSeen, not kept for the round
+        std::vector<Guess> recent;    // last recentLimit wrong guesses, oldest first
+        std::vector<Guess> close;     // first recentLimit of them that were close
+    };
+
+    // False if the tick already holds maxPending guesses.
+    bool push(std::string user, std::string word, std::size_t maxPending);
+    bool empty() const { return m_pending.empty(); }
+    void clear(); // new round: forgets what was guessed
+
+    // Settles and empties the queue. The first correct guess in arrival
+    // order wins; when there is one the wrong guesses are not reported, the
+    // round is over. Repeats are judged on the normalized word, so "Tiger"
+    // after "tiger" is one.
+    Verdict adjudicate(const GuessMatcher& matcher, std::size_t recentLimit, std::size_t maxSeen);
+
+    // Process-wide defaults (GUESS_* in config.json).
+    static void setDefaults(const GuessOptions& options);
+    static GuessOptions defaults();
+
+private:
+    std::vector<Guess> m_pending;
+    std::unordered_set<std::string> m_seen;     // user '\0' normalized word, this round
+    std::unordered_set<std::string> m_tickSeen; // the same, this tick, once m_seen is full
+};
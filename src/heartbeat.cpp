@@ -0,0 +1,78 @@
+#include "heartbeat.h"
+#include "session.h"
+#include "metrics.h"
+#include <algorithm>
+
+HeartbeatService::HeartbeatService(boost::asio::io_context& io)
+    : m_strand(boost::asio::make_strand(io)),
+    m_timer(m_strand) {
+}
+
+void HeartbeatService::start(std::chrono::milliseconds interval, std::chrono::milliseconds tick) {
+    boost::asio::dispatch(m_strand, [this, interval, tick]() {
+        m_tick = std::max(tick, std::chrono::milliseconds(1));
+        std::size_t slots = static_cast<std::size_t>(std::max<long long>(1, interval.count() / m_tick.count()));
+        m_slots.assign(slots, {});
+        m_cursor = 0;
+        m_running = true;
+        m_nextTick = std::chrono::steady_clock::now();
+        scheduleTick();
+    });
+}
+
+void HeartbeatService::stop() {
+    boost::asio::dispatch(m_strand, [this]() {
+        m_running = false;
+        m_timer.cancel();
+    });
+}
+
+void HeartbeatService::add(std::weak_ptr<Session> session) {
+    boost::asio::post(m_strand, [this, session = std::move(session)]() mutable {
+        if (m_slots.empty()) return;
+        // The slot just behind the cursor is the last one visited before a
+        // full revolution, i.e. one interval from now.
+        std::size_t slot = (m_cursor + m_slots.size() - 1) % m_slots.size();
+        m_slots[slot].push_back(std::move(session));
+        Metrics::instance().heartbeatTracked.fetch_add(1, std::memory_order_relaxed);
+    });
+}
+
+void HeartbeatService::scheduleTick() {
+    // Absolute deadlines so slow ticks don't accumulate drift.
+    m_nextTick += m_tick;
+    m_timer.expires_at(m_nextTick);
+    m_timer.async_wait([this](boost::system::error_code ec) {
+        if (ec || !m_running) return;
+        onTick();
+        scheduleTick();
+    });
+}
+
+void HeartbeatService::onTick() {
+    auto& bucket = m_slots[m_cursor];
+    m_cursor = (m_cursor + 1) % m_slots.size();
+
+    auto& metrics = Metrics::instance();
+    std::uint64_t pinged = 0;
+    std::uint64_t dropped = 0;
+
+    // Survivors are compacted in place and stay in this slot for the next
+    // revolution; expired or dead sessions fall out.
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < bucket.size(); ++i) {
+        auto session = bucket[i].lock();
+        if (session && session->heartbeat()) {
+            if (kept != i) bucket[kept] = std::move(bucket[i]);
+            ++kept;
+            ++pinged;
+        }
+        else {
+            ++dropped;
+        }
+    }
+    bucket.resize(kept);
+
+    metrics.heartbeatPings.fetch_add(pinged, std::memory_order_relaxed);
+    metrics.heartbeatTracked.fetch_sub(dropped, std::memory_order_relaxed);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+class Session;
+
+// Liveness tracking for every session on one hashed timing wheel instead of
+// a steady_timer per connection. The wheel has interval / tick slots and a
+// single timer; each tick visits one slot, pings everything in it that
+// answered since its last visit and closes everything that didn't. All
+// deadlines are exactly one interval out, so a session simply stays in its
+// slot and each visit is O(1) per session.
+class HeartbeatService {
+public:
+    explicit HeartbeatService(boost::asio::io_context& io);
+
+    void start(std::chrono::milliseconds interval, std::chrono::milliseconds tick);
+    void stop();
+
+    // Thread-safe. The first ping goes out one interval after add().
+    void add(std::weak_ptr<Session> session);
+
+private:
+    void scheduleTick();
+    void onTick();
+
+    boost::asio::strand<boost::asio::io_context::executor_type> m_strand;
+    boost::asio::steady_timer m_timer;
+    std::chrono::milliseconds m_tick{ 1000 };
+    std::chrono::steady_clock::time_point m_nextTick;
+
+    std::vector<std::vector<std::weak_ptr<Session>>> m_slots; // strand only
+    std::size_t m_cursor = 0;                                  // strand only
+    bool m_running = false;                                    // strand only
+};
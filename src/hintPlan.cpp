@@ -0,0 +1,66 @@
+#include "hintPlan.h"
+#include <algorithm>
+#include <random>
+
+namespace {
+HintOptions g_defaults; // written once by main before any io thread starts
+
+std::mt19937& engine() {
+    thread_local std::mt19937 rng{ std::random_device{}() };
+    return rng;
+}
+}
+
+HintPlan::HintPlan(const std::string& word, std::chrono::milliseconds duration, const HintOptions& options)
+    : m_word(word) {
+    for (std::size_t i = 0; i < m_word.size(); ++i) {
+        if ((static_cast<unsigned char>(m_word[i]) & 0xC0) != 0x80) m_starts.push_back(i); // not a continuation byte
+    }
+    std::size_t glyphs = m_starts.size();
+    m_starts.push_back(m_word.size());
+
+    m_shown.assign(glyphs, false);
+    std::vector<std::size_t> letters;
+    for (std::size_t g = 0; g < glyphs; ++g) {
+        if (m_word[m_starts[g]] == ' ') m_shown[g] = true;
+        else letters.push_back(g);
+    }
+    rebuildHint();
+
+    double fraction = std::min(std::max(options.revealFraction, 0.0), 1.0);
+    std::size_t count = static_cast<std::size_t>(static_cast<double>(letters.size()) * fraction);
+    if (!letters.empty()) count = std::min(count, letters.size() - 1);
+    if (count == 0) return;
+
+    std::shuffle(letters.begin(), letters.end(), engine());
+    m_reveals.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        // n reveals split the round into n + 1 gaps: none at the start, none
+        // at the buzzer.
+        auto at = duration * static_cast<long long>(i + 1) / static_cast<long long>(count + 1);
+        m_reveals.push_back({ std::chrono::duration_cast<std::chrono::milliseconds>(at), letters[i] });
+    }
+}
+
+std::string HintPlan::reveal() {
+    std::size_t g = m_reveals[m_next++].index;
+    m_shown[g] = true;
+    rebuildHint();
+    return m_word.substr(m_starts[g], m_starts[g + 1] - m_starts[g]);
+}
+
+void HintPlan::rebuildHint() {
+    m_hint.clear();
+    for (std::size_t g = 0; g + 1 < m_starts.size(); ++g) {
+        if (m_shown[g]) m_hint.append(m_word, m_starts[g], m_starts[g + 1] - m_starts[g]);
+        else m_hint += '_';
+    }
+}
+
+void HintPlan::setDefaults(const HintOptions& options) {
+    g_defaults = options;
+}
+
+HintOptions HintPlan::defaults() {
+    return g_defaults;
+}
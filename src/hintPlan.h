@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// How much of the word a round gives away. revealFraction of its letters
+// (rounded down, never all of them) are uncovered one at a time, evenly
+// spaced over the round. 0 keeps the hint fully masked.
+struct HintOptions {
+    double revealFraction = 0.5;
+};
+
+// One round's hint: the masked word and the reveals still to come, both
+// fixed when the round starts so a reveal is just the next entry. Positions
+// are code points, so a multi-byte letter is one '_' and one reveal. Spaces
+// are never masked. Not thread-safe; owned by the room's round.
+class HintPlan {
+public:
+    struct Reveal {
+        std::chrono::milliseconds at; // since round start
+        std::size_t index;            // code point position in the word
+    };
+
+    HintPlan() = default;
+    HintPlan(const std::string& word, std::chrono::milliseconds duration, const HintOptions& options);
+
+    const std::string& hint() const { return m_hint; }
+    bool done() const { return m_next == m_reveals.size(); }
+    const Reveal& next() const { return m_reveals[m_next]; } // !done()
+
+    // Uncovers next(); returns the letter (UTF-8) now shown at its index.
+    std::string reveal();
+
+    // Process-wide default (HINT_REVEAL_FRACTION in config.json).
+    static void setDefaults(const HintOptions& options);
+    static HintOptions defaults();
+
+private:
+    void rebuildHint();
+
+    std::string m_word;
+    std::vector<std::size_t> m_starts; // byte offset of each code point, plus m_word.size()
+    std::vector<bool> m_shown;
+    std::vector<Reveal> m_reveals;
+    std::size_t m_next = 0;
+    std::string m_hint;
+};
@@ -0,0 +1,90 @@
+#include "ircMessage.h"
+
+namespace {
+// Splits the next space-delimited token off rest. Leading spaces are skipped
+// first.
+std::string_view nextToken(std::string_view& rest) {
+    std::size_t start = rest.find_first_not_of(' ');
+    if (start == std::string_view::npos) {
+        rest = {};
+        return {};
+    }
+    rest.remove_prefix(start);
+    std::size_t end = rest.find(' ');
+    std::string_view token = rest.substr(0, end);
+    rest.remove_prefix(end == std::string_view::npos ? rest.size() : end);
+    return token;
+}
+}
+
+bool IrcMessage::parse(std::string_view line, IrcMessage& out) {
+    out = IrcMessage();
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+    std::string_view rest = line;
+    if (!rest.empty() && rest.front() == '@') {
+        rest.remove_prefix(1);
+        out.tags = nextToken(rest);
+    }
+    std::size_t start = rest.find_first_not_of(' ');
+    if (start != std::string_view::npos && rest[start] == ':') {
+        rest.remove_prefix(start + 1);
+        out.prefix = nextToken(rest);
+    }
+    out.command = nextToken(rest);
+    if (out.command.empty()) return false;
+
+    while (out.paramCount < kMaxParams) {
+        start = rest.find_first_not_of(' ');
+        if (start == std::string_view::npos) break;
+        rest.remove_prefix(start);
+        if (rest.front() == ':' || out.paramCount == kMaxParams - 1) {
+            if (rest.front() == ':') rest.remove_prefix(1);
+            out.params[out.paramCount++] = rest;
+            break;
+        }
+        out.params[out.paramCount++] = nextToken(rest);
+    }
+    return true;
+}
+
+std::string_view IrcMessage::tag(std::string_view key) const {
+    std::string_view rest = tags;
+    while (!rest.empty()) {
+        std::size_t end = rest.find(';');
+        std::string_view item = rest.substr(0, end);
+        rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+
+        std::size_t eq = item.find('=');
+        if (item.substr(0, eq) != key) continue;
+        return eq == std::string_view::npos ? std::string_view() : item.substr(eq + 1);
+    }
+    return {};
+}
+
+std::string_view IrcMessage::nick() const {
+    return prefix.substr(0, prefix.find('!'));
+}
+
+std::string_view IrcMessage::unescape(std::string_view raw, std::string& scratch) {
+    std::size_t slash = raw.find('\\');
+    if (slash == std::string_view::npos) return raw;
+
+    scratch.assign(raw.data(), slash);
+    for (std::size_t i = slash; i < raw.size(); ++i) {
+        char c = raw[i];
+        if (c != '\\') {
+            scratch += c;
+            continue;
+        }
+        if (++i == raw.size()) break; // lone trailing backslash
+        switch (raw[i]) {
+        case ':': scratch += ';'; break;
+        case 's': scratch += ' '; break;
+        case 'r': scratch += '\r'; break;
+        case 'n': scratch += '\n'; break;
+        default: scratch += raw[i]; break; // includes "\\"
+        }
+    }
+    return scratch;
+}
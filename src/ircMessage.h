@@ -0,0 +1,41 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// One IRC line (RFC 1459 framing plus IRCv3 message tags), parsed in place:
+// every field is a view into the line, so the line must outlive the
+// message. Parsing never allocates.
+//
+//   [@tags ][:prefix ]command[ middle...][ :trailing]
+//
+// Runs of spaces between fields are accepted. A trailing parameter may hold
+// spaces and colons; it is always the last entry in params.
+struct IrcMessage {
+    static constexpr std::size_t kMaxParams = 15;
+
+    std::string_view tags;    // raw "key=value;key2", without the '@'
+    std::string_view prefix;  // "nick!user@host" or a server name, without the ':'
+    std::string_view command; // "PRIVMSG", "PING", "001", ...
+    std::array<std::string_view, kMaxParams> params{};
+    std::size_t paramCount = 0;
+
+    // False for an empty line or one with no command. A trailing '\r' is
+    // ignored; the 15th parameter takes the rest of the line.
+    static bool parse(std::string_view line, IrcMessage& out);
+
+    std::string_view param(std::size_t i) const { return i < paramCount ? params[i] : std::string_view(); }
+    std::string_view lastParam() const { return paramCount ? params[paramCount - 1] : std::string_view(); }
+    // Escaped value of a tag; empty if the tag is absent or has no value.
+    std::string_view tag(std::string_view key) const;
+    // Prefix up to '!', or the whole prefix for a server.
+    std::string_view nick() const;
+
+    // Decodes an IRCv3 tag value (\: \s \\ \r \n; any other escaped
+    // character stands for itself, a lone trailing '\' is dropped). Returns
+    // raw itself when there is nothing to decode, otherwise decodes into
+    // scratch and returns a view of it; a reused scratch stops allocating
+    // once it has grown to the longest value.
+    static std::string_view unescape(std::string_view raw, std::string& scratch);
+};
@@ -0,0 +1,105 @@
+#include "ircSendQueue.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+IrcSendQueue::Budget::Budget(const SendBudget& budget, Clock::time_point now)
+    : last(now) {
+    // Half up front, the rest spread over the window: a burst and a full
+    // window of refill together stay within count.
+    unsigned upFront = std::max(1u, budget.count / 2);
+    unsigned spread = std::max(1u, budget.count - std::min(budget.count, upFront));
+    double windowMs = static_cast<double>(std::max<std::chrono::milliseconds::rep>(1, budget.window.count()));
+    capacity = upFront;
+    tokens = capacity;
+    perMs = spread / windowMs;
+}
+
+void IrcSendQueue::Budget::refill(Clock::time_point now) {
+    if (now <= last) return;
+    double ms = std::chrono::duration<double, std::milli>(now - last).count();
+    tokens = std::min(capacity, tokens + ms * perMs);
+    last = now;
+}
+
+IrcSendQueue::Clock::duration IrcSendQueue::Budget::untilNext() const {
+    double ms = std::ceil((1.0 - tokens) / perMs);
+    return std::chrono::milliseconds(std::max(1LL, static_cast<long long>(ms)));
+}
+
+IrcSendQueue::IrcSendQueue(const IrcSendOptions& options, Clock::time_point now)
+    : m_options(options),
+    m_join(options.join, now),
+    m_chat(options.chat, now) {
+}
+
+bool IrcSendQueue::push(IrcPriority priority, std::string line) {
+    auto& lines = m_lines[static_cast<std::size_t>(priority)];
+    lines.push_back(std::move(line));
+    if (priority == IrcPriority::chat && lines.size() > m_options.maxQueuedChat) {
+        lines.pop_front();
+        return false;
+    }
+    return true;
+}
+
+std::size_t IrcSendQueue::take(Clock::time_point now, std::string& out, Clock::duration& retryIn) {
+    out.clear();
+    retryIn = Clock::duration::zero();
+    m_join.refill(now);
+    m_chat.refill(now);
+
+    std::size_t taken = 0;
+    bool full = false;
+    auto drain = [&](std::deque<std::string>& lines, Budget* budget) {
+        while (!full && !lines.empty()) {
+            const std::string& line = lines.front();
+            if (taken > 0 && out.size() + line.size() + 2 > m_options.maxBatchBytes) {
+                full = true; // the write after this one picks up from here
+                return;
+            }
+            if (budget && budget->tokens < 1.0) {
+                Clock::duration wait = budget->untilNext();
+                if (retryIn == Clock::duration::zero() || wait < retryIn) retryIn = wait;
+                return;
+            }
+            if (budget) budget->tokens -= 1.0;
+            out += line;
+            out += "\r\n";
+            lines.pop_front();
+            ++taken;
+        }
+    };
+    drain(m_lines[static_cast<std::size_t>(IrcPriority::control)], nullptr);
+    drain(m_lines[static_cast<std::size_t>(IrcPriority::join)], m_options.join.count ? &m_join : nullptr);
+    drain(m_lines[static_cast<std::size_t>(IrcPriority::chat)], m_options.chat.count ? &m_chat : nullptr);
+    if (full) retryIn = Clock::duration::zero();
+    return taken;
+}
+
+bool IrcSendQueue::empty() const {
+    return std::all_of(m_lines.begin(), m_lines.end(), [](const auto& lines) { return lines.empty(); });
+}
+
+void IrcSendQueue::dropBudgeted() {
+    m_lines[static_cast<std::size_t>(IrcPriority::join)].clear();
+    m_lines[static_cast<std::size_t>(IrcPriority::chat)].clear();
+}
+
+void IrcSendQueue::adopt(IrcSendQueue& previous, Clock::time_point now) {
+    auto& chat = m_lines[static_cast<std::size_t>(IrcPriority::chat)];
+    auto& older = previous.m_lines[static_cast<std::size_t>(IrcPriority::chat)];
+    chat.insert(chat.begin(), std::make_move_iterator(older.begin()), std::make_move_iterator(older.end()));
+    older.clear();
+    while (chat.size() > m_options.maxQueuedChat) chat.pop_front();
+    previous.dropBudgeted();
+
+    // Both buckets refill at the same rate, so the emptier one is the
+    // tighter bound on what the user has sent lately.
+    for (auto [mine, theirs] : { std::pair(&m_join, &previous.m_join), std::pair(&m_chat, &previous.m_chat) }) {
+        mine->refill(now);
+        theirs->refill(now);
+        mine->tokens = std::min(mine->tokens, theirs->tokens);
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <string>
+
+// What a line costs against Twitch's send limits.
+enum class IrcPriority {
+    control, // CAP, PASS, NICK, PONG, PART, QUIT: never held back
+    join,    // JOIN: Twitch allows 20 per 10 s
+    chat,    // PRIVMSG: 20 per 30 s, 100 for a moderator
+};
+
+// At most count lines in any window (TWITCH_*_LIMIT in config.json); 0
+// turns the budget off.
+struct SendBudget {
+    unsigned count;
+    std::chrono::milliseconds window;
+};
+
+struct IrcSendOptions {
+    SendBudget join{ 20, std::chrono::seconds(10) };
+    SendBudget chat{ 20, std::chrono::seconds(30) };
+    std::size_t maxBatchBytes = 4096; // lines coalesced into one write
+    std::size_t maxQueuedChat = 100;  // older chat lines are dropped beyond this
+};
+
+// One connection's outgoing lines. Lines leave in priority order and,
+// within a priority, in the order they were pushed; join and chat lines
+// also wait for their budget. Each budget is a token bucket holding half
+// of count, refilled with the other half over the window, so no window
+// ever sees more than count. Not thread-safe; owned by the connection's
+// strand.
+class IrcSendQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit IrcSendQueue(const IrcSendOptions& options, Clock::time_point now = Clock::now());
+
+    // line without "\r\n". False if it pushed an older chat line out.
+    bool push(IrcPriority priority, std::string line);
+
+    // Replaces out with the lines that may go now, "\r\n" terminated, up to
+    // maxBatchBytes (always at least one). Returns how many. If lines are
+    // left waiting for budget, retryIn says when the next one may go;
+    // otherwise it is zero.
+    std::size_t take(Clock::time_point now, std::string& out, Clock::duration& retryIn);
+
+    bool empty() const;
+    void dropBudgeted(); // closing: only control lines are still worth sending
+    // Takes over a replaced connection's chat lines, ahead of any pushed
+    // here, and its spent budget: Twitch counts per user, not per
+    // connection, so a reconnect must not start with a fresh burst.
+    void adopt(IrcSendQueue& previous, Clock::time_point now = Clock::now());
+
+private:
+    struct Budget {
+        double tokens;
+        double capacity;
+        double perMs; // refill
+        Clock::time_point last;
+
+        Budget(const SendBudget& budget, Clock::time_point now);
+        void refill(Clock::time_point now);
+        Clock::duration untilNext() const; // tokens < 1
+    };
+
+    IrcSendOptions m_options;
+    std::array<std::deque<std::string>, 3> m_lines; // by IrcPriority
+    Budget m_join;
+    Budget m_chat;
+};
@@ -0,0 +1,214 @@
+#include "logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+namespace {
+const char* levelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::trace: return "TRACE";
+    case LogLevel::debug: return "DEBUG";
+    case LogLevel::info: return "INFO ";
+    case LogLevel::warn: return "WARN ";
+    case LogLevel::error: return "ERROR";
+    default: return "?    ";
+    }
+}
+
+// Ties a thread's ring to the thread's lifetime; the writer releases the
+// ring once it is orphaned and empty.
+template <typename RingPtr>
+struct RingHandle {
+    RingPtr ring;
+    ~RingHandle() {
+        if (ring) ring->orphaned.store(true, std::memory_order_release);
+    }
+};
+}
+
+Logger& Logger::instance() {
+    // Never destroyed: detached threads may still log during exit. The
+    // writer is stopped and drained by shutdown(), registered with atexit.
+    static Logger* logger = [] {
+        auto* l = new Logger();
+        std::atexit([] { Logger::instance().shutdown(); });
+        return l;
+    }();
+    return *logger;
+}
+
+Logger::Logger() : m_writer([this] { run(); }) {
+}
+
+Logger::Ring& Logger::localRing() {
+    thread_local RingHandle<std::shared_ptr<Ring>> handle;
+    if (!handle.ring) {
+        handle.ring = std::make_shared<Ring>();
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        m_rings.push_back(handle.ring);
+    }
+    return *handle.ring;
+}
+
+LogRecord* Logger::claim(Ring& ring) {
+    std::size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= kRingSize) return nullptr;
+    return &ring.slots[head & (kRingSize - 1)];
+}
+
+void Logger::commit(Ring& ring, LogLevel level) {
+    std::size_t head = ring.head.load(std::memory_order_relaxed) + 1;
+    ring.head.store(head, std::memory_order_release);
+    // The writer polls; wake it early for warnings and errors, and when a
+    // burst has filled half the ring.
+    if (level >= LogLevel::warn ||
+        head - ring.tail.load(std::memory_order_relaxed) == kRingSize / 2)
+        m_wake.notify_one();
+}
+
+void Logger::put(LogRecord& r, std::string_view s) {
+    std::size_t room = LogRecord::kTextSize - r.textLen;
+    if (s.size() > room) {
+        s = s.substr(0, room);
+        r.truncated = true;
+    }
+    std::memcpy(r.text + r.textLen, s.data(), s.size());
+    r.textLen = static_cast<std::uint16_t>(r.textLen + s.size());
+}
+
+void Logger::put(LogRecord& r, double v) {
+    char buf[32];
+    int n = std::snprintf(buf, sizeof(buf), "%g", v);
+    if (n > 0) put(r, std::string_view(buf, std::min<std::size_t>(static_cast<std::size_t>(n), sizeof(buf) - 1)));
+}
+
+void Logger::put(LogRecord& r, const LogFields& f) {
+    r.roomLen = static_cast<std::uint8_t>(std::min(f.m_room.size(), LogRecord::kFieldSize));
+    std::memcpy(r.room, f.m_room.data(), r.roomLen);
+    r.userLen = static_cast<std::uint8_t>(std::min(f.m_user.size(), LogRecord::kFieldSize));
+    std::memcpy(r.user, f.m_user.data(), r.userLen);
+    r.session = f.m_session;
+}
+
+void Logger::format(const LogRecord& r, std::string& line) {
+    using namespace std::chrono;
+    // localtime is slow; only redo it when the second changes.
+    auto t = system_clock::to_time_t(r.time);
+    if (t != m_stampSecond) {
+        std::tm tm{};
+#ifdef _WIN32
+        localtime_s(&tm, &t);
+#else
+        localtime_r(&t, &tm);
+#endif
+        std::snprintf(m_stamp, sizeof(m_stamp), "%02d:%02d:%02d.", tm.tm_hour, tm.tm_min, tm.tm_sec);
+        m_stampSecond = t;
+    }
+    auto ms = static_cast<int>(duration_cast<milliseconds>(r.time.time_since_epoch()).count() % 1000);
+    char msText[5] = { char('0' + ms / 100), char('0' + ms / 10 % 10), char('0' + ms % 10), ' ', '\0' };
+
+    line.clear();
+    line += m_stamp;
+    line += msText;
+    line += levelName(r.level);
+    line += " [";
+    line += r.tag;
+    line += "] ";
+    line.append(r.text, r.textLen);
+    if (r.truncated) line += "...";
+    if (r.roomLen) line.append(" room=").append(r.room, r.roomLen);
+    if (r.session) line.append(" session=").append(std::to_string(r.session));
+    if (r.userLen) line.append(" user=").append(r.user, r.userLen);
+    line += '\n';
+}
+
+std::size_t Logger::drain(std::string& line) {
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        rings = m_rings;
+    }
+
+    std::size_t written = 0;
+    for (auto& ring : rings) {
+        std::size_t tail = ring->tail.load(std::memory_order_relaxed);
+        std::size_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail) {
+            const LogRecord& r = ring->slots[tail & (kRingSize - 1)];
+            format(r, line);
+            std::fwrite(line.data(), 1, line.size(), r.level >= LogLevel::warn ? stderr : stdout);
+            ++written;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+    std::uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+    if (dropped != m_reportedDropped) {
+        std::fprintf(stderr, "[LOG] %llu records dropped (ring full)\n",
+            static_cast<unsigned long long>(dropped - m_reportedDropped));
+        m_reportedDropped = dropped;
+        ++written;
+    }
+    if (written) {
+        std::fflush(stdout);
+        std::fflush(stderr);
+    }
+
+    // Drop rings whose threads have exited and whose records are all out.
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    m_rings.erase(std::remove_if(m_rings.begin(), m_rings.end(), [](const std::shared_ptr<Ring>& r) {
+        return r->orphaned.load(std::memory_order_acquire) &&
+            r->tail.load(std::memory_order_relaxed) == r->head.load(std::memory_order_acquire);
+        }), m_rings.end());
+    return written;
+}
+
+void Logger::run() {
+    std::string line;
+    line.reserve(512);
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    while (m_running.load(std::memory_order_relaxed)) {
+        m_wake.wait_for(lock, std::chrono::milliseconds(10));
+        lock.unlock();
+        drain(line);
+        lock.lock();
+        ++m_drainPasses;
+        m_drained.notify_all();
+    }
+    lock.unlock();
+    drain(line);
+}
+
+void Logger::flush() {
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    // The second completed pass is guaranteed to have started after this call.
+    std::uint64_t target = m_drainPasses + 2;
+    while (m_drainPasses < target && m_running.load(std::memory_order_relaxed)) {
+        m_wake.notify_one();
+        m_drained.wait(lock);
+    }
+}
+
+void Logger::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        if (!m_running.exchange(false)) return;
+        m_drained.notify_all();
+    }
+    m_wake.notify_one();
+    if (m_writer.joinable()) m_writer.join();
+}
+
+bool Logger::parseLevel(std::string_view name, LogLevel& out) {
+    static const std::pair<std::string_view, LogLevel> kNames[] = {
+        {"trace", LogLevel::trace}, {"debug", LogLevel::debug}, {"info", LogLevel::info},
+        {"warn", LogLevel::warn}, {"error", LogLevel::error}, {"off", LogLevel::off}
+    };
+    for (const auto& [n, level] : kNames) {
+        if (n == name) {
+            out = level;
+            return true;
+        }
+    }
+    return false;
+}
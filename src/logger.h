@@ -0,0 +1,188 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+enum class LogLevel : int { trace = 0, debug, info, warn, error, off };
+
+// Levels below this are compiled out: the LOG_* macros expand to an
+// if constexpr that drops the call, arguments included. Override with
+// /DGUESSIO_LOG_LEVEL=n (0 = trace ... 5 = off).
+#ifndef GUESSIO_LOG_LEVEL
+#ifdef NDEBUG
+#define GUESSIO_LOG_LEVEL 2 // info
+#else
+#define GUESSIO_LOG_LEVEL 1 // debug
+#endif
+#endif
+
+// Structured context for a record. Holds views only; the bytes are copied
+// into the record by write() and turned into "room=.. session=.. user=.."
+// by the writer thread, never on the calling thread.
+class LogFields {
+public:
+    LogFields& room(std::string_view r) { m_room = r; return *this; }
+    LogFields& user(std::string_view u) { m_user = u; return *this; }
+    LogFields& session(std::uint64_t id) { m_session = id; return *this; }
+
+private:
+    friend class Logger;
+    std::string_view m_room;
+    std::string_view m_user;
+    std::uint64_t m_session = 0;
+};
+
+// Fixed-size slot in a thread's ring; filling one never allocates.
+struct LogRecord {
+    static constexpr std::size_t kTextSize = 256;
+    static constexpr std::size_t kFieldSize = 48;
+
+    std::chrono::system_clock::time_point time;
+    LogLevel level = LogLevel::info;
+    const char* tag = "";                 // string literal, e.g. "ROOM"
+    std::uint64_t session = 0;
+    std::uint16_t textLen = 0;
+    std::uint8_t roomLen = 0;
+    std::uint8_t userLen = 0;
+    bool truncated = false;
+    char text[kTextSize];
+    char room[kFieldSize];
+    char user[kFieldSize];
+};
+
+// Asynchronous logger. Each thread that logs gets its own single-producer
+// ring of LogRecords, registered on first use; a background thread drains
+// every ring, formats and writes (info and below to stdout, warn and error
+// to stderr). Producers never lock or block: when a ring is full the record
+// is dropped and counted.
+//
+//   LOG_INFO("ROOM", "Creating new room: ", roomId);
+//   LOG_WARN("SESSION", LogFields().session(id()), "Heartbeat timeout");
+//
+// Message arguments may be strings, string_views, C strings, chars, bools,
+// integers and floating point values; a LogFields argument anywhere in the
+// list sets the record's structured fields instead of adding text.
+class Logger {
+public:
+    static Logger& instance();
+
+    void setLevel(LogLevel level) { m_level.store(static_cast<int>(level), std::memory_order_relaxed); }
+    bool enabled(LogLevel level) const {
+        return static_cast<int>(level) >= m_level.load(std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    void write(LogLevel level, const char* tag, const Args&... args);
+
+    // Blocks until everything logged before the call has been written.
+    void flush();
+    // Drains, stops the writer thread; later records are dropped. Runs at exit.
+    void shutdown();
+
+    std::uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    static bool parseLevel(std::string_view name, LogLevel& out);
+
+private:
+    static constexpr std::size_t kRingSize = 1024; // power of two
+
+    struct Ring {
+        std::array<LogRecord, kRingSize> slots;
+        std::atomic<std::size_t> head{ 0 };   // next slot to write (producer)
+        std::atomic<std::size_t> tail{ 0 };   // next slot to read (writer)
+        std::atomic<bool> orphaned{ false };  // owning thread has exited
+    };
+
+    Logger();
+    Ring& localRing();
+    LogRecord* claim(Ring& ring);
+    void commit(Ring& ring, LogLevel level);
+    void run();
+    std::size_t drain(std::string& line);
+    void format(const LogRecord& r, std::string& line);
+
+    static void put(LogRecord& r, std::string_view s);
+    static void put(LogRecord& r, const char* s) { put(r, std::string_view(s ? s : "(null)")); }
+    static void put(LogRecord& r, const std::string& s) { put(r, std::string_view(s)); }
+    static void put(LogRecord& r, char c) { put(r, std::string_view(&c, 1)); }
+    static void put(LogRecord& r, bool b) { put(r, b ? std::string_view("true") : std::string_view("false")); }
+    static void put(LogRecord& r, double v);
+    static void put(LogRecord& r, const LogFields& f);
+
+    template <typename T>
+    static std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, char>>
+        put(LogRecord& r, T v) {
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof(buf), v);
+        put(r, std::string_view(buf, static_cast<std::size_t>(res.ptr - buf)));
+    }
+
+    template <typename T>
+    static std::enable_if_t<std::is_floating_point_v<T> && !std::is_same_v<T, double>>
+        put(LogRecord& r, T v) { put(r, static_cast<double>(v)); }
+
+    std::atomic<int> m_level{ GUESSIO_LOG_LEVEL };
+    std::atomic<std::uint64_t> m_dropped{ 0 };
+    std::uint64_t m_reportedDropped = 0;     // writer thread only
+    std::time_t m_stampSecond = 0;           // writer thread only
+    char m_stamp[16] = {};                   // "HH:MM:SS." for m_stampSecond
+
+    std::mutex m_ringsMutex;                 // registration and the writer's snapshot
+    std::vector<std::shared_ptr<Ring>> m_rings;
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_drained;
+    std::uint64_t m_drainPasses = 0;         // guarded by m_wakeMutex
+    std::atomic<bool> m_running{ true };
+    std::thread m_writer;
+};
+
+template <typename... Args>
+void Logger::write(LogLevel level, const char* tag, const Args&... args) {
+    if (!m_running.load(std::memory_order_relaxed)) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Ring& ring = localRing();
+    LogRecord* r = claim(ring);
+    if (!r) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    r->time = std::chrono::system_clock::now();
+    r->level = level;
+    r->tag = tag;
+    r->session = 0;
+    r->textLen = r->roomLen = r->userLen = 0;
+    r->truncated = false;
+    (put(*r, args), ...);
+    commit(ring, level);
+}
+
+#define GUESSIO_LOG(level, tag, ...)                                              \
+    do {                                                                          \
+        if constexpr (static_cast<int>(level) >= GUESSIO_LOG_LEVEL) {             \
+            Logger& guessioLogger_ = Logger::instance();                          \
+            if (guessioLogger_.enabled(level))                                    \
+                guessioLogger_.write(level, tag, __VA_ARGS__);                    \
+        }                                                                         \
+    } while (0)
+
+#define LOG_TRACE(tag, ...) GUESSIO_LOG(LogLevel::trace, tag, __VA_ARGS__)
+#define LOG_DEBUG(tag, ...) GUESSIO_LOG(LogLevel::debug, tag, __VA_ARGS__)
+#define LOG_INFO(tag, ...) GUESSIO_LOG(LogLevel::info, tag, __VA_ARGS__)
+#define LOG_WARN(tag, ...) GUESSIO_LOG(LogLevel::warn, tag, __VA_ARGS__)
+#define LOG_ERROR(tag, ...) GUESSIO_LOG(LogLevel::error, tag, __VA_ARGS__)
@@ -13,6 +13,14 @@
 #include <cstdlib>
 #include <grpcpp/grpcpp.h>
 #include "grpc_server.h"
+#include "logger.h"
+#include "shardPool.h"
+#include "canvasCheckpoint.h"
+#include "strokeSimplify.h"
+#include "hintPlan.h"
+#include "guessQueue.h"
+#include "guessMatcher.h"
+#include "rateLimiter.h"
 
 // global running flag
 std::atomic<bool> running(true);
@@ -46,6 +54,57 @@ std::string getEnvVar(const std::string& key, const std::string& defaultValue =
     return defaultValue;
 }
 
+// read optional session tuning keys; anything missing keeps its default
+SessionOptions loadSessionOptions(const nlohmann::json& cfg) {
+    SessionOptions opts;
+    opts.maxBatchBytes = cfg.value("WS_MAX_BATCH_BYTES", opts.maxBatchBytes);
+    opts.maxBatchMessages = cfg.value("WS_MAX_BATCH_MESSAGES", opts.maxBatchMessages);
+    opts.flushWindow = std::chrono::milliseconds(cfg.value("WS_FLUSH_WINDOW_MS", 0));
+
+    opts.maxQueueBytes = cfg.value("WS_MAX_QUEUE_BYTES", opts.maxQueueBytes);
+    opts.maxQueueMessages = cfg.value("WS_MAX_QUEUE_MESSAGES", opts.maxQueueMessages);
+    opts.disconnectGrace = std::chrono::milliseconds(
+        cfg.value("WS_SLOW_DISCONNECT_GRACE_MS", static_cast<int>(opts.disconnectGrace.count())));
+    opts.deflateEnabled = cfg.value("WS_DEFLATE", opts.deflateEnabled);
+    opts.deflateWindowBits = cfg.value("WS_DEFLATE_WINDOW_BITS", opts.deflateWindowBits);
+    opts.deflateLevel = cfg.value("WS_DEFLATE_LEVEL", opts.deflateLevel);
+    opts.deflateMemLevel = cfg.value("WS_DEFLATE_MEM_LEVEL", opts.deflateMemLevel);
+    opts.deflateMinSize = cfg.value("WS_DEFLATE_MIN_SIZE", opts.deflateMinSize);
+
+    opts.maxInboundMessage = cfg.value("WS_MAX_INBOUND_MESSAGE", opts.maxInboundMessage);
+    opts.readBufferIdleCap = cfg.value("WS_READ_BUFFER_IDLE_CAP", opts.readBufferIdleCap);
+
+    opts.heartbeatInterval = std::chrono::milliseconds(
+        cfg.value("WS_HEARTBEAT_INTERVAL_MS", static_cast<int>(opts.heartbeatInterval.count())));
+    opts.heartbeatTick = std::chrono::milliseconds(
+        cfg.value("WS_HEARTBEAT_TICK_MS", static_cast<int>(opts.heartbeatTick.count())));
+
+    if (cfg.contains("WS_SLOW_CONSUMER_POLICY")) {
+        // e.g. ["drop_draw", "collapse_state", "disconnect"]
+        opts.slowConsumerPolicy = 0;
+        for (const auto& p : cfg["WS_SLOW_CONSUMER_POLICY"]) {
+            std::string name = p.get<std::string>();
+            if (name == "drop_draw") opts.slowConsumerPolicy |= kDropOldestDraw;
+            else if (name == "collapse_state") opts.slowConsumerPolicy |= kCollapseState;
+            else if (name == "disconnect") opts.slowConsumerPolicy |= kDisconnect;
+            else LOG_WARN("CONFIG", "Unknown slow consumer policy ", name);
+        }
+    }
+    return opts;
+}
+
+CheckpointOptions loadCheckpointOptions(const nlohmann::json& cfg) {
+    CheckpointOptions opts;
+    opts.enabled = cfg.value("CANVAS_CHECKPOINTS", opts.enabled);
+    opts.width = cfg.value("CANVAS_WIDTH", opts.width);
+    opts.height = cfg.value("CANVAS_HEIGHT", opts.height);
+    opts.interval = cfg.value("CANVAS_CHECKPOINT_INTERVAL", opts.interval);
+    opts.keepTail = cfg.value("CANVAS_CHECKPOINT_TAIL", opts.keepTail);
+    opts.pngLevel = cfg.value("CANVAS_PNG_LEVEL", opts.pngLevel);
+    opts.threads = cfg.value("CANVAS_CHECKPOINT_THREADS", opts.threads);
+    return opts;
+}
+
 // signal handler
 void handleSignal(int) {
     running = false;
@@ -53,31 +112,104 @@ void handleSignal(int) {
 
 int main() {
     try {
-        std::cout << "Starting server...\n";
+        LOG_INFO("MAIN", "Starting server...");
         signal(SIGINT, handleSignal);
         std::signal(SIGTERM, handleSignal);
 
-        std::cout << "Creating io_context...\n";
-        boost::asio::io_context io;
+        nlohmann::json cfg = nlohmann::json::object();
+        bool haveConfig = false;
+        try {
+            cfg = loadConfig("config.json");
+            haveConfig = cfg.is_object();
+            if (!haveConfig) cfg = nlohmann::json::object();
+        } catch (const std::exception&) {
+        }
+
+        // LOG_LEVEL can only raise the compile-time floor (GUESSIO_LOG_LEVEL).
+        if (cfg.contains("LOG_LEVEL")) {
+            LogLevel level;
+            std::string name = cfg.value("LOG_LEVEL", "");
+            if (Logger::parseLevel(name, level)) Logger::instance().setLevel(level);
+            else LOG_WARN("CONFIG", "Unknown LOG_LEVEL ", name);
+        }
 
-        std::cout << "Creating server...\n";
-        ::Server server(io, 9001);
+        // IO_SHARDED: one io_context, acceptor and thread per core instead of
+        // every thread sharing one io_context.
+        unsigned int numThreads = std::thread::hardware_concurrency();
+        if (numThreads == 0) numThreads = 4;
+        bool sharded = cfg.value("IO_SHARDED", false);
+        std::size_t shardCount = cfg.value("IO_SHARDS", 0u);
+        if (shardCount == 0) shardCount = numThreads;
 
-        std::cout << "Creating TwitchBotManager...\n";
+        LOG_DEBUG("MAIN", "Creating io_context...");
+        ShardPool shards(sharded ? shardCount : 1, sharded ? 1 : numThreads);
+        boost::asio::io_context& io = shards.io(0);
+
+        LOG_DEBUG("MAIN", "Creating server...");
+        ::Server server(shards, 9001);
+        server.setSessionOptions(loadSessionOptions(cfg));
+        CheckpointService::instance().configure(loadCheckpointOptions(cfg));
+        // Default for new rooms; set_simplify overrides it per room.
+        SimplifyOptions simplify;
+        simplify.tolerance = cfg.value("DRAW_SIMPLIFY_TOLERANCE", simplify.tolerance);
+        simplify.minDistance = cfg.value("DRAW_SIMPLIFY_MIN_DISTANCE", simplify.minDistance);
+        StrokeSimplify::setDefaults(simplify);
+        HintOptions hints;
+        hints.revealFraction = cfg.value("HINT_REVEAL_FRACTION", hints.revealFraction);
+        HintPlan::setDefaults(hints);
+        GuessOptions guesses;
+        guesses.tick = std::chrono::milliseconds(cfg.value("GUESS_TICK_MS", static_cast<int>(guesses.tick.count())));
+        guesses.recentLimit = cfg.value("GUESS_RECENT_LIMIT", guesses.recentLimit);
+        guesses.maxPending = cfg.value("GUESS_MAX_PENDING", guesses.maxPending);
+        guesses.maxSeen = cfg.value("GUESS_MAX_SEEN", guesses.maxSeen);
+        GuessQueue::setDefaults(guesses);
+        MatchOptions matching;
+        matching.closeDistance = cfg.value("CLOSE_GUESS_DISTANCE", matching.closeDistance);
+        GuessMatcher::setDefaults(matching);
+        // Per sender; set_rate_limits overrides them per room.
+        RateOptions rates;
+        auto loadRate = [&](const char* name, RateClass cls) {
+            RateLimit& limit = rates.limits[cls];
+            std::string prefix = std::string("RATE_") + name;
+            limit.rate = cfg.value(prefix + "_PER_SEC", limit.rate);
+            limit.burst = cfg.value(prefix + "_BURST", limit.burst);
+        };
+        loadRate("GUESS", RateClass::guess);
+        loadRate("CHAT", RateClass::chat);
+        loadRate("DRAW", RateClass::draw);
+        rates.idle = std::chrono::seconds(cfg.value("RATE_IDLE_SECONDS", static_cast<int>(rates.idle.count())));
+        RateLimiter::setDefaults(rates);
+        TwitchOptions twitch;
+        twitch.host = cfg.value("TWITCH_IRC_HOST", twitch.host);
+        twitch.port = std::to_string(cfg.value("TWITCH_IRC_PORT", std::stoi(twitch.port)));
+        auto loadBudget = [&](const char* name, SendBudget& budget) {
+            std::string prefix = std::string("TWITCH_") + name;
+            budget.count = cfg.value(prefix + "_LIMIT", budget.count);
+            budget.window = std::chrono::seconds(cfg.value(prefix + "_WINDOW_SEC",
+                static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(budget.window).count())));
+        };
+        loadBudget("JOIN", twitch.send.join);
+        loadBudget("CHAT", twitch.send.chat);
+        twitch.send.maxBatchBytes = cfg.value("TWITCH_SEND_BATCH_BYTES", twitch.send.maxBatchBytes);
+        twitch.reconnectBase = std::chrono::milliseconds(cfg.value("TWITCH_RECONNECT_BASE_MS", static_cast<int>(twitch.reconnectBase.count())));
+        twitch.reconnectMax = std::chrono::milliseconds(cfg.value("TWITCH_RECONNECT_MAX_MS", static_cast<int>(twitch.reconnectMax.count())));
+        twitch.channelsPerConnection = cfg.value("TWITCH_CHANNELS_PER_CONNECTION", twitch.channelsPerConnection);
+        TwitchClient::setDefaults(twitch);
+
+        LOG_DEBUG("MAIN", "Creating TwitchBotManager...");
         TwitchBotManager botManager(io, server);
 
-        std::cout << "Setting bot manager...\n";
+        LOG_DEBUG("MAIN", "Setting bot manager...");
         server.setBotManager(&botManager);
 
         // Create a GameProtocol and set it on the bot manager
-        std::cout << "Creating GameProtocol...\n";
+        LOG_DEBUG("MAIN", "Creating GameProtocol...");
         auto gameProtocol = std::make_shared<GameProtocol>(&server);
         botManager.setGameProtocol(gameProtocol);
 
 
-        std::cout << "Starting server...\n";
         server.start();
-        std::cout << "Server started successfully on port 9001\n";
+        LOG_INFO("MAIN", "Server started successfully on port 9001");
 
         // load secrets from environment variables first, then config.json as fallback
         std::string oauth = getEnvVar("TWITCH_OAUTH");
@@ -86,39 +218,33 @@ int main() {
         
         // If environment variables are not set, try to load from config.json
         if (oauth.empty() || nick.empty() || channel.empty()) {
-            try {
-                auto cfg = loadConfig("config.json");
+            if (haveConfig) {
                 if (oauth.empty()) oauth = cfg.value("TWITCH_OAUTH", "");
                 if (nick.empty()) nick = cfg.value("TWITCH_NICK", "");
                 if (channel.empty()) channel = cfg.value("TWITCH_CHANNEL", "");
-            } catch (const std::exception& e) {
-                std::cout << "Warning: Could not load config.json, using environment variables only\n";
+            } else {
+                LOG_WARN("CONFIG", "Could not load config.json, using environment variables only");
             }
         }
 
         // spawn bot
-        std::cout << "Spawning Twitch bot for channel " << channel << "...\n";
+        LOG_INFO("MAIN", "Spawning Twitch bot for channel ", channel, "...");
         bool botSpawned = server.spawnBot(oauth, nick, channel);
 
         if (botSpawned) {
-            std::cout << "Twitch bot spawned successfully!\n";
+            LOG_INFO("MAIN", "Twitch bot spawned successfully!");
         }
         else {
-            std::cout << "Failed to spawn Twitch bot!\n";
+            LOG_ERROR("MAIN", "Failed to spawn Twitch bot!");
         }
 
 
         // Start gRPC server in a separate thread
         std::thread grpcThread(StartGrpcServer);
         grpcThread.detach();
-        std::cout << "[gRPC] Server thread launched.\n";
+        LOG_INFO("gRPC", "Server thread launched.");
         // thread pool
-        unsigned int numThreads = std::thread::hardware_concurrency();
-        if (numThreads == 0) numThreads = 4;
-        std::vector<std::thread> pool;
-        pool.reserve(numThreads);
-        for (unsigned int i = 0; i < numThreads; ++i)
-            pool.emplace_back([&io]() { io.run(); });
+        shards.start(cfg.value("IO_PIN_THREADS", false));
 
         // main loop
         while (running) {
@@ -128,8 +254,9 @@ int main() {
         server.broadcast(R"({"type":"system","payload":"server shutting down"})");
 
 
-        io.stop();
-        for (auto& t : pool) t.join();
+        shards.stop();
+        shards.join();
+        CheckpointService::instance().shutdown();
     }
     catch (const std::exception& e) {
         std::cerr << "Fatal error: " << e.what() << "\n";
@@ -0,0 +1,36 @@
+#include "messageDeflate.h"
+#include <boost/beast/zlib/deflate_stream.hpp>
+
+namespace zlib = boost::beast::zlib;
+
+std::string deflateMessagePayload(const std::string& payload, int level, int windowBits, int memLevel) {
+    // deflate_stream allocates its window and hash tables up front; keep one
+    // per io thread and reset it between messages instead of reallocating.
+    thread_local zlib::deflate_stream stream;
+    stream.reset(level, windowBits, memLevel, zlib::Strategy::normal);
+
+    // Room for the worst case plus the empty block emitted by the flushes.
+    std::string out(stream.upper_bound(payload.size()) + 16, '\0');
+
+    zlib::z_params zs;
+    zs.next_in = payload.data();
+    zs.avail_in = payload.size();
+    zs.next_out = &out[0];
+    zs.avail_out = out.size();
+
+    boost::system::error_code ec;
+    stream.write(zs, zlib::Flush::none, ec);
+    if (ec && ec != zlib::error::need_buffers) return std::string();
+
+    // Same sequence Beast uses: finish the block, then a full flush so the
+    // message ends on a byte boundary with the 00 00 FF FF marker.
+    ec = {};
+    stream.write(zs, zlib::Flush::block, ec);
+    if (ec && ec != zlib::error::need_buffers) return std::string();
+    ec = {};
+    stream.write(zs, zlib::Flush::full, ec);
+    if (ec || zs.avail_in != 0 || zs.total_out < 4) return std::string();
+
+    out.resize(zs.total_out - 4);
+    return out;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <string>
+
+// Raw DEFLATE for permessage-deflate (RFC 7692) with no context takeover:
+// every message is compressed on its own, so the result is the same for any
+// client that negotiated these parameters and can be shared between them.
+// The trailing 00 00 FF FF sync marker is already stripped.
+std::string deflateMessagePayload(const std::string& payload, int level, int windowBits, int memLevel);
@@ -0,0 +1,109 @@
+#include "metrics.h"
+#include "logger.h"
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+nlohmann::json Metrics::toJson() const {
+    auto get = [](const Counter& c) { return c.load(std::memory_order_relaxed); };
+
+    nlohmann::json j;
+    j["broadcast"] = {
+        {"broadcasts", get(broadcasts)},
+        {"recipients", get(broadcastRecipients)},
+        {"buffers", get(messagesAllocated)},
+        {"bytesSerialized", get(payloadBytesSerialized)}
+    };
+    j["writes"] = {
+        {"socketWrites", get(socketWrites)},
+        {"messages", get(messagesWritten)},
+        {"bytes", get(bytesWritten)}
+    };
+    j["reads"] = {
+        {"bufferShrinks", get(readBufferShrinks)}
+    };
+    j["deflate"] = {
+        {"compressions", get(deflateCompressions)},
+        {"framesSent", get(deflateFramesSent)},
+        {"bytesIn", get(deflateBytesIn)},
+        {"bytesOut", get(deflateBytesOut)}
+    };
+    j["slowConsumers"] = {
+        {"drawsDropped", get(drawsDropped)},
+        {"statesCollapsed", get(statesCollapsed)},
+        {"disconnects", get(slowDisconnects)},
+        {"overLimit", get(queueOverLimit)}
+    };
+    j["heartbeat"] = {
+        {"tracked", get(heartbeatTracked)},
+        {"pings", get(heartbeatPings)},
+        {"timeouts", get(heartbeatTimeouts)}
+    };
+    {
+        std::uint64_t scheduled = get(timersScheduled);
+        std::uint64_t fired = get(timersFired);
+        std::uint64_t cancelled = get(timersCancelled);
+        j["timers"] = {
+            {"scheduled", scheduled},
+            {"fired", fired},
+            {"cancelled", cancelled},
+            {"pending", scheduled >= fired + cancelled ? scheduled - fired - cancelled : 0}
+        };
+    }
+    j["rounds"] = {
+        {"hintsRevealed", get(hintsRevealed)},
+        {"guessesReceived", get(guessesReceived)},
+        {"guessesDropped", get(guessesDropped)},
+        {"guessesDuplicate", get(guessesDuplicate)},
+        {"guessesUnremembered", get(guessesUnremembered)},
+        {"guessesCorrect", get(guessesCorrect)},
+        {"guessesWrong", get(guessesWrong)},
+        {"guessesClose", get(guessesClose)},
+        {"guessTicks", get(guessTicks)}
+    };
+    j["rateLimit"] = {
+        {"guesses", get(rateLimitedGuesses)},
+        {"chats", get(rateLimitedChats)},
+        {"draws", get(rateLimitedDraws)},
+        {"buckets", get(rateBuckets)}
+    };
+    j["irc"] = {
+        {"writes", get(ircWrites)},
+        {"linesSent", get(ircLinesSent)},
+        {"bytesSent", get(ircBytesSent)},
+        {"throttled", get(ircThrottled)},
+        {"chatDropped", get(ircChatDropped)},
+        {"reconnects", get(ircReconnects)},
+        {"reconnectAttempts", get(ircReconnectAttempts)},
+        {"reconnectRequests", get(ircReconnectRequests)},
+        {"downtimeMs", get(ircDowntimeMs)},
+        {"connections", get(ircConnections)},
+        {"channelsMoved", get(ircChannelsMoved)}
+    };
+    j["canvas"] = {
+        {"snapshotBuilds", get(canvasSnapshotBuilds)},
+        {"snapshotsSent", get(canvasSnapshotsSent)},
+        {"strokesReplayed", get(canvasStrokesReplayed)},
+        {"checkpointsBuilt", get(checkpointsBuilt)},
+        {"checkpointsDiscarded", get(checkpointsDiscarded)},
+        {"checkpointStrokes", get(checkpointStrokes)},
+        {"checkpointMicros", get(checkpointMicros)},
+        {"checkpointsSent", get(checkpointsSent)}
+    };
+    {
+        std::uint64_t in = get(simplifyPointsIn);
+        std::uint64_t out = get(simplifyPointsOut);
+        j["simplify"] = {
+            {"strokes", get(simplifyStrokes)},
+            {"pointsIn", in},
+            {"pointsOut", out},
+            {"ratio", in ? static_cast<double>(out) / static_cast<double>(in) : 1.0} // kept / received
+        };
+    }
+    j["log"] = {
+        {"dropped", Logger::instance().dropped()}
+    };
+    return j;
+}
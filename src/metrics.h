@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+// Process-wide counters, bumped with relaxed atomics from any io thread and
+// reported to clients through the "get_stats" message.
+struct Metrics {
+    using Counter = std::atomic<std::uint64_t>;
+
+    // Broadcast fan-out
+    Counter broadcasts{ 0 };             // Room/Server broadcast calls
+    Counter broadcastRecipients{ 0 };    // sessions reached by those broadcasts
+    Counter messagesAllocated{ 0 };      // shared payload buffers created
+    Counter payloadBytesSerialized{ 0 }; // bytes serialized into those buffers
+
+    // Session write path
+    Counter socketWrites{ 0 };           // async_write calls on client sockets
+    Counter messagesWritten{ 0 };        // messages carried by those writes
+    Counter bytesWritten{ 0 };           // wire bytes, headers included
+
+    // Session read path
+    Counter readBufferShrinks{ 0 };      // oversized read buffers released
+
+    // permessage-deflate
+    Counter deflateCompressions{ 0 };    // payloads compressed (once per message and window size)
+    Counter deflateFramesSent{ 0 };      // compressed frames written, shared copies included
+    Counter deflateBytesIn{ 0 };
+    Counter deflateBytesOut{ 0 };
+
+    // Slow-consumer policies
+    Counter drawsDropped{ 0 };           // kDropOldestDraw
+    Counter statesCollapsed{ 0 };        // kCollapseState
+    Counter slowDisconnects{ 0 };        // kDisconnect
+    Counter queueOverLimit{ 0 };         // times a session crossed its limit
+
+    // Heartbeat wheel
+    Counter heartbeatTracked{ 0 };       // sessions currently on the wheel
+    Counter heartbeatPings{ 0 };         // pings queued by wheel ticks
+    Counter heartbeatTimeouts{ 0 };      // sessions closed for missing a pong
+
+    // Timer wheel (round expiry and other room timers)
+    Counter timersScheduled{ 0 };
+    Counter timersFired{ 0 };
+    Counter timersCancelled{ 0 };        // cancelled before firing
+
+    // Rounds
+    Counter hintsRevealed{ 0 };          // letters uncovered by hint reveals
+    Counter guessesReceived{ 0 };        // chat guesses queued during a round
+    Counter guessesDropped{ 0 };         // over GUESS_MAX_PENDING in one tick
+    Counter guessesDuplicate{ 0 };       // same user and word again in a round
+    Counter guessesUnremembered{ 0 };    // past GUESS_MAX_SEEN, deduplicated within their tick only
+    Counter guessesCorrect{ 0 };
+    Counter guessesWrong{ 0 };           // reported in "guesses" summaries
+    Counter guessesClose{ 0 };           // wrong but within CLOSE_GUESS_DISTANCE
+    Counter guessTicks{ 0 };             // queues adjudicated
+
+    // Per-sender rate limits (RateLimiter)
+    Counter rateLimitedGuesses{ 0 };     // Twitch guesses dropped
+    Counter rateLimitedChats{ 0 };
+    Counter rateLimitedDraws{ 0 };       // draw, clear and undo, JSON or binary
+    Counter rateBuckets{ 0 };            // buckets currently held
+
+    // Twitch IRC connections and send queues
+    Counter ircWrites{ 0 };              // socket writes, each carrying one or more lines
+    Counter ircLinesSent{ 0 };
+    Counter ircBytesSent{ 0 };
+    Counter ircThrottled{ 0 };           // times a queue waited for JOIN or chat budget
+    Counter ircChatDropped{ 0 };         // announcements pushed out of a full queue
+    Counter ircReconnects{ 0 };          // replacement connections that logged in
+    Counter ircReconnectAttempts{ 0 };
+    Counter ircReconnectRequests{ 0 };   // RECONNECT commands from the server
+    Counter ircDowntimeMs{ 0 };          // from a lost connection to its replacement's login
+    Counter ircConnections{ 0 };         // pooled connections currently open
+    Counter ircChannelsMoved{ 0 };       // channels rebalanced off a lost connection
+
+    // Late-joiner canvas snapshots
+    Counter canvasSnapshotBuilds{ 0 };   // snapshot frames (re)serialized
+    Counter canvasSnapshotsSent{ 0 };    // joins served a snapshot frame
+    Counter canvasStrokesReplayed{ 0 };  // strokes carried by those frames
+    Counter checkpointsBuilt{ 0 };       // raster checkpoints installed
+    Counter checkpointsDiscarded{ 0 };   // finished after an undo/clear made them stale
+    Counter checkpointStrokes{ 0 };      // strokes rasterized by those checkpoints
+    Counter checkpointMicros{ 0 };       // background time spent rasterizing and encoding
+    Counter checkpointsSent{ 0 };        // joins served a checkpoint
+
+    // Stroke simplification
+    Counter simplifyStrokes{ 0 };        // strokes run through a room's simplifier
+    Counter simplifyPointsIn{ 0 };       // points before
+    Counter simplifyPointsOut{ 0 };      // points kept
+
+    static Metrics& instance();
+    nlohmann::json toJson() const;
+};
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+// Unbounded multi-producer / single-consumer queue (Vyukov's node-based
+// design). push() is wait-free and may be called from any thread; pop() must
+// only ever be called from one consumer at a time, e.g. a Session's strand.
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : m_head(&m_stub), m_tail(&m_stub) {}
+
+    ~MpscQueue() {
+        T discard;
+        while (pop(discard)) {}
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value) {
+        Node* node = new Node(std::move(value));
+        link(node);
+    }
+
+    // Returns false when the queue is empty or a producer is halfway through
+    // push(); that producer is responsible for waking the consumer again.
+    bool pop(T& out) {
+        Node* tail = m_tail;
+        Node* next = tail->next.load(std::memory_order_acquire);
+
+        if (tail == &m_stub) {
+            if (!next) return false;
+            m_tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next) {
+            m_tail = next;
+            return take(tail, out);
+        }
+
+        if (tail != m_head.load(std::memory_order_acquire)) return false;
+
+        m_stub.next.store(nullptr, std::memory_order_relaxed);
+        link(&m_stub);
+
+        next = tail->next.load(std::memory_order_acquire);
+        if (!next) return false;
+        m_tail = next;
+        return take(tail, out);
+    }
+
+private:
+    struct Node {
+        Node() = default;
+        explicit Node(T v) : value(std::move(v)) {}
+        std::atomic<Node*> next{ nullptr };
+        T value{};
+    };
+
+    void link(Node* node) {
+        Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    static bool take(Node* node, T& out) {
+        out = std::move(node->value);
+        delete node;
+        return true;
+    }
+
+    std::atomic<Node*> m_head; // producers
+    Node* m_tail;              // consumer only
+    Node m_stub;
+};
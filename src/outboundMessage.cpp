@@ -0,0 +1,37 @@
+#include "outboundMessage.h"
+#include "messageDeflate.h"
+#include <algorithm>
+
+OutboundMessage::~OutboundMessage() {
+    for (auto& slot : m_deflated) {
+        delete slot.load(std::memory_order_acquire);
+    }
+}
+
+const DeflatedFrame* OutboundMessage::deflated(int windowBits, int level, int memLevel) const {
+    windowBits = std::clamp(windowBits, kMinWindowBits, kMaxWindowBits);
+    auto& slot = m_deflated[windowBits - kMinWindowBits];
+
+    const DeflatedFrame* frame = slot.load(std::memory_order_acquire);
+    if (frame) return frame;
+
+    std::string compressed = deflateMessagePayload(m_payload, level, windowBits, memLevel);
+    if (compressed.empty()) return nullptr;
+
+    auto* fresh = new DeflatedFrame{ std::move(compressed), FrameHeader{} };
+    fresh->header = makeFrameHeader(m_opcode, fresh->payload.size(), true);
+
+    auto& metrics = Metrics::instance();
+    metrics.deflateCompressions.fetch_add(1, std::memory_order_relaxed);
+    metrics.deflateBytesIn.fetch_add(m_payload.size(), std::memory_order_relaxed);
+    metrics.deflateBytesOut.fetch_add(fresh->payload.size(), std::memory_order_relaxed);
+
+    // Two strands may race to compress the same message; the loser throws
+    // its copy away and uses the winner's.
+    const DeflatedFrame* expected = nullptr;
+    if (!slot.compare_exchange_strong(expected, fresh, std::memory_order_acq_rel)) {
+        delete fresh;
+        return expected;
+    }
+    return fresh;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include "metrics.h"
+#include "wsFrame.h"
+
+// How a session may treat a queued message when its client falls behind.
+enum class MessageClass : std::uint8_t {
+    control, // never dropped (round_start, round_end, system, join, ...)
+    draw,    // oldest may be dropped under pressure
+    state    // superseded by a newer message with the same collapse key
+};
+
+// Compressed copy of a message for clients that negotiated permessage-deflate.
+struct DeflatedFrame {
+    std::string payload;
+    FrameHeader header; // RSV1 set
+};
+
+// Immutable, refcounted payload queued by every session a broadcast reaches.
+// The caller serializes once; each Session keeps a handle in its write queue
+// and the bytes are freed when the last pending write completes. The frame
+// header is built alongside the payload so sessions can write it as-is.
+class OutboundMessage {
+public:
+    explicit OutboundMessage(std::string payload,
+        MessageClass cls = MessageClass::control,
+        std::string collapseKey = std::string(),
+        WsOpcode opcode = WsOpcode::text)
+        : m_payload(std::move(payload)),
+        m_collapseKey(std::move(collapseKey)),
+        m_class(cls),
+        m_opcode(opcode),
+        m_header(makeFrameHeader(opcode, m_payload.size())) {
+    }
+
+    const std::string& payload() const { return m_payload; }
+    std::size_t size() const { return m_payload.size(); }
+    MessageClass messageClass() const { return m_class; }
+    const std::string& collapseKey() const { return m_collapseKey; }
+    WsOpcode opcode() const { return m_opcode; }
+    const FrameHeader& header() const { return m_header; }
+
+    // Compressed once per window size on first use and then shared by every
+    // session that negotiated it. Returns nullptr if compression failed.
+    const DeflatedFrame* deflated(int windowBits, int level, int memLevel) const;
+
+    ~OutboundMessage();
+    OutboundMessage(const OutboundMessage&) = delete;
+    OutboundMessage& operator=(const OutboundMessage&) = delete;
+
+    static constexpr int kMinWindowBits = 9;
+    static constexpr int kMaxWindowBits = 15;
+
+private:
+    const std::string m_payload;
+    const std::string m_collapseKey;
+    const MessageClass m_class;
+    const WsOpcode m_opcode;
+    const FrameHeader m_header;
+
+    // One slot per server_max_window_bits value (9..15).
+    mutable std::array<std::atomic<const DeflatedFrame*>, kMaxWindowBits - kMinWindowBits + 1> m_deflated{};
+};
+
+using MessagePtr = std::shared_ptr<const OutboundMessage>;
+
+inline MessagePtr makeMessage(std::string payload,
+    MessageClass cls = MessageClass::control,
+    std::string collapseKey = std::string(),
+    WsOpcode opcode = WsOpcode::text) {
+    auto& m = Metrics::instance();
+    m.messagesAllocated.fetch_add(1, std::memory_order_relaxed);
+    m.payloadBytesSerialized.fetch_add(payload.size(), std::memory_order_relaxed);
+    return std::make_shared<const OutboundMessage>(std::move(payload), cls, std::move(collapseKey), opcode);
+}
@@ -0,0 +1,104 @@
+#include "rateLimiter.h"
+#include "metrics.h"
+#include <algorithm>
+#include <functional>
+
+namespace {
+RateOptions g_defaults; // written once by main before any io thread starts
+
+std::int32_t idleMs() {
+    return static_cast<std::int32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(g_defaults.idle).count());
+}
+
+// later - earlier on the wrapping millisecond clock. Callers read the clock
+// before taking the stripe lock, so a bucket may already carry a slightly
+// later time than the caller's: that comes out negative, not as 49 days.
+std::int32_t elapsed(std::uint32_t earlier, std::uint32_t later) {
+    return static_cast<std::int32_t>(later - earlier);
+}
+}
+
+RateLimiter::RateLimiter(std::size_t stripes)
+    : m_epoch(Clock::now()),
+    m_stripes(new Stripe[std::max<std::size_t>(1, stripes)]),
+    m_stripeCount(std::max<std::size_t>(1, stripes)) {
+}
+
+bool RateLimiter::allow(std::string_view room, std::string_view sender, RateClass cls, const RateLimit& limit,
+    Clock::time_point now) {
+    if (limit.rate <= 0.0f) return true;
+
+    std::string key;
+    key.reserve(room.size() + sender.size() + 2);
+    key.append(room);
+    key += '\0';
+    key.append(sender);
+    key += static_cast<char>(cls);
+
+    std::uint32_t nowMs = millis(now);
+    Stripe& stripe = m_stripes[std::hash<std::string>{}(key) % m_stripeCount];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    if (elapsed(stripe.sweptMs, nowMs) >= idleMs()) sweepLocked(stripe, nowMs);
+
+    // A new sender starts with a full bucket, and so does one whose bucket
+    // was swept: after an idle period it would have refilled anyway unless
+    // the room's rate is below burst / idle.
+    float burst = std::max(limit.burst, 1.0f);
+    auto [it, inserted] = stripe.buckets.try_emplace(std::move(key), Bucket{ burst, nowMs });
+    Bucket& bucket = it->second;
+    if (inserted) {
+        Metrics::instance().rateBuckets.fetch_add(1, std::memory_order_relaxed);
+    } else if (std::int32_t ms = elapsed(bucket.lastMs, nowMs); ms > 0) {
+        bucket.tokens = std::min(burst, bucket.tokens + static_cast<float>(ms) * limit.rate / 1000.0f);
+        bucket.lastMs = nowMs;
+    }
+
+    if (bucket.tokens < 1.0f) return false;
+    bucket.tokens -= 1.0f;
+    return true;
+}
+
+void RateLimiter::sweep(Clock::time_point now) {
+    std::uint32_t nowMs = millis(now);
+    for (std::size_t i = 0; i < m_stripeCount; ++i) {
+        std::lock_guard<std::mutex> lock(m_stripes[i].mutex);
+        if (elapsed(m_stripes[i].sweptMs, nowMs) >= idleMs()) sweepLocked(m_stripes[i], nowMs);
+    }
+}
+
+std::size_t RateLimiter::size() const {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < m_stripeCount; ++i) {
+        std::lock_guard<std::mutex> lock(m_stripes[i].mutex);
+        total += m_stripes[i].buckets.size();
+    }
+    return total;
+}
+
+std::uint32_t RateLimiter::millis(Clock::time_point now) const {
+    // Only differences are used (see elapsed()).
+    return static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now - m_epoch).count());
+}
+
+void RateLimiter::sweepLocked(Stripe& stripe, std::uint32_t nowMs) {
+    std::int32_t idle = idleMs();
+    std::size_t removed = 0;
+    for (auto it = stripe.buckets.begin(); it != stripe.buckets.end();) {
+        if (elapsed(it->second.lastMs, nowMs) >= idle) {
+            it = stripe.buckets.erase(it);
+            ++removed;
+        } else {
+            ++it;
+        }
+    }
+    stripe.sweptMs = nowMs;
+    if (removed) Metrics::instance().rateBuckets.fetch_sub(removed, std::memory_order_relaxed);
+}
+
+void RateLimiter::setDefaults(const RateOptions& options) {
+    g_defaults = options;
+}
+
+RateOptions RateLimiter::defaults() {
+    return g_defaults;
+}
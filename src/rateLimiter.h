@@ -0,0 +1,83 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Inputs one Twitch user or WebSocket session can flood a room with.
+enum class RateClass : std::uint8_t { guess, chat, draw };
+constexpr std::size_t kRateClasses = 3;
+
+// Token bucket: refills at rate per second up to burst, one token per
+// message. rate 0 turns the limit off.
+struct RateLimit {
+    float rate = 0.0f;
+    float burst = 0.0f;
+};
+
+struct RateLimits {
+    std::array<RateLimit, kRateClasses> of{ {
+        { 2.0f, 5.0f },     // guess
+        { 1.0f, 5.0f },     // chat
+        { 60.0f, 240.0f },  // draw: strokes, clears and undos
+    } };
+
+    RateLimit& operator[](RateClass c) { return of[static_cast<std::size_t>(c)]; }
+    const RateLimit& operator[](RateClass c) const { return of[static_cast<std::size_t>(c)]; }
+};
+
+// RATE_* in config.json.
+struct RateOptions {
+    RateLimits limits;               // for rooms that haven't set their own
+    std::chrono::seconds idle{ 60 }; // buckets untouched this long are forgotten
+};
+
+// Buckets keyed by (room, sender, class). The table is split into stripes,
+// each with its own lock, so io threads only contend when their keys hash
+// to the same stripe. A stripe sweeps out idle buckets when it is used and
+// has not been swept for an idle period; sweep() does the same for every
+// stripe, so buckets don't outlive a flood that stopped.
+class RateLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit RateLimiter(std::size_t stripes = 64);
+
+    // Takes a token from the bucket for (room, sender, cls). False if it was
+    // empty; the caller drops the message. sender is "s<id>" for a session
+    // or "u<name>" for a Twitch user.
+    bool allow(std::string_view room, std::string_view sender, RateClass cls, const RateLimit& limit,
+        Clock::time_point now = Clock::now());
+
+    void sweep(Clock::time_point now = Clock::now());
+    std::size_t size() const;
+
+    // Process-wide defaults (RATE_* in config.json).
+    static void setDefaults(const RateOptions& options);
+    static RateOptions defaults();
+
+private:
+    // 8 bytes: a million senders cost a few tens of MB with the keys.
+    struct Bucket {
+        float tokens;
+        std::uint32_t lastMs; // since m_epoch, wrapping; compared as signed differences, and buckets never live for weeks
+    };
+
+    struct alignas(64) Stripe {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Bucket> buckets;
+        std::uint32_t sweptMs = 0;
+    };
+
+    std::uint32_t millis(Clock::time_point now) const;
+    void sweepLocked(Stripe& stripe, std::uint32_t nowMs);
+
+    Clock::time_point m_epoch;
+    std::unique_ptr<Stripe[]> m_stripes;
+    std::size_t m_stripeCount;
+};
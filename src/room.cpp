@@ -1,60 +1,87 @@
 ﻿#include "room.h"
 #include "session.h"   // full definition of Session
-#include <iostream>
+#include "logger.h"
 #include <unordered_map>
 #include <chrono>
-#include <thread>
 using json = nlohmann::json;
 
-Room::Room() : nextPlayerId(1), m_lastActivity(std::chrono::steady_clock::now()) {}
+namespace {
+// Seconds left at which a round sends "countdown"; clients run their own
+// clock from round_start and resync on these.
+constexpr int kCountdownMarks[] = { 30, 10, 5, 4, 3, 2, 1 };
+}
+
+Room::Room(std::string id, boost::asio::io_context& io, TimerService& timers)
+    : m_id(std::move(id)),
+    m_strand(boost::asio::make_strand(io)),
+    m_timers(timers),
+    m_simplify(StrokeSimplify::defaults()),
+    strokeHistory(m_id),
+    m_lastActivity(std::chrono::steady_clock::now().time_since_epoch().count()) {
+    RateLimits limits = RateLimiter::defaults().limits;
+    for (std::size_t i = 0; i < kRateClasses; ++i) m_rateLimits[i].store(limits.of[i], std::memory_order_relaxed);
+}
 
 void Room::updateActivity() {
-    m_lastActivity = std::chrono::steady_clock::now();
+    m_lastActivity.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
 }
 
 std::chrono::steady_clock::time_point Room::getLastActivity() const {
-    return m_lastActivity;
+    return std::chrono::steady_clock::time_point(
+        std::chrono::steady_clock::duration(m_lastActivity.load(std::memory_order_relaxed)));
 }
 
-// Default constructor is now defined in header
-
-void Room::join(std::shared_ptr<Session> s, const std::string& username) {
-    nlohmann::json joinMsg;
-    bool isNewPlayer = false;
-
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
+// busy -> idle when the last session and player are gone, idle -> busy when
+// one comes back. Never leaves closed.
+void Room::refreshIdle() {
+    bool empty = m_sessions.empty() && players.empty();
+    int expected = empty ? kBusy : kIdle;
+    m_state.compare_exchange_strong(expected, empty ? kIdle : kBusy, std::memory_order_acq_rel);
+}
 
-        if (players.find(username) == players.end()) {
-            Player p{ nextPlayerId++, username, 0 };
-            players[username] = p;
-            isNewPlayer = true;
-            std::cout << "[DEBUG] Room::join - Adding new player: " << username << " with ID: " << p.id << std::endl;
+bool Room::tryClose() {
+    int expected = kIdle;
+    return m_state.compare_exchange_strong(expected, kClosed, std::memory_order_acq_rel);
+}
 
-            joinMsg = {
-                {"type", "join"},
-                {"payload", {
-                    {"id", p.id},
-                    {"username", p.username}
-                }}
-            };
-        } else {
-            std::cout << "[DEBUG] Room::join - Player " << username << " already exists" << std::endl;
+void Room::join(std::shared_ptr<Session> s, std::string username, std::function<void()> ifClosed) {
+    post([this, s = std::move(s), username = std::move(username), ifClosed = std::move(ifClosed)]() {
+        // Claim the room before touching it, so RoomManager cannot close it
+        // between this check and the player being added.
+        int state = kIdle;
+        if (!m_state.compare_exchange_strong(state, kBusy, std::memory_order_acq_rel) && state == kClosed) {
+            LOG_DEBUG("ROOM", LogFields().room(m_id).user(username), "Join raced with room removal");
+            if (ifClosed) ifClosed();
+            return;
         }
+        doJoin(s, username);
+    });
+}
 
-        if (s) {
-            m_sessions.insert(s);
-        }
-        
-        // Update activity timestamp
-        updateActivity();
+void Room::doJoin(const std::shared_ptr<Session>& s, const std::string& username) {
+    auto it = players.find(username);
+    if (it == players.end()) {
+        Player p{ nextPlayerId++, username, 0 };
+        players[username] = p;
+        LOG_DEBUG("ROOM", LogFields().room(m_id).user(username), "Adding new player with ID ", p.id);
+
+        nlohmann::json joinMsg = {
+            {"type", "join"},
+            {"payload", {
+                {"id", p.id},
+                {"username", p.username}
+            }}
+        };
+        fanOut(makeMessage(joinMsg.dump(), MessageClass::control));
+    } else {
+        LOG_DEBUG("ROOM", LogFields().room(m_id).user(username), "Player already exists (replaying state)");
     }
 
-    // Broadcast outside of mutex lock to avoid deadlock
-    if (isNewPlayer) {
-        std::cout << "[DEBUG] Room::join - Broadcasting join message for: " << username << std::endl;
-        broadcast(joinMsg.dump());
+    if (s) {
+        m_sessions.insert(s);
     }
+    updateActivity();
+    refreshIdle();
 
     if (s) {
         replayPlayers(s);
@@ -62,109 +89,190 @@ void Room::join(std::shared_ptr<Session> s, const std::string& username) {
     }
 }
 
+void Room::leave(std::shared_ptr<Session> s, bool intentional, std::function<void()> ifIdle) {
+    post([this, s = std::move(s), intentional, ifIdle = std::move(ifIdle)]() {
+        if (intentional) {
+            // Streamer clicked back to menu - clear all players
+            for (auto& [uname, p] : players) {
+                nlohmann::json leaveMsg = {
+                    {"type", "leave"},
+                    {"payload", {
+                        {"id", p.id},
+                        {"username", uname}
+                    }}
+                };
+                fanOut(makeMessage(leaveMsg.dump(), MessageClass::control));
+            }
+            doResetLobby();
+        }
 
-bool Room::leave(std::shared_ptr<Session> s) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-
-    // just remove the session
-    auto it = m_sessions.find(s);
-    if (it != m_sessions.end()) {
-        m_sessions.erase(it);
-    }
+        m_sessions.erase(s);
+        refreshIdle();
+        if (ifIdle && idle()) ifIdle();
+    });
+}
 
-    return m_sessions.empty();
+void Room::detach(std::shared_ptr<Session> s) {
+    post([this, s = std::move(s)]() {
+        m_sessions.erase(s);
+        refreshIdle();
+    });
 }
 
 void Room::resetLobby() {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    post([this]() { doResetLobby(); });
+}
+
+void Room::doResetLobby() {
     players.clear();
     nextPlayerId = 1;
+    refreshIdle();
+}
+
+void Room::broadcast(std::string msg, MessageClass cls) {
+    broadcast(makeMessage(std::move(msg), cls));
 }
 
-void Room::broadcast(const std::string& msg) {
+void Room::broadcast(MessagePtr msg) {
+    post([this, msg = std::move(msg)]() { fanOut(msg); });
+}
+
+void Room::fanOut(const MessagePtr& msg) {
+    auto& metrics = Metrics::instance();
+    metrics.broadcasts.fetch_add(1, std::memory_order_relaxed);
+    metrics.broadcastRecipients.fetch_add(m_sessions.size(), std::memory_order_relaxed);
+
     for (auto& s : m_sessions) {
         if (s) s->send(msg);
     }
 }
 
-bool Room::empty() {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_sessions.empty() && players.empty();
+void Room::startRound(std::string word) {
+    post([this, word = std::move(word)]() {
+        currentRound.word = word;
+        currentRound.hints = HintPlan(word, std::chrono::seconds(currentRound.duration), HintPlan::defaults());
+        currentRound.hint = currentRound.hints.hint();
+        currentRound.matcher = GuessMatcher(word, GuessMatcher::defaults());
+        currentRound.startTime = std::chrono::steady_clock::now();
+        currentRound.active = true;
+        ++m_roundSeq;
+        m_timers.cancel(m_guessTimer); // guesses for a replaced round
+        m_guessTimer = TimerService::kNoTimer;
+        m_guesses.clear();
+
+        nlohmann::json msg = {
+            {"type", "round_start"},
+            {"payload", {
+                {"word", currentRound.word},
+                {"hint", currentRound.hint},
+                {"time", currentRound.duration}
+            }}
+        };
+        fanOut(makeMessage(msg.dump(), MessageClass::control));
+
+        // Start server-side timer
+        startServerTimer();
+        scheduleNextHint();
+        scheduleCountdown();
+    });
 }
 
-void Room::startRound(const std::string& word) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+void Room::handleGuess(std::string username, std::string guess) {
+    post([this, username = std::move(username), guess = std::move(guess)]() mutable {
+        if (!currentRound.active) {
+            LOG_DEBUG("ROOM", LogFields().room(m_id).user(username), "Guess ignored - no active round");
+            return;
+        }
 
-    currentRound.word = word;
-    currentRound.hint = std::string(word.size(), '_');
-    currentRound.startTime = std::chrono::steady_clock::now();
-    currentRound.active = true;
+        LOG_TRACE("ROOM", LogFields().room(m_id).user(username), "Guess: ", guess);
+        auto& metrics = Metrics::instance();
+        metrics.guessesReceived.fetch_add(1, std::memory_order_relaxed);
 
-    nlohmann::json msg = {
-        {"type", "round_start"},
-        {"payload", {
-            {"word", currentRound.word},
-            {"hint", currentRound.hint},
-            {"time", currentRound.duration}
-        }}
-    };
-    broadcast(msg.dump());
-    
-    // Start server-side timer
-    startServerTimer();
+        GuessOptions opts = GuessQueue::defaults();
+        if (!m_guesses.push(std::move(username), std::move(guess), opts.maxPending)) {
+            metrics.guessesDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (m_guessTimer == TimerService::kNoTimer)
+            m_guessTimer = scheduleRoundEvent(opts.tick, &Room::adjudicateGuesses);
+    });
 }
 
-void Room::handleGuess(const std::string& username, const std::string& guess) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-
-    if (!currentRound.active) {
-        std::cout << "[ROOM] Guess from " << username << " ignored - no active round" << std::endl;
-        return;
-    }
-    
-    std::cout << "[ROOM] Processing guess from " << username << ": " << guess << " (correct word: " << currentRound.word << ")" << std::endl;
-
-    if (guess == currentRound.word) {
+// One tick's worth of chat: the first correct guess wins and ends the
+// round; otherwise new wrong guesses go out as a single summary.
+void Room::adjudicateGuesses() {
+    m_guessTimer = TimerService::kNoTimer;
+    GuessOptions opts = GuessQueue::defaults();
+    GuessQueue::Verdict verdict = m_guesses.adjudicate(currentRound.matcher, opts.recentLimit, opts.maxSeen);
+
+    auto& metrics = Metrics::instance();
+    metrics.guessTicks.fetch_add(1, std::memory_order_relaxed);
+    metrics.guessesDuplicate.fetch_add(verdict.duplicates, std::memory_order_relaxed);
+    metrics.guessesUnremembered.fetch_add(verdict.unremembered, std::memory_order_relaxed);
+
+    if (verdict.correct) {
+        metrics.guessesCorrect.fetch_add(1, std::memory_order_relaxed);
+        const std::string& username = verdict.winner.user;
         // award points
-        if (players.find(username) != players.end()) {
-            players[username].score += 100; // basic scoring
+        auto it = players.find(username);
+        if (it != players.end()) {
+            it->second.score += 100; // basic scoring
         }
 
         nlohmann::json correctMsg = {
             {"type", "guess"},
             {"payload", {
                 {"user", username},
-                {"word", guess},
+                {"word", currentRound.word},
                 {"correct", true},
-                {"score", players.find(username) != players.end() ? players[username].score : 0}
+                {"score", it != players.end() ? it->second.score : 0}
             }}
         };
-        broadcast(correctMsg.dump());
+        fanOut(makeMessage(correctMsg.dump(), MessageClass::control));
 
-        // end round - call endRoundInternal to avoid deadlock
         endRoundInternal();
+        return;
     }
-    else {
-        nlohmann::json wrongMsg = {
-            {"type", "guess"},
-            {"payload", {
-                {"user", username},
-                {"word", guess},
-                {"correct", false}
-            }}
-        };
-        broadcast(wrongMsg.dump());
+
+    if (verdict.wrong == 0) return;
+    metrics.guessesWrong.fetch_add(verdict.wrong, std::memory_order_relaxed);
+    metrics.guessesClose.fetch_add(verdict.close.size(), std::memory_order_relaxed);
+
+    nlohmann::json recent = nlohmann::json::array();
+    for (auto& guess : verdict.recent) {
+        recent.push_back({ {"user", std::move(guess.user)}, {"word", std::move(guess.word)} });
+    }
+    nlohmann::json close = nlohmann::json::array();
+    for (auto& guess : verdict.close) {
+        close.push_back({ {"user", std::move(guess.user)}, {"word", std::move(guess.word)} });
     }
+    nlohmann::json wrongMsg = {
+        {"type", "guesses"},
+        {"payload", {
+            {"count", verdict.wrong},
+            {"recent", std::move(recent)},
+            {"close", std::move(close)}
+        }}
+    };
+    fanOut(makeMessage(wrongMsg.dump(), MessageClass::control));
 }
 
 void Room::endRound() {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    endRoundInternal();
+    post([this]() { endRoundInternal(); });
 }
 
 void Room::endRoundInternal() {
     if (!currentRound.active) return;
     currentRound.active = false;
+    m_timers.cancel(m_roundTimer);
+    m_timers.cancel(m_hintTimer);
+    m_timers.cancel(m_countdownTimer);
+    m_timers.cancel(m_guessTimer);
+    m_roundTimer = TimerService::kNoTimer;
+    m_hintTimer = TimerService::kNoTimer;
+    m_countdownTimer = TimerService::kNoTimer;
+    m_guessTimer = TimerService::kNoTimer;
+    m_guesses.clear();
 
     nlohmann::json endMsg = {
         {"type","round_end"},
@@ -178,104 +286,322 @@ void Room::endRoundInternal() {
         endMsg["payload"]["scores"][username] = p.score;
     }
 
-    broadcast(endMsg.dump());
+    fanOut(makeMessage(endMsg.dump(), MessageClass::control));
+}
+
+TimerService::TimerId Room::scheduleRoundEvent(std::chrono::milliseconds delay, void (Room::*event)()) {
+    // The timer holds the room weakly and hands the event back to the strand.
+    std::weak_ptr<Room> weak = weak_from_this();
+    std::uint64_t round = m_roundSeq;
+    return m_timers.schedule(delay, [weak, round, event]() {
+        auto self = weak.lock();
+        if (!self) return;
+        Room* room = self.get();
+        room->post([room, round, event]() {
+            if (room->m_roundSeq != round || !room->currentRound.active) return;
+            (room->*event)();
+        });
+    });
 }
 
 void Room::startServerTimer() {
-    // Start a thread to check timer every second
-    std::thread([this]() {
-        for (int i = 0; i < currentRound.duration; ++i) {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-            
-            // Check if round is still active
-            {
-                std::lock_guard<std::mutex> lock(m_mutex);
-                if (!currentRound.active) {
-                    return; // Round ended early (correct guess)
-                }
+    // A round restarted while running replaces its timers.
+    m_timers.cancel(m_roundTimer);
+    m_roundTimer = scheduleRoundEvent(std::chrono::seconds(currentRound.duration), &Room::onRoundExpired);
+}
+
+void Room::onRoundExpired() {
+    m_roundTimer = TimerService::kNoTimer;
+    LOG_INFO("ROOM", LogFields().room(m_id), "Server timer expired - ending round");
+    endRoundInternal();
+}
+
+// One pending timer per round: each reveal schedules the next, at its
+// offset from the round start rather than from this reveal.
+void Room::scheduleNextHint() {
+    m_timers.cancel(m_hintTimer);
+    m_hintTimer = TimerService::kNoTimer;
+    if (currentRound.hints.done()) return;
+
+    auto due = currentRound.startTime + currentRound.hints.next().at;
+    auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(due - std::chrono::steady_clock::now());
+    m_hintTimer = scheduleRoundEvent(std::max(delay, std::chrono::milliseconds(0)), &Room::revealHint);
+}
+
+void Room::revealHint() {
+    m_hintTimer = TimerService::kNoTimer;
+    std::size_t index = currentRound.hints.next().index;
+    std::string letter = currentRound.hints.reveal();
+    currentRound.hint = currentRound.hints.hint();
+    Metrics::instance().hintsRevealed.fetch_add(1, std::memory_order_relaxed);
+
+    // Just the letter; clients patch their copy of the hint.
+    nlohmann::json msg = {
+        {"type", "hint"},
+        {"payload", {
+            {"index", index},
+            {"letter", letter}
+        }}
+    };
+    fanOut(makeMessage(msg.dump(), MessageClass::control));
+    scheduleNextHint();
+}
+
+// Like hints: one pending timer per round, each tick scheduling the next
+// mark at its offset from the round start.
+void Room::scheduleCountdown() {
+    m_timers.cancel(m_countdownTimer);
+    m_countdownTimer = TimerService::kNoTimer;
+
+    auto elapsed = std::chrono::steady_clock::now() - currentRound.startTime;
+    for (int left : kCountdownMarks) {
+        auto at = std::chrono::seconds(currentRound.duration - left);
+        if (left >= currentRound.duration || at <= elapsed) continue;
+        auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(at - elapsed);
+        m_countdownTimer = scheduleRoundEvent(delay, &Room::sendCountdown);
+        return;
+    }
+}
+
+void Room::sendCountdown() {
+    m_countdownTimer = TimerService::kNoTimer;
+    auto end = currentRound.startTime + std::chrono::seconds(currentRound.duration);
+    auto left = std::chrono::ceil<std::chrono::seconds>(end - std::chrono::steady_clock::now());
+
+    // A lagging client only needs the latest.
+    nlohmann::json msg = {
+        {"type", "countdown"},
+        {"payload", {
+            {"remaining", std::max<long long>(left.count(), 0)}
+        }}
+    };
+    fanOut(makeMessage(msg.dump(), MessageClass::state, "countdown:" + m_id));
+    scheduleCountdown();
+}
+
+void Room::draw(json drawMsg) {
+    post([this, drawMsg = std::move(drawMsg)]() {
+        // store in room history; a stroke that was clamped or simplified is
+        // fanned out as stored
+        bool clamped = strokeHistory.appendJson(drawMsg["payload"]) == StrokeStore::Stored::clamped;
+        std::string msg;
+        if (simplifyNewestStroke() || clamped)
+            strokeHistory.appendJsonMessage(msg, strokeHistory[strokeHistory.size() - 1]);
+        else
+            msg = drawMsg.dump();
+        m_checkpoints.afterAppend(strokeHistory, m_id);
+        updateActivity();
+
+        fanOut(makeMessage(std::move(msg), MessageClass::draw));
+    });
+}
+
+void Room::binary(std::string msg) {
+    post([this, msg = std::move(msg)]() {
+        // Validated by the caller; parsed again here because the header
+        // views into this copy of the bytes.
+        StrokeCodec::Header header;
+        if (!StrokeCodec::parseHeader(msg, header)) return;
+
+        std::string simplified; // the stored stroke, if it differs from msg
+        switch (header.op) {
+        case StrokeCodec::Op::draw: {
+            StrokeStore::Stored stored = strokeHistory.appendBinary(header.body);
+            if (stored != StrokeStore::Stored::rejected) {
+                if (simplifyNewestStroke() || stored == StrokeStore::Stored::clamped)
+                    strokeHistory.appendBinaryMessage(simplified, strokeHistory[strokeHistory.size() - 1]);
+                m_checkpoints.afterAppend(strokeHistory, m_id);
             }
+            updateActivity();
+            break;
+        }
+        case StrokeCodec::Op::clear:
+            doClear();
+            break;
+        case StrokeCodec::Op::undo:
+            if (!doUndo()) return;
+            break;
+        }
+
+        StrokeCodec::Header reduced;
+        if (!simplified.empty() && StrokeCodec::parseHeader(simplified, reduced)) {
+            relayBinary(reduced, simplified);
+            return;
         }
-        
-        // Timer expired - end the round
-        std::cout << "[ROOM] Server timer expired - ending round" << std::endl;
-        endRound();
-    }).detach();
+        relayBinary(header, msg);
+    });
 }
 
-void Room::checkTimer() {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
-    if (!currentRound.active) return;
-    
-    auto now = std::chrono::steady_clock::now();
-    auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - currentRound.startTime);
-    
-    if (elapsed.count() >= currentRound.duration) {
-        std::cout << "[ROOM] Timer check - ending round" << std::endl;
-        endRoundInternal();
-    }
+// True when points were removed.
+bool Room::simplifyNewestStroke() {
+    if (!m_simplify.enabled() || strokeHistory.empty()) return false;
+    StrokeStore::StrokeView stroke = strokeHistory[strokeHistory.size() - 1];
+    if (stroke.kind == StrokeStore::Kind::raw) return false;
+
+    std::size_t before = stroke.count;
+    std::size_t removed = strokeHistory.simplifyBack(m_simplify);
+    auto& metrics = Metrics::instance();
+    metrics.simplifyStrokes.fetch_add(1, std::memory_order_relaxed);
+    metrics.simplifyPointsIn.fetch_add(before, std::memory_order_relaxed);
+    metrics.simplifyPointsOut.fetch_add(before - removed, std::memory_order_relaxed);
+    return removed != 0;
 }
 
-bool Room::hasPlayer(const std::string& username) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return players.find(username) != players.end();
+void Room::setSimplify(std::optional<float> tolerance, std::optional<float> minDistance) {
+    post([this, tolerance, minDistance]() {
+        if (tolerance) m_simplify.tolerance = *tolerance;
+        if (minDistance) m_simplify.minDistance = *minDistance;
+        LOG_INFO("ROOM", LogFields().room(m_id), "Stroke simplification: tolerance ",
+            m_simplify.tolerance, " px, min distance ", m_simplify.minDistance, " px");
+    });
 }
 
-// room.cpp
-void Room::addStroke(const json& stroke) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    strokeHistory.push_back(stroke);
-    updateActivity();
+void Room::undoStroke() {
+    post([this]() {
+        if (!doUndo()) return;
+        json undoMsg = {
+            {"type", "undo"},
+            {"room", m_id}
+        };
+        fanOut(makeMessage(undoMsg.dump(), MessageClass::control));
+    });
 }
 
 void Room::clearHistory() {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    post([this]() {
+        doClear();
+        json clearMsg = {
+            {"type", "clear"},
+            {"room", m_id}
+        };
+        fanOut(makeMessage(clearMsg.dump(), MessageClass::control));
+    });
+}
+
+bool Room::doUndo() {
+    if (!strokeHistory.popBack()) return false;
+    m_canvas.truncate(strokeHistory.size());
+    m_checkpoints.afterUndo(strokeHistory.size());
+    updateActivity();
+    return true;
+}
+
+void Room::doClear() {
     strokeHistory.clear();
+    m_canvas.clear();
+    m_checkpoints.afterClear();
 }
 
-void Room::replayHistory(std::shared_ptr<Session> s) {
-    std::vector<json> strokesCopy;
+void Room::sendState(std::shared_ptr<Session> s) {
+    if (!s) return;
+    post([this, s = std::move(s)]() {
+        json response;
+        response["type"] = "current_state";
+        std::vector<std::string> playerUsernames;
+        playerUsernames.reserve(players.size());
+        for (const auto& [username, p] : players) {
+            playerUsernames.push_back(username);
+        }
+        response["payload"]["players"] = playerUsernames;
+
+        // Include round state if active
+        if (currentRound.active) {
+            auto now = std::chrono::steady_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - currentRound.startTime);
+            int timeLeft = currentRound.duration - static_cast<int>(elapsed.count());
+            if (timeLeft < 0) timeLeft = 0;
+
+            response["payload"]["round"] = {
+                {"active", true},
+                {"word", currentRound.word},
+                {"hint", currentRound.hint},
+                {"timeLeft", timeLeft}
+            };
+        }
 
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        strokesCopy = strokeHistory; // Copy the strokes
-    }
+        // The strokes are already serialized; splice them in as the first
+        // payload member rather than round-tripping them through json.
+        MessagePtr strokes = strokeHistory.empty() ? nullptr : m_canvas.frame(strokeHistory);
+        std::string_view strokeHistoryJson = strokes ? std::string_view(strokes->payload()) : std::string_view("[]");
+        std::string payload = response["payload"].dump();
+        std::string msg;
+        msg.reserve(strokeHistoryJson.size() + payload.size() + 48);
+        msg += R"({"type":"current_state","payload":{"strokes":)";
+        msg += strokeHistoryJson;
+        msg += ',';
+        msg.append(payload, 1, std::string::npos);
+        msg += '}';
+        s->send(msg, MessageClass::state, "current_state:" + m_id);
+        LOG_DEBUG("STATE", LogFields().room(m_id).session(s->id()), "Sent current state (", strokeHistoryJson.size(), " bytes of strokes)");
+    });
+}
+
+void Room::relayBinary(const StrokeCodec::Header& header, std::string_view raw) {
+    MessageClass cls = header.op == StrokeCodec::Op::draw ? MessageClass::draw : MessageClass::control;
+    MessagePtr binary;
+    MessagePtr legacy;
 
-    // Send strokes outside of mutex lock
-    for (auto& stroke : strokesCopy) {
-        std::cout << "[DEBUG] Replaying stroke to " << (s ? "session" : "null") << "\n";
-        if (s) s->send(stroke.dump());
+    auto& metrics = Metrics::instance();
+    metrics.broadcasts.fetch_add(1, std::memory_order_relaxed);
+    metrics.broadcastRecipients.fetch_add(m_sessions.size(), std::memory_order_relaxed);
+
+    for (auto& s : m_sessions) {
+        if (!s) continue;
+        if (s->wantsBinaryStrokes()) {
+            if (!binary) binary = makeMessage(std::string(raw), cls, std::string(), WsOpcode::binary);
+            s->send(binary);
+        }
+        else {
+            if (!legacy) legacy = makeMessage(StrokeCodec::toJson(header).dump(), cls);
+            s->send(legacy);
+        }
     }
 }
 
-void Room::replayPlayers(std::shared_ptr<Session> s) {
-    std::vector<std::pair<int, std::string>> playerData;
-
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        for (auto& [username, p] : players) {
-            playerData.push_back({ p.id, p.username });
+void Room::replayHistory(const std::shared_ptr<Session>& s) {
+    if (!s || strokeHistory.empty()) return;
+    auto& metrics = Metrics::instance();
+    std::vector<MessagePtr> messages;
+    bool checkpoint = false;
+
+    // Clients that take raster checkpoints get the latest one and only the
+    // strokes drawn after it.
+    std::size_t first = 0;
+    if (s->wantsCheckpoints()) {
+        CanvasCheckpointer::Checkpoint latest = m_checkpoints.latest();
+        if (latest.message) {
+            messages.push_back(std::move(latest.message));
+            first = latest.strokes;
+            checkpoint = true;
         }
     }
 
-    // Send player data outside of mutex lock
-    for (auto& [id, username] : playerData) {
+    // The strokes go out as one frame whatever the client reads, so a join
+    // queues at most two messages however long the history is. The whole
+    // canvas is shared with every session that joins before it changes.
+    if (first < strokeHistory.size()) {
+        messages.push_back(m_canvas.since(strokeHistory, first, s->acceptsBatches(), m_id));
+        metrics.canvasSnapshotsSent.fetch_add(1, std::memory_order_relaxed);
+        metrics.canvasStrokesReplayed.fetch_add(strokeHistory.size() - first, std::memory_order_relaxed);
+    }
+    if (checkpoint) metrics.checkpointsSent.fetch_add(1, std::memory_order_relaxed);
+
+    LOG_TRACE("ROOM", LogFields().session(s->id()), "Replayed ", strokeHistory.size() - first, " stroke(s) in ",
+        messages.size(), " message(s)", checkpoint ? " from a checkpoint" : "");
+    for (auto& msg : messages) {
+        s->send(std::move(msg));
+    }
+}
+
+void Room::replayPlayers(const std::shared_ptr<Session>& s) {
+    for (auto& [username, p] : players) {
         nlohmann::json joinMsg = {
             {"type", "join"},
             {"payload", {
-                {"id", id},
+                {"id", p.id},
                 {"username", username}
             }}
         };
-        if (s) s->send(joinMsg.dump());
+        s->send(joinMsg.dump());
     }
 }
-
-std::unordered_set<std::string> Room::getPlayerUsernames() const {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    std::unordered_set<std::string> usernames;
-    for (const auto& [username, p] : players) {
-        usernames.insert(username);
-    }
-    return usernames;
-}
\ No newline at end of file
@@ -1,11 +1,24 @@
 #pragma once
 #include <unordered_map>
 #include <unordered_set>
+#include <array>
+#include <atomic>
+#include <functional>
 #include <memory>
-#include <mutex>
+#include <optional>
 #include <string>
 #include <chrono>
+#include <boost/asio.hpp>
 #include <nlohmann/json.hpp>
+#include "outboundMessage.h"
+#include "strokeCodec.h"
+#include "strokeStore.h"
+#include "canvasSnapshot.h"
+#include "canvasCheckpoint.h"
+#include "timerService.h"
+#include "hintPlan.h"
+#include "guessQueue.h"
+#include "rateLimiter.h"
 
 // forward declare only
 class Session;
@@ -17,53 +30,137 @@ struct Player {
 
 struct Round {
     std::string word;      // secret word
-    std::string hint;      // underscores for viewers
+    std::string hint;      // underscores for viewers, letters as hints reveal them
+    HintPlan hints;        // reveals still to come
+    GuessMatcher matcher;  // word, normalized for judging guesses
     bool active = false;
     std::chrono::steady_clock::time_point startTime;
     int duration = 60;     // seconds
 };
 
-
-class Room {
+// A room is an actor. Its state (sessions, players, round, stroke history)
+// is only touched by handlers running on its strand, which lives on the
+// room's home shard (ShardPool::homeShard of its id), so none of it is
+// locked; its timers run on that shard's TimerService. The public methods
+// are the mailbox: callable from any thread, they copy their arguments into
+// a handler, queue it and return. Results reach clients as messages sent
+// from the strand, in the order the operations were queued.
+class Room : public std::enable_shared_from_this<Room> {
 public:
-    Room(); // Constructor declaration only
-    void join(std::shared_ptr<Session> s, const std::string& username);  // match .cpp
-    bool leave(std::shared_ptr<Session> s);
-    void broadcast(const std::string& msg);
-    bool empty();
-    void endRound();
-    void endRoundInternal(); // Internal version without mutex lock
-    void startRound(const std::string& word);
-    void handleGuess(const std::string& username, const std::string& guess);
-    void startServerTimer(); // Server-side timer
-    void checkTimer(); // Check if round should end
+    Room(std::string id, boost::asio::io_context& io, TimerService& timers);
+
+    const std::string& id() const { return m_id; }
+
+    // Attaches s (if any), adds username as a player if new, and replays the
+    // players and strokes to s. If the room was closed before the handler
+    // ran, ifClosed is called on the strand instead so the caller can retry
+    // on the room that replaced it.
+    void join(std::shared_ptr<Session> s, std::string username, std::function<void()> ifClosed = nullptr);
+    // Client "leave". intentional (streamer back to menu) also clears the
+    // lobby. ifIdle runs on the strand if the room is left with no sessions
+    // and no players.
+    void leave(std::shared_ptr<Session> s, bool intentional, std::function<void()> ifIdle = nullptr);
+    // Connection closed: drop the session, keep its player.
+    void detach(std::shared_ptr<Session> s);
     void resetLobby();
-    bool hasPlayer(const std::string& username);
-    const std::unordered_map<std::string, Player>& getPlayers() const { return players; }
-    std::unordered_set<std::string> getPlayerUsernames() const;
-    const Round& getCurrentRound() const { return currentRound; }
-    void addStroke(const nlohmann::json& stroke);
+
+    void broadcast(std::string msg, MessageClass cls = MessageClass::control);
+    void broadcast(MessagePtr msg); // fan out one shared buffer
+
+    // drawMsg is {"type":"draw","room":..,"payload":..}; stored, simplified
+    // if the room simplifies, then fanned out.
+    void draw(nlohmann::json drawMsg);
+    // A validated StrokeCodec message (draw, clear or undo): applied, then
+    // raw bytes to binary-capable sessions, JSON (built at most once) to
+    // everyone else.
+    void binary(std::string msg);
     void clearHistory();
-    void replayHistory(std::shared_ptr<Session> s);
-    void replayPlayers(std::shared_ptr<Session> s); // NEW
-    
-    // NEW: Simple getters for persistence
-    const std::vector<nlohmann::json>& getStrokeHistory() const { return strokeHistory; }
+    void undoStroke(); // broadcasts "undo" only if there was a stroke
 
-    // Activity tracking
-    void updateActivity();
-    std::chrono::steady_clock::time_point getLastActivity() const;
+    void startRound(std::string word);
+    void handleGuess(std::string username, std::string guess); // queued, settled next tick
+    void endRound();
 
+    // Unset values keep the room's current setting.
+    void setSimplify(std::optional<float> tolerance, std::optional<float> minDistance);
+
+    // Sends s a "current_state" message: players, strokes and round.
+    void sendState(std::shared_ptr<Session> s);
+
+    // Readable from any thread.
+    bool idle() const { return m_state.load(std::memory_order_acquire) == kIdle; } // no sessions, no players
+    std::chrono::steady_clock::time_point getLastActivity() const;
+    // Marks the room removed from RoomManager; joins still queued go to
+    // their ifClosed. tryClose() only closes an idle room, atomically with
+    // respect to a join claiming it.
+    bool tryClose();
+    void close() { m_state.store(kClosed, std::memory_order_release); }
+    // Per-sender input limits, checked before a message is queued (see
+    // RoomManager::allowInput). Start at RateLimiter::defaults().
+    RateLimit rateLimit(RateClass cls) const {
+        return m_rateLimits[static_cast<std::size_t>(cls)].load(std::memory_order_relaxed);
+    }
+    void setRateLimit(RateClass cls, RateLimit limit) {
+        m_rateLimits[static_cast<std::size_t>(cls)].store(limit, std::memory_order_relaxed);
+    }
 
 private:
-    std::string m_roomName;
+    template <typename F>
+    void post(F&& fn) {
+        boost::asio::post(m_strand, [self = shared_from_this(), fn = std::forward<F>(fn)]() mutable { fn(); });
+    }
+
+    // Strand only.
+    void doJoin(const std::shared_ptr<Session>& s, const std::string& username);
+    void doResetLobby();
+    bool doUndo();
+    void doClear();
+    void fanOut(const MessagePtr& msg);
+    void endRoundInternal();
+    // Runs event on the strand after delay unless the round that scheduled
+    // it has ended or been replaced by then.
+    TimerService::TimerId scheduleRoundEvent(std::chrono::milliseconds delay, void (Room::*event)());
+    void startServerTimer(); // schedules round expiry on m_timers
+    void onRoundExpired();
+    void scheduleNextHint();
+    void revealHint();
+    void scheduleCountdown();
+    void sendCountdown();
+    void adjudicateGuesses();
+    void relayBinary(const StrokeCodec::Header& header, std::string_view raw);
+    // Latest raster checkpoint plus the strokes since for sessions that take
+    // checkpoints, else the whole canvas. Strokes always go in one frame: a
+    // bare array for batch-capable sessions, a "history" message otherwise.
+    void replayHistory(const std::shared_ptr<Session>& s);
+    void replayPlayers(const std::shared_ptr<Session>& s);
+    bool simplifyNewestStroke();
+    void updateActivity();
+    void refreshIdle();
+
+    enum : int { kIdle, kBusy, kClosed };
+
+    const std::string m_id;
+    boost::asio::strand<boost::asio::io_context::executor_type> m_strand;
+    TimerService& m_timers;
+
     std::unordered_set<std::shared_ptr<Session>> m_sessions;
-    mutable std::mutex m_mutex;
     std::unordered_map<std::string, Player> players;
     int nextPlayerId = 1;
+    SimplifyOptions m_simplify;
 
     // NEW: store all strokes for this room
-    std::vector<nlohmann::json> strokeHistory;
-    std::chrono::steady_clock::time_point m_lastActivity; // Track last activity
+    StrokeStore strokeHistory;
+    CanvasSnapshot m_canvas;          // strokeHistory as one frame, for late joiners
+    CanvasCheckpointer m_checkpoints; // strokeHistory flattened to PNG in the background
     Round currentRound;
+    std::uint64_t m_roundSeq = 0;
+    TimerService::TimerId m_roundTimer = TimerService::kNoTimer;
+    TimerService::TimerId m_hintTimer = TimerService::kNoTimer;
+    TimerService::TimerId m_countdownTimer = TimerService::kNoTimer;
+    GuessQueue m_guesses;
+    TimerService::TimerId m_guessTimer = TimerService::kNoTimer; // pending tick, if guesses are queued
+
+    std::atomic<int> m_state{ kIdle };
+    std::atomic<std::chrono::steady_clock::rep> m_lastActivity; // Track last activity
+    std::array<std::atomic<RateLimit>, kRateClasses> m_rateLimits;
 };
@@ -2,33 +2,54 @@
 #include "session.h"
 #include "server.h"
 #include "TwitchClient.h"      // fixes TwitchClient errors
-#include <iostream>
+#include "metrics.h"
+#include "logger.h"
+#include <algorithm>
 
 using json = nlohmann::json;
 
+// Finds or creates the room and queues the join while holding m_mutex, so
+// the room cannot be removed in between without the join seeing it closed;
+// in that case the join comes back here and lands on a fresh room.
 void RoomManager::joinRoom(const std::string& roomId, std::shared_ptr<Session> s, const std::string& username) {
+    if (!m_server) return;
     std::lock_guard<std::mutex> lock(m_mutex);
-    m_rooms[roomId].join(s, username);
+    auto& room = m_rooms[roomId];
+    if (!room) {
+        ShardPool& shards = m_server->shards();
+        std::size_t shard = shards.homeShard(roomId);
+        room = std::make_shared<Room>(roomId, shards.io(shard), m_server->timers(shard));
+    }
+    if (s) m_sessionRooms[s].insert(roomId);
+    room->join(s, username, [this, roomId, s, username]() { joinRoom(roomId, s, username); });
 }
 
+// Disconnect (or a refresh): the session stops receiving, its players stay
+// so a reconnecting streamer finds the lobby as it was.
 void RoomManager::leaveAll(std::shared_ptr<Session> s) {
     std::lock_guard<std::mutex> lock(m_mutex);
-    for (auto& pair : m_rooms) {
-        const std::string& id = pair.first;
-        Room& room = pair.second;
-
-        if (room.leave(s)) {
-            json sysMsg = {
-                {"type", "system"},
-                {"room", id},
-                {"payload", "Streamer disconnected, lobby cleared"}
-            };
-            room.broadcast(sysMsg.dump());
-
-            // clear players too if streamer disconnects
-            room.resetLobby();
-        }
+    auto joined = m_sessionRooms.find(s);
+    if (joined == m_sessionRooms.end()) return;
+    for (const std::string& id : joined->second) {
+        auto it = m_rooms.find(id);
+        if (it != m_rooms.end()) it->second->detach(s);
     }
+    m_sessionRooms.erase(joined);
+}
+
+std::shared_ptr<Room> RoomManager::findRoom(const std::string& roomId) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_rooms.find(roomId);
+    return it != m_rooms.end() ? it->second : nullptr;
+}
+
+void RoomManager::removeIfIdle(const std::shared_ptr<Room>& room) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_rooms.find(room->id());
+    if (it == m_rooms.end() || it->second != room || !room->tryClose()) return;
+    LOG_INFO("ROOM", LogFields().room(room->id()), "Room is empty, removing it");
+    m_roomOwners.erase(room->id());
+    m_rooms.erase(it);
 }
 
 static std::string normalizeRoom(const std::string& roomId) {
@@ -42,6 +63,7 @@ void RoomManager::handleJoin(std::shared_ptr<Session> s, const nlohmann::json& j
     
     // Also clean up expired rooms (inactive for 1+ hours)
     cleanupExpiredRooms();
+    m_limiter.sweep();
 
     std::string username;
 
@@ -54,128 +76,97 @@ void RoomManager::handleJoin(std::shared_ptr<Session> s, const nlohmann::json& j
     }
 
     if (username.empty()) return;
+    // Binary strokes carry the room id behind a one-byte length.
+    if (roomId.size() > StrokeCodec::kMaxRoom) {
+        LOG_WARN("ROOM", LogFields().session(s ? s->id() : 0), "Rejected join: room id longer than ", StrokeCodec::kMaxRoom, " bytes");
+        return;
+    }
 
-    Room* room;
+    std::string channel = j.value("channel", "");
     bool isNewRoom = false;
     {
         std::lock_guard<std::mutex> lock(m_mutex);
-        auto it = m_rooms.find(roomId);
-        if (it == m_rooms.end()) {
+        isNewRoom = m_rooms.find(roomId) == m_rooms.end();
+        if (isNewRoom) {
             // This is a new room being created
-            isNewRoom = true;
-            std::cout << "[ROOM] Creating new room: " << roomId << std::endl;
-        } else {
-            // Room exists - just update bot's current room, don't reset players
-            std::cout << "[ROOM] Reconnecting to existing room: " << roomId << std::endl;
-            
-            // Update the bot's current room to this room
-            if (m_server) {
-                std::string channel = j.value("channel", "");
-                if (!channel.empty()) {
-                    m_roomChannels[roomId] = channel;
-                    m_server->setCurrentRoom("#" + channel, roomId);
-                    std::cout << "[ROOM] Updated bot's current room to: " << roomId << std::endl;
+            LOG_INFO("ROOM", LogFields().room(roomId), "Creating new room");
+            if (!channel.empty()) {
+                // Clear any existing room for this channel first
+                for (auto it = m_roomChannels.begin(); it != m_roomChannels.end();) {
+                    if (it->second == channel) {
+                        LOG_DEBUG("ROOM", LogFields().room(it->first), "Removing old room entry for channel ", channel);
+                        it = m_roomChannels.erase(it);
+                    } else {
+                        ++it;
+                    }
                 }
             }
-        }
-        room = &m_rooms[roomId];
-    }
-    
-    // If this is a new room, set it as the current room for the Twitch bot
-    if (isNewRoom && m_server) {
-        // Extract channel from the join message
-        std::string channel = j.value("channel", "");
-        if (!channel.empty()) {
-            // Clear any existing room for this channel first
-            for (auto it = m_roomChannels.begin(); it != m_roomChannels.end();) {
-                if (it->second == channel) {
-                    std::cout << "[ROOM] Removing old room entry: " << it->first << " for channel " << channel << std::endl;
-                    it = m_roomChannels.erase(it);
-                } else {
-                    ++it;
-                }
-            }
-            
-            // Store the channel this room belongs to
-            m_roomChannels[roomId] = channel;
-            std::cout << "[ROOM] Room " << roomId << " belongs to channel " << channel << std::endl;
-            
-            // Set this as the current room for that channel's Twitch bot
-            m_server->setCurrentRoom("#" + channel, roomId);
-            std::cout << "[ROOM] Bot connected to new room: " << roomId << std::endl;
         } else {
-            std::cout << "[WARN] No channel specified for new room " << roomId << std::endl;
+            // Room exists - just update bot's current room, don't reset players
+            LOG_INFO("ROOM", LogFields().room(roomId), "Reconnecting to existing room");
         }
+        // The creator owns the room. A streamer coming back after a refresh
+        // rejoins with the room's channel and takes it over once the old
+        // session is gone.
+        auto channelIt = m_roomChannels.find(roomId);
+        bool streamerRejoin = !channel.empty() && channelIt != m_roomChannels.end() && channelIt->second == channel;
+        if (s && (isNewRoom || (streamerRejoin && m_roomOwners[roomId].expired())))
+            m_roomOwners[roomId] = s;
+        // Store the channel this room belongs to
+        if (!channel.empty()) m_roomChannels[roomId] = channel;
     }
 
-    if (room->hasPlayer(username)) {
-        std::cout << "[SPAM] Duplicate join from " << username << " (replaying state)\n";
-        if (s) {
-            room->join(s, username);     // attach new session
-            room->replayPlayers(s);      // send full player list
-            room->replayHistory(s);      // send all strokes
-        }
-        return;
+    // Twitch chat for the channel now reaches this room (getCurrentRoom)
+    if (!channel.empty()) {
+        LOG_INFO("ROOM", LogFields().room(roomId), "Room belongs to channel ", channel);
+    } else if (isNewRoom) {
+        LOG_WARN("ROOM", LogFields().room(roomId), "No channel specified for new room");
     }
 
-    // First-time join
-    room->join(s, username);
+    // A duplicate join attaches s and replays players and strokes
+    joinRoom(roomId, s, username);
 }
 
 
 
 
 void RoomManager::handleLeave(std::shared_ptr<Session> s, const nlohmann::json& j, const std::string& roomId) {
-    auto it = m_rooms.find(roomId);
-    if (it != m_rooms.end()) {
-        Room& room = it->second;
-
-        // Check if this is a streamer leaving (intentional) vs refresh (unintentional)
-        bool isStreamerLeaving = j.value("intentional", false);
-        
-        if (isStreamerLeaving) {
-            // Streamer clicked back to menu - clear all players
-            for (auto& [uname, p] : room.getPlayers()) {
-                nlohmann::json leaveMsg = {
-                    {"type", "leave"},
-                    {"payload", {
-                        {"id", p.id},
-                        {"username", uname}
-                    }}
-                };
-                room.broadcast(leaveMsg.dump());
-            }
-            room.resetLobby();
-        }
-        
-        room.leave(s);
-
-        // Clean up abandoned rooms
-        if (room.empty()) {
-            std::cout << "[ROOM] Room " << roomId << " is empty, removing it" << std::endl;
-            m_rooms.erase(it);
+    std::shared_ptr<Room> room;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_rooms.find(roomId);
+        if (it == m_rooms.end()) return;
+        room = it->second;
+        auto joined = m_sessionRooms.find(s);
+        if (joined != m_sessionRooms.end()) {
+            joined->second.erase(roomId);
+            if (joined->second.empty()) m_sessionRooms.erase(joined);
         }
     }
+
+    // Check if this is a streamer leaving (intentional) vs refresh (unintentional);
+    // the former clears all players. Clean up the room once it is abandoned.
+    bool isStreamerLeaving = j.value("intentional", false);
+    room->leave(s, isStreamerLeaving, [this, room]() { removeIfIdle(room); });
 }
 
 
-void RoomManager::handleChat(std::shared_ptr<Session>, const json& j, const std::string& roomId) {
+void RoomManager::handleChat(std::shared_ptr<Session> s, const json& j, const std::string& roomId) {
     std::string payload = j.value("payload", "");
     if (!roomId.empty() && !payload.empty()) {
-        std::cout << "[DEBUG] handleChat called with payload=" << payload << std::endl; // test line
+        auto room = findRoom(roomId);
+        if (!room || !allowSession(s, *room, RateClass::chat)) return;
         json chatMsg = { {"type","chat"}, {"room",roomId}, {"payload",payload} };
-        m_rooms[roomId].broadcast(chatMsg.dump());
+        room->broadcast(chatMsg.dump());
     }
 }
 
 void RoomManager::handleEndRound(const std::string& roomId) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    auto it = m_rooms.find(roomId);
-    if (it != m_rooms.end()) {
-        std::cout << "[ROOM] Ending round for room: " << roomId << std::endl;
-        it->second.endRound();
+    if (auto room = findRoom(roomId)) {
+        LOG_INFO("ROOM", LogFields().room(roomId), "Ending round");
+        room->endRound();
     } else {
-        std::cout << "[WARN] Attempted to end round for non-existent room: " << roomId << std::endl;
+        LOG_WARN("ROOM", LogFields().room(roomId), "Attempted to end round for non-existent room");
     }
 }
 
@@ -183,14 +174,14 @@ void RoomManager::handleStopBot(const json& j) {
     std::string channel = j.value("channel", "");
     if (m_server) {
         // Clear all players from the current room before stopping the bot
-        Room* currentRoom = getCurrentRoom(channel);
+        std::shared_ptr<Room> currentRoom = getCurrentRoom(channel);
         if (currentRoom) {
-            std::cout << "[ROOM] Clearing all players from room before stopping bot for channel: " << channel << std::endl;
+            LOG_INFO("ROOM", "Clearing all players from room before stopping bot for channel: ", channel);
             currentRoom->resetLobby();
         }
         
         m_server->stopBot(channel);
-        std::cout << "ADMIN Stopped Twitch bot for channel: " << channel << "\n";
+        LOG_INFO("ADMIN", "Stopped Twitch bot for channel: ", channel);
     }
 }
 
@@ -202,10 +193,10 @@ void RoomManager::handleSpawnBot(const json& j) {
     if (m_server) {
         bool spawned = m_server->spawnBot(oauth, nick, channel);
         if (spawned) {
-            std::cout << "ADMIN Spawned Twitch bot for channel: " << channel << "\n";
+            LOG_INFO("ADMIN", "Spawned Twitch bot for channel: ", channel);
         }
         else {
-            std::cout << "[ADMIN] Bot for channel " << channel << " already exists, ignoring spawn.\n";
+            LOG_INFO("ADMIN", "Bot for channel ", channel, " already exists, ignoring spawn");
         }
     }
 }
@@ -215,30 +206,52 @@ void RoomManager::handleMapTwitchRoom(const json& j) {
     std::string roomId = j.value("payload", json::object()).value("room_id", "");
     
     if (twitchName.empty() || roomId.empty()) {
-        std::cout << "[ERROR] map_twitch_room missing required fields: twitch_name=" << twitchName << ", room_id=" << roomId << std::endl;
+        LOG_ERROR("ROOM", "map_twitch_room missing required fields: twitch_name=", twitchName, ", room_id=", roomId);
         return;
     }
     
-    std::cout << "[ROOM] Mapping Twitch channel " << twitchName << " to room " << roomId << std::endl;
+    LOG_INFO("ROOM", LogFields().room(roomId), "Mapping Twitch channel ", twitchName);
     
     // Store the mapping
-    m_roomChannels[roomId] = twitchName;
-    
-    // Set the current room for the Twitch bot
-    if (m_server) {
-        m_server->setCurrentRoom("#" + twitchName, roomId);
-        std::cout << "[ROOM] Set current room for Twitch bot #" << twitchName << " to " << roomId << std::endl;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_roomChannels[roomId] = twitchName;
     }
 }
 
-void RoomManager::handleStatus(const std::string& jsonMsg) {
+void RoomManager::handleStatus(const json& j, std::string_view jsonMsg) {
     if (m_server) {
-        m_server->broadcast(jsonMsg);
+        // Only the latest status per channel matters to a lagging client.
+        m_server->broadcast(std::string(jsonMsg), MessageClass::state, "status:" + j.value("channel", ""));
     }
 }
 
+void RoomManager::handleGetStats(std::shared_ptr<Session> s) {
+    if (!s) return;
+    json payload = Metrics::instance().toJson();
+    if (m_server) payload["shards"] = m_server->shardSessionCounts();
+    json statsMsg = {
+        {"type", "stats"},
+        {"payload", std::move(payload)}
+    };
+    s->send(statsMsg.dump(), MessageClass::state, "stats");
+}
+
+// Per-connection capability negotiation, e.g.
+// {"type":"hello","payload":{"batch":true}}
+void RoomManager::handleHello(std::shared_ptr<Session> s, const json& j) {
+    if (!s) return;
+    json caps = j.value("payload", json::object());
+    if (!caps.is_object()) return;
+    s->setBatchEnvelope(caps.value("batch", false));
+    s->setBinaryStrokes(caps.value("binary", false));
+    s->setCheckpoints(caps.value("checkpoint", false));
+}
+
 void RoomManager::handleDraw(std::shared_ptr<Session> s, const json& j, const std::string& roomId) {
     if (roomId.empty()) return;
+    auto room = findRoom(roomId);
+    if (!room || !allowSession(s, *room, RateClass::draw)) return;
 
     json drawMsg = {
         {"type", "draw"},
@@ -246,76 +259,105 @@ void RoomManager::handleDraw(std::shared_ptr<Session> s, const json& j, const st
         {"payload", j["payload"]}
     };
 
-    // store in room history
-    m_rooms[roomId].addStroke(drawMsg);
+    // stored in room history and broadcast to all from the room's strand
+    room->draw(std::move(drawMsg));
+}
 
-    // broadcast to all
-    m_rooms[roomId].broadcast(drawMsg.dump());
+// {"type":"set_simplify","room":..,"payload":{"tolerance":1.5,"minDistance":1}}
+// Distances in px; 0 turns a stage off, missing keys keep the current value.
+void RoomManager::handleSetSimplify(std::shared_ptr<Session> s, const json& j, const std::string& roomId) {
+    if (roomId.empty()) return;
+    auto room = findRoom(roomId);
+    if (!room) return;
+    if (!isOwner(s, roomId)) {
+        LOG_WARN("SECURITY", LogFields().room(roomId).session(s ? s->id() : 0), "Blocked set_simplify from a session that does not own the room");
+        return;
+    }
+    json payload = j.value("payload", json::object());
+    if (!payload.is_object()) return;
+
+    constexpr float kMaxDistance = 50.0f;
+    auto clamp = [&](const char* key) -> std::optional<float> {
+        auto v = payload.find(key);
+        if (v == payload.end() || !v->is_number()) return std::nullopt;
+        return std::min(std::max(v->get<float>(), 0.0f), kMaxDistance);
+    };
+    room->setSimplify(clamp("tolerance"), clamp("minDistance"));
 }
 
-void RoomManager::handleClear(std::shared_ptr<Session> s, const json& j, const std::string& roomId) {
+// {"type":"set_rate_limits","room":..,"payload":{"guess":{"rate":2,"burst":5}}}
+// Per sender, for "guess", "chat" and "draw"; rate in messages per second,
+// 0 turns the limit off. Missing classes and keys keep the current value.
+void RoomManager::handleSetRateLimits(std::shared_ptr<Session> s, const json& j, const std::string& roomId) {
     if (roomId.empty()) return;
+    auto room = findRoom(roomId);
+    if (!room) return;
+    if (!isOwner(s, roomId)) {
+        LOG_WARN("SECURITY", LogFields().room(roomId).session(s ? s->id() : 0), "Blocked set_rate_limits from a session that does not own the room");
+        return;
+    }
+    json payload = j.value("payload", json::object());
+    if (!payload.is_object()) return;
 
-    json clearMsg = {
-        {"type", "clear"},
-        {"room", roomId}
+    constexpr float kMaxRate = 1000.0f;
+    constexpr float kMaxBurst = 10000.0f;
+    static const std::pair<const char*, RateClass> kClasses[] = {
+        { "guess", RateClass::guess }, { "chat", RateClass::chat }, { "draw", RateClass::draw }
     };
+    for (const auto& [name, cls] : kClasses) {
+        auto entry = payload.find(name);
+        if (entry == payload.end() || !entry->is_object()) continue;
+        RateLimit limit = room->rateLimit(cls);
+        auto rate = entry->find("rate");
+        if (rate != entry->end() && rate->is_number()) limit.rate = std::min(std::max(rate->get<float>(), 0.0f), kMaxRate);
+        auto burst = entry->find("burst");
+        if (burst != entry->end() && burst->is_number()) limit.burst = std::min(std::max(burst->get<float>(), 1.0f), kMaxBurst);
+        room->setRateLimit(cls, limit);
+        LOG_INFO("ROOM", LogFields().room(roomId), "Rate limit for ", name, ": ", limit.rate, "/s, burst ", limit.burst);
+    }
+}
+
+void RoomManager::handleClear(std::shared_ptr<Session> s, const json& j, const std::string& roomId) {
+    if (roomId.empty()) return;
+
+    // clear room history and broadcast clear
+    auto room = findRoom(roomId);
+    if (room && allowSession(s, *room, RateClass::draw)) room->clearHistory();
+}
+
+void RoomManager::handleUndo(std::shared_ptr<Session> s, const json& j, const std::string& roomId) {
+    if (roomId.empty()) return;
+
+    auto room = findRoom(roomId);
+    if (room && allowSession(s, *room, RateClass::draw)) room->undoStroke();
+}
+
+// Binary draw/clear/undo (see StrokeCodec). Relayed without touching JSON;
+// only the header and the point-run structure are checked.
+void RoomManager::onBinaryMessage(std::shared_ptr<Session> s, std::string_view msg) {
+    StrokeCodec::Header header;
+    if (!StrokeCodec::parseHeader(msg, header) ||
+        (header.op == StrokeCodec::Op::draw && !StrokeCodec::validateDraw(header.body))) {
+        LOG_WARN("ROOM", LogFields().session(s ? s->id() : 0), "Malformed binary stroke message (", msg.size(), " bytes)");
+        return;
+    }
 
-    // clear room history
-    m_rooms[roomId].clearHistory();
+    auto room = findRoom(normalizeRoom(std::string(header.room)));
+    if (!room || !allowSession(s, *room, RateClass::draw)) return;
 
-    // broadcast clear
-    m_rooms[roomId].broadcast(clearMsg.dump());
+    // The bytes live in the session's read buffer; the room gets its own copy.
+    room->binary(std::string(msg));
 }
 
 void RoomManager::handleRestoreState(std::shared_ptr<Session> s, const std::string& roomId) {
-    std::cout << "[DEBUG] handleRestoreState called for room: " << roomId << std::endl;
     if (roomId.empty() || !s) return;
 
-    auto it = m_rooms.find(roomId);
-    if (it != m_rooms.end()) {
-        const Room& room = it->second;
-
-        // Get data outside of any potential locks
-        std::vector<std::string> playerUsernames;
-        std::vector<json> strokeHistory;
-
-        {
-            std::lock_guard<std::mutex> lock(m_mutex);
-            // Fix: Get the data first, then copy it properly
-            auto usernames = room.getPlayerUsernames();
-            playerUsernames.assign(usernames.begin(), usernames.end());
-            strokeHistory = room.getStrokeHistory();
-        }
-
+    if (auto room = findRoom(roomId)) {
         // Send current state back to client
-        json response;
-        response["type"] = "current_state";
-        response["payload"]["players"] = playerUsernames;
-        response["payload"]["strokes"] = strokeHistory;
-        
-        // Include round state if active
-        const Round& currentRound = room.getCurrentRound();
-        if (currentRound.active) {
-            auto now = std::chrono::steady_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(now - currentRound.startTime);
-            int timeLeft = currentRound.duration - elapsed.count();
-            if (timeLeft < 0) timeLeft = 0;
-            
-            response["payload"]["round"] = {
-                {"active", true},
-                {"word", currentRound.word},
-                {"hint", currentRound.hint},
-                {"timeLeft", timeLeft}
-            };
-        }
-
-        std::cout << "[DEBUG] About to send state with " << strokeHistory.size() << " strokes" << std::endl;
-        s->send(response.dump());
-        std::cout << "[STATE] Sent current state to client for room: " << roomId << std::endl;
+        room->sendState(s);
     }
     else {
-        std::cout << "[DEBUG] Room not found: " << roomId << std::endl;
+        LOG_DEBUG("STATE", LogFields().room(roomId), "Room not found");
     }
 }
 
@@ -324,8 +366,9 @@ void RoomManager::cleanupAbandonedRooms() {
 
     auto it = m_rooms.begin();
     while (it != m_rooms.end()) {
-        if (it->second.empty()) {
-            std::cout << "[ROOM] Cleaning up abandoned room: " << it->first << std::endl;
+        if (it->second->tryClose()) {
+            LOG_INFO("ROOM", LogFields().room(it->first), "Cleaning up abandoned room");
+            m_roomOwners.erase(it->first);
             it = m_rooms.erase(it);
         }
         else {
@@ -342,13 +385,15 @@ void RoomManager::cleanupExpiredRooms() {
     
     auto it = m_rooms.begin();
     while (it != m_rooms.end()) {
-        auto lastActivity = it->second.getLastActivity();
+        auto lastActivity = it->second->getLastActivity();
         if (now - lastActivity > oneHour) {
-            std::cout << "[ROOM] Cleaning up expired room: " << it->first 
-                      << " (inactive for " << std::chrono::duration_cast<std::chrono::minutes>(now - lastActivity).count() << " minutes)" << std::endl;
+            LOG_INFO("ROOM", LogFields().room(it->first), "Cleaning up expired room (inactive for ",
+                std::chrono::duration_cast<std::chrono::minutes>(now - lastActivity).count(), " minutes)");
             
             // Remove from room channels tracking
             m_roomChannels.erase(it->first);
+            m_roomOwners.erase(it->first);
+            it->second->close();
             
             it = m_rooms.erase(it);
         } else {
@@ -358,7 +403,7 @@ void RoomManager::cleanupExpiredRooms() {
 }
 
 
-Room* RoomManager::getCurrentRoom(const std::string& channel) {
+std::shared_ptr<Room> RoomManager::getCurrentRoom(const std::string& channel) {
     std::lock_guard<std::mutex> lock(m_mutex);
     
     // Normalize channel name (remove # if present)
@@ -372,20 +417,59 @@ Room* RoomManager::getCurrentRoom(const std::string& channel) {
         if (pair.second == normalizedChannel) {
             auto it = m_rooms.find(pair.first);
             if (it != m_rooms.end()) {
-                return &it->second;
+                return it->second;
             }
         }
     }
     return nullptr;
 }
 
-void RoomManager::onMessage(std::shared_ptr<Session> s, const std::string& jsonMsg) {
+bool RoomManager::allowInput(const Room& room, std::string_view sender, RateClass cls) {
+    if (m_limiter.allow(room.id(), sender, cls, room.rateLimit(cls))) return true;
+
+    auto& metrics = Metrics::instance();
+    switch (cls) {
+    case RateClass::guess: metrics.rateLimitedGuesses.fetch_add(1, std::memory_order_relaxed); break;
+    case RateClass::chat:  metrics.rateLimitedChats.fetch_add(1, std::memory_order_relaxed); break;
+    case RateClass::draw:  metrics.rateLimitedDraws.fetch_add(1, std::memory_order_relaxed); break;
+    }
+    return false;
+}
+
+bool RoomManager::isOwner(const std::shared_ptr<Session>& s, const std::string& roomId) {
+    if (!s) return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_roomOwners.find(roomId);
+    return it != m_roomOwners.end() && it->second.lock() == s;
+}
+
+// Messages injected without a session (Twitch via Server) are limited where
+// they enter, in GameProtocol.
+bool RoomManager::allowSession(const std::shared_ptr<Session>& s, const Room& room, RateClass cls) {
+    if (!s) return true;
+    return allowInput(room, "s" + std::to_string(s->id()), cls);
+}
+
+void RoomManager::onMessage(std::shared_ptr<Session> s, std::string_view jsonMsg) {
     try {
-        auto j = json::parse(jsonMsg);
-        std::string type = j.value("type", "");
+        // Parsed straight from the session's read buffer; nothing upstream
+        // copies the frame into a string first.
+        auto j = json::parse(jsonMsg.begin(), jsonMsg.end());
+        auto typeIt = j.find("type");
+        static const std::string kNoType;
+        const std::string& type = (typeIt != j.end() && typeIt->is_string())
+            ? typeIt->get_ref<const std::string&>() : kNoType;
+
+        // Hot path: heartbeats need nothing else from the message.
+        if (type == "pong") {
+            if (s) s->markPongReceived();
+            return;
+        }
+
         std::string roomId = normalizeRoom(j.value("room", ""));
 
-        if (type == "join")        handleJoin(s, j, roomId);
+        if (type == "draw")        handleDraw(s, j, roomId);
+        else if (type == "join")   handleJoin(s, j, roomId);
         else if (type == "leave")  handleLeave(s, j, roomId);
         else if (type == "chat")   handleChat(s, j, roomId);
         else if (type == "start_round") handleStartRound(s, j, roomId);
@@ -394,30 +478,32 @@ void RoomManager::onMessage(std::shared_ptr<Session> s, const std::string& jsonM
         else if (type == "stop_bot")  handleStopBot(j);
         else if (type == "spawn_bot") handleSpawnBot(j);
         else if (type == "map_twitch_room") handleMapTwitchRoom(j);
-        else if (type == "status")    handleStatus(jsonMsg);
-        else if (type == "pong" && s) s->markPongReceived();
-        else if (type == "draw")      handleDraw(s, j, roomId);
+        else if (type == "status")    handleStatus(j, jsonMsg);
         else if (type == "clear")     handleClear(s, j, roomId);
+        else if (type == "undo")      handleUndo(s, j, roomId);
         else if (type == "get_state") handleRestoreState(s, roomId);
+        else if (type == "get_stats") handleGetStats(s);
+        else if (type == "hello")     handleHello(s, j);
+        else if (type == "set_simplify") handleSetSimplify(s, j, roomId);
+        else if (type == "set_rate_limits") handleSetRateLimits(s, j, roomId);
         else {
-            std::cerr << "[WARN] Unknown type: " << type << " msg=" << jsonMsg << "\n";
+            LOG_WARN("ROOM", LogFields().session(s ? s->id() : 0), "Unknown type: ", type, " msg=", jsonMsg);
         }
     }
     catch (const std::exception& e) {
-        std::cerr << "[ERROR] onMessage parse failed: " << e.what()
-            << " raw=" << jsonMsg << "\n";
+        LOG_ERROR("ROOM", LogFields().session(s ? s->id() : 0), "onMessage parse failed: ", e.what(), " raw=", jsonMsg);
     }
 }
 
 void RoomManager::handleStartRound(std::shared_ptr<Session> s, const nlohmann::json& j, const std::string& roomId) {
     std::string word = j.value("payload", nlohmann::json::object()).value("word", "apple");
-    m_rooms[roomId].startRound(word);
+    if (auto room = findRoom(roomId)) room->startRound(std::move(word));
 }
 
 void RoomManager::handleGuess(std::shared_ptr<Session> s, const nlohmann::json& j, const std::string& roomId) {
     // Only allow guesses from Twitch chat, not direct WebSocket messages
     // This prevents cheating by sending direct WebSocket messages
-    std::cout << "[SECURITY] Blocked direct guess attempt from WebSocket session" << std::endl;
+    LOG_WARN("SECURITY", "Blocked direct guess attempt from WebSocket session");
     return;
 }
 
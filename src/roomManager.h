@@ -4,20 +4,30 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <nlohmann/json.hpp>
 #include "room.h"
+#include "rateLimiter.h"
 
 class Server;   // forward declare
 class Session;  // forward declare
 
+// Routes client and Twitch messages to rooms. m_mutex guards only the maps
+// below; room state lives on each room's strand (see Room), so a handler
+// finds its room under the lock, queues the operation and returns without
+// waiting for it.
 class RoomManager {
 public:
     RoomManager() : m_server(nullptr) {}
     void setServer(Server* server) { m_server = server; }
     void joinRoom(const std::string& roomId, std::shared_ptr<Session> s, const std::string& username);
-    void leaveAll(std::shared_ptr<Session> s);
-    void onMessage(std::shared_ptr<Session> s, const std::string& jsonMsg);
-    Room* getCurrentRoom(const std::string& channel);
+    void leaveAll(std::shared_ptr<Session> s); // connection closed; safe to call more than once
+    void onMessage(std::shared_ptr<Session> s, std::string_view jsonMsg);
+    void onBinaryMessage(std::shared_ptr<Session> s, std::string_view msg);
+    std::shared_ptr<Room> getCurrentRoom(const std::string& channel);
+    // Spends one of sender's tokens for cls in room (sender: "s<session id>"
+    // or "u<twitch name>"). False means drop the message; it is counted.
+    bool allowInput(const Room& room, std::string_view sender, RateClass cls);
 
 private:
     void handleJoin(std::shared_ptr<Session> s, const nlohmann::json& j, const std::string& roomId);
@@ -30,20 +40,33 @@ private:
     void handleStopBot(const nlohmann::json& j);
     void handleSpawnBot(const nlohmann::json& j);
     void handleMapTwitchRoom(const nlohmann::json& j);
-    void handleStatus(const std::string& jsonMsg);
+    void handleStatus(const nlohmann::json& j, std::string_view jsonMsg);
+    void handleGetStats(std::shared_ptr<Session> s);
+    void handleHello(std::shared_ptr<Session> s, const nlohmann::json& j);
 
 
     void handleDraw(std::shared_ptr<Session> s, const nlohmann::json& j, const std::string& roomId);
     void handleClear(std::shared_ptr<Session> s, const nlohmann::json& j, const std::string& roomId);
+    void handleUndo(std::shared_ptr<Session> s, const nlohmann::json& j, const std::string& roomId);
+    void handleSetSimplify(std::shared_ptr<Session> s, const nlohmann::json& j, const std::string& roomId);
+    void handleSetRateLimits(std::shared_ptr<Session> s, const nlohmann::json& j, const std::string& roomId);
+    bool allowSession(const std::shared_ptr<Session>& s, const Room& room, RateClass cls);
+    // Room settings are for the owner alone: the session that created the room.
+    bool isOwner(const std::shared_ptr<Session>& s, const std::string& roomId);
 
     // NEW: Handle state restoration
     void handleRestoreState(std::shared_ptr<Session> s, const std::string& roomId);
     void cleanupAbandonedRooms(); // NEW: Clean up empty rooms
     void cleanupExpiredRooms(); // NEW: Clean up rooms inactive for 1+ hours
+    std::shared_ptr<Room> findRoom(const std::string& roomId);
+    // Runs on the room's strand once it has become idle.
+    void removeIfIdle(const std::shared_ptr<Room>& room);
 
-    std::unordered_map<std::string, Room> m_rooms;
-    std::unordered_map<std::string, std::unordered_set<std::string>> m_joinedUsers;
+    std::unordered_map<std::string, std::shared_ptr<Room>> m_rooms;
+    std::unordered_map<std::shared_ptr<Session>, std::unordered_set<std::string>> m_sessionRooms; // rooms each session joined
     std::unordered_map<std::string, std::string> m_roomChannels; // Track which channel each room belongs to
+    std::unordered_map<std::string, std::weak_ptr<Session>> m_roomOwners; // session that created each room
     mutable std::mutex m_mutex;
+    RateLimiter m_limiter; // locks per stripe, not under m_mutex
     Server* m_server;
 };
@@ -1,14 +1,50 @@
 #include "server.h"
 #include "session.h"
 #include "TwitchBotManager.h"
-#include <iostream>
+#include "logger.h"
 
-Server::Server(boost::asio::io_context& io, int port)
-    : m_acceptor(io, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)),
-    m_acceptSocket(io),
+#if defined(__linux__) && defined(SO_REUSEPORT)
+// Linux spreads incoming connections across every listener bound with
+// SO_REUSEPORT; elsewhere the option either doesn't exist or only lets
+// the last listener win, so fall back to one acceptor.
+#define GUESSIO_HAVE_REUSEPORT 1
+using ReusePort = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
+namespace {
+std::unique_ptr<boost::asio::ip::tcp::acceptor> makeAcceptor(boost::asio::io_context& io,
+    const boost::asio::ip::tcp::endpoint& endpoint, bool reusePort) {
+    auto acceptor = std::make_unique<boost::asio::ip::tcp::acceptor>(io);
+    acceptor->open(endpoint.protocol());
+    acceptor->set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+#ifdef GUESSIO_HAVE_REUSEPORT
+    if (reusePort) acceptor->set_option(ReusePort(true));
+#else
+    (void)reusePort;
+#endif
+    acceptor->bind(endpoint);
+    acceptor->listen();
+    return acceptor;
+}
+}
+
+Server::Server(ShardPool& shards, int port)
+    : m_shardPool(shards),
     m_roomManager(),
     m_botManager(nullptr) {
     m_roomManager.setServer(this);
+
+    boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::tcp::v4(), static_cast<unsigned short>(port));
+#ifdef GUESSIO_HAVE_REUSEPORT
+    m_perShardAcceptors = shards.size() > 1;
+#endif
+    for (std::size_t i = 0; i < shards.size(); ++i) {
+        m_shards.push_back(std::make_unique<Shard>(shards.io(i)));
+        if (i == 0 || m_perShardAcceptors)
+            m_shards[i]->acceptor = makeAcceptor(shards.io(i), endpoint, m_perShardAcceptors);
+    }
+    LOG_INFO("SERVER", "Listening on port ", port, " with ", shards.size(), " shard(s), ",
+        m_perShardAcceptors ? "SO_REUSEPORT acceptor per shard" : "single acceptor");
 }
 
 void Server::setBotManager(TwitchBotManager* botManager) {
@@ -31,51 +67,86 @@ bool Server::stopBot(const std::string& channel) {
     return false;
 }
 
-void Server::setCurrentRoom(const std::string& channel, const std::string& roomName) {
-    if (m_botManager) {
-        m_botManager->setCurrentRoom(channel, roomName);
+void Server::start() {
+    for (std::size_t i = 0; i < m_shards.size(); ++i) {
+        m_shards[i]->heartbeat.start(m_sessionOptions.heartbeatInterval, m_sessionOptions.heartbeatTick);
+        if (m_shards[i]->acceptor) doAccept(i);
     }
 }
-void Server::start() {
-    doAccept();
+
+std::size_t Server::nextTargetShard() {
+    std::size_t shard = m_nextShard;
+    m_nextShard = (m_nextShard + 1) % m_shards.size();
+    return shard;
 }
 
-void Server::doAccept() {
-    m_acceptor.async_accept(m_acceptSocket,
-        [this](boost::system::error_code ec) {
+void Server::doAccept(std::size_t shard) {
+    // A per-shard acceptor keeps its connections; shard 0's lone acceptor
+    // deals them out. Either way the socket is created on the target
+    // shard's io_context, inside its own strand, so a session's handlers
+    // never run concurrently even when a shard has several threads.
+    auto& acceptor = *m_shards[shard]->acceptor;
+    std::size_t target = m_perShardAcceptors ? shard : nextTargetShard();
+    acceptor.async_accept(boost::asio::make_strand(m_shardPool.io(target)),
+        [this, shard, target](boost::system::error_code ec, boost::asio::ip::tcp::socket socket) {
             if (!ec) {
-                auto session = std::make_shared<Session>(std::move(m_acceptSocket), *this);
+                auto session = std::make_shared<Session>(std::move(socket), *this, target);
                 addSession(session);
                 session->start();
             }
-            doAccept();
+            else if (ec == boost::asio::error::operation_aborted) {
+                return;
+            }
+            doAccept(shard);
         });
 }
 
 
 void Server::addSession(std::shared_ptr<Session> session) {
-    // TODO: lock + insert into sessions_
-    std::lock_guard<std::mutex> lock(m_sessionsMutex);
-    m_sessions.insert(session);
-    
+    auto& shard = *m_shards[session->shard()];
+    std::lock_guard<std::mutex> lock(shard.sessionsMutex);
+    shard.sessions.insert(session);
 }
 
 void Server::removeSession(std::shared_ptr<Session> session) {
-    std::lock_guard<std::mutex> lock(m_sessionsMutex);
-    if (m_sessions.find(session) != m_sessions.end()) {
-        m_sessions.erase(session);
+    m_roomManager.leaveAll(session);
+    auto& shard = *m_shards[session->shard()];
+    std::lock_guard<std::mutex> lock(shard.sessionsMutex);
+    shard.sessions.erase(session);
+}
+
+std::vector<std::size_t> Server::shardSessionCounts() {
+    std::vector<std::size_t> counts;
+    counts.reserve(m_shards.size());
+    for (auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard->sessionsMutex);
+        counts.push_back(shard->sessions.size());
     }
+    return counts;
 }
 
-void Server::broadcast(std::string msg) {
-    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+void Server::broadcast(std::string msg, MessageClass cls, std::string collapseKey) {
+    broadcast(makeMessage(std::move(msg), cls, std::move(collapseKey)));
+}
 
-    for (auto& s : m_sessions) {
-        s->send(msg);
+void Server::broadcast(const MessagePtr& msg) {
+    // send() only pushes onto each session's outbox, so the message is
+    // handed to every shard from here rather than posted per shard.
+    std::size_t recipients = 0;
+    for (auto& shard : m_shards) {
+        std::lock_guard<std::mutex> lock(shard->sessionsMutex);
+        recipients += shard->sessions.size();
+        for (auto& s : shard->sessions) {
+            s->send(msg);
+        }
     }
+
+    auto& metrics = Metrics::instance();
+    metrics.broadcasts.fetch_add(1, std::memory_order_relaxed);
+    metrics.broadcastRecipients.fetch_add(recipients, std::memory_order_relaxed);
 }
 
-void Server::onClientMessage(std::shared_ptr<Session> s, const std::string& msg) {
+void Server::onClientMessage(std::shared_ptr<Session> s, std::string_view msg) {
     if (!s) {
         // Message came from Twitch: inject directly into RoomManager
         m_roomManager.onMessage(nullptr, msg);
@@ -83,3 +154,7 @@ void Server::onClientMessage(std::shared_ptr<Session> s, const std::string& msg)
     }
     m_roomManager.onMessage(s, msg);
 }
+
+void Server::onClientBinary(std::shared_ptr<Session> s, std::string_view msg) {
+    m_roomManager.onBinaryMessage(s, msg);
+}
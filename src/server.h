@@ -3,39 +3,70 @@
 #include <memory>
 #include <unordered_set>
 #include <mutex>
+#include <string_view>
 #include "session.h"
 #include "roomManager.h"
+#include "outboundMessage.h"
+#include "sessionOptions.h"
+#include "heartbeat.h"
+#include "timerService.h"
+#include "shardPool.h"
 
 // Forward declarations to avoid circular dependency
 class TwitchBotManager; 
 
+// Accepts onto every shard of the pool. Where the platform balances
+// SO_REUSEPORT listeners (Linux) each shard runs its own acceptor; otherwise
+// shard 0 accepts and hands the sockets to the shards round-robin. Each
+// shard keeps its own session set, heartbeat wheel and timer wheel.
 class Server {
 
 public:
-	Server(boost::asio::io_context& io, int port);
+	Server(ShardPool& shards, int port);
 	void start();
 
 	
 	void addSession(std::shared_ptr<Session> session);
 	void removeSession(std::shared_ptr<Session> session);
-	void broadcast(std::string msg);
-	void onClientMessage(std::shared_ptr<Session> s, const std::string& msg);
+	void broadcast(std::string msg,
+		MessageClass cls = MessageClass::control,
+		std::string collapseKey = std::string());
+	void broadcast(const MessagePtr& msg);
+	// msg may point into the session's read buffer; only valid for the call
+	void onClientMessage(std::shared_ptr<Session> s, std::string_view msg);
+	void onClientBinary(std::shared_ptr<Session> s, std::string_view msg);
 	void setBotManager(TwitchBotManager* botManager);
 	bool spawnBot(const std::string& oauth,
 		const std::string& nick,
 		const std::string& channel);
 	bool stopBot(const std::string& channel);
-	void setCurrentRoom(const std::string& channel, const std::string& roomName); // Set current room for specific channel
 	RoomManager& getRoomManager() { return m_roomManager; }
+	void setSessionOptions(const SessionOptions& options) { m_sessionOptions = options; } // before start()
+	const SessionOptions& getSessionOptions() const { return m_sessionOptions; }
+	ShardPool& shards() { return m_shardPool; }
+	std::vector<std::size_t> shardSessionCounts();
+	HeartbeatService& heartbeat(std::size_t shard) { return m_shards[shard]->heartbeat; }
+	TimerService& timers(std::size_t shard) { return m_shards[shard]->timers; }
 private:
-	void doAccept();
+	struct Shard {
+		explicit Shard(boost::asio::io_context& io) : heartbeat(io), timers(io) {}
 
-	boost::asio::ip::tcp::acceptor m_acceptor;
-	boost::asio::ip::tcp::socket m_acceptSocket;
+		std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor; // null when fed by shard 0
+		std::unordered_set<std::shared_ptr<Session>> sessions;
+		std::mutex sessionsMutex;
+		HeartbeatService heartbeat;
+		TimerService timers;
+	};
 
-	std::unordered_set<std::shared_ptr<Session>> m_sessions;
-	std::mutex m_sessionsMutex;
+	void doAccept(std::size_t shard);
+	std::size_t nextTargetShard();
+
+	ShardPool& m_shardPool;
+	std::vector<std::unique_ptr<Shard>> m_shards;
+	bool m_perShardAcceptors = false;
+	std::size_t m_nextShard = 0; // round-robin target, shard 0's acceptor only
 
 	RoomManager m_roomManager;
 	TwitchBotManager* m_botManager;
+	SessionOptions m_sessionOptions;
 };
\ No newline at end of file
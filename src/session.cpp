@@ -1,124 +1,449 @@
 ﻿#include "session.h"
 #include "server.h"
-#include <iostream>
+#include <cstdlib>
+#include "logger.h"
 
-Session::Session(boost::asio::ip::tcp::socket socket, Server& server)
-    : m_ws(std::move(socket)),
-    m_pingTimer(m_ws.get_executor()),
-    m_server(server) {
+namespace {
+// Separators for the optional JSON array envelope.
+const char kEnvelopeOpen = '[';
+const char kEnvelopeComma = ',';
+const char kEnvelopeClose = ']';
+
+// What a message contributes to an envelope: the message itself, or the
+// elements of one that is already an array.
+std::string_view envelopePiece(const OutboundMessage& msg) {
+    std::string_view p = msg.payload();
+    if (p.size() >= 2 && p.front() == '[' && p.back() == ']') return p.substr(1, p.size() - 2);
+    return p;
+}
+
+std::atomic<std::uint64_t> g_nextSessionId{ 1 };
+
+const MessagePtr& pingMessage() {
+    static const MessagePtr ping = std::make_shared<const OutboundMessage>(
+        std::string(), MessageClass::control, std::string(), WsOpcode::ping);
+    return ping;
+}
+}
+
+Session::Session(boost::asio::ip::tcp::socket socket, Server& server, std::size_t shard)
+    : m_id(g_nextSessionId.fetch_add(1, std::memory_order_relaxed)),
+    m_shard(shard),
+    m_ws(std::move(socket)),
+    m_flushTimer(m_ws.get_executor()),
+    m_graceTimer(m_ws.get_executor()),
+    m_server(server),
+    m_options(server.getSessionOptions()) {
 }
 
 
 void Session::start() {
     auto self = shared_from_this();
-    m_ws.async_accept([this, self](boost::system::error_code ec) {
-        if (ec) {
-            std::cerr << "Handshake failed: " << ec.message() << "\n";
-            m_server.removeSession(self);
-            return;
-        }
-        std::cout << "Handshake complete!\n";
-        
-        // Set up pong handler before starting ping
-        m_ws.control_callback([this, self](boost::beast::websocket::frame_type kind, boost::string_view payload) {
-            if (kind == boost::beast::websocket::frame_type::pong) {
-                markPongReceived();
+    // Hop onto the strand before touching the stream; start() is called from
+    // the acceptor's completion handler.
+    boost::asio::dispatch(m_ws.get_executor(), [this, self]() {
+        if (m_options.deflateEnabled) enableDeflate();
+        m_ws.read_message_max(m_options.maxInboundMessage);
+
+        m_ws.async_accept([this, self](boost::system::error_code ec) {
+            if (ec) {
+                LOG_WARN("SESSION", LogFields().session(m_id), "Handshake failed: ", ec.message());
+                m_server.removeSession(self);
+                return;
             }
+            LOG_DEBUG("SESSION", LogFields().session(m_id), "Handshake complete");
+
+            // Set up pong handler before the first ping can go out
+            m_ws.control_callback([this, self](boost::beast::websocket::frame_type kind, boost::string_view payload) {
+                if (kind == boost::beast::websocket::frame_type::pong) {
+                    markPongReceived();
+                }
+            });
+
+            m_server.heartbeat(m_shard).add(self);
+            doRead();
         });
-        
-        startPing();
-        doRead();
     });
 }
 
+void Session::enableDeflate() {
+    namespace websocket = boost::beast::websocket;
+
+    websocket::permessage_deflate pmd;
+    pmd.server_enable = true;
+    pmd.server_max_window_bits = m_options.deflateWindowBits;
+    pmd.server_no_context_takeover = true; // compressed frames are shared across sessions
+    pmd.compLevel = m_options.deflateLevel;
+    pmd.memLevel = m_options.deflateMemLevel;
+    m_ws.set_option(pmd);
+
+    // Beast doesn't expose what it negotiated, but the decorator runs after
+    // the extension response is built, so read the agreed window from there.
+    m_ws.set_option(websocket::stream_base::decorator([this](websocket::response_type& res) {
+        auto it = res.find(boost::beast::http::field::sec_websocket_extensions);
+        if (it == res.end()) return;
+        for (const auto& ext : boost::beast::http::ext_list{ it->value() }) {
+            if (!boost::beast::iequals(ext.first, "permessage-deflate")) continue;
+            int bits = OutboundMessage::kMaxWindowBits;
+            for (const auto& param : ext.second) {
+                if (boost::beast::iequals(param.first, "server_max_window_bits"))
+                    bits = std::atoi(std::string(param.second).c_str());
+            }
+            m_deflateWindowBits = bits;
+        }
+    }));
+}
+
 void Session::doRead() {
     auto self = shared_from_this();
     m_ws.async_read(m_buffer, [this, self](boost::system::error_code ec, std::size_t bytes) {
         if (ec) {
-            std::cerr << "Read error: " << ec.message() << "\n";
+            LOG_DEBUG("SESSION", LogFields().session(m_id), "Read error: ", ec.message());
             m_server.removeSession(self);
             return;
         }
-        std::string msg(boost::asio::buffer_cast<const char*>(m_buffer.data()), bytes);
+        // flat_buffer is contiguous, so the frame can be handed down as a
+        // view and consumed only after dispatch has finished with it.
+        std::string_view msg(static_cast<const char*>(m_buffer.data().data()), bytes);
+        markPongReceived(); // any inbound frame proves the client is alive
+        if (m_ws.got_binary())
+            m_server.onClientBinary(self, msg);
+        else
+            handleMessage(msg);
         m_buffer.consume(bytes);
-        handleMessage(msg);
+        recycleReadBuffer();
         doRead();
         });
 }
 
-void Session::handleMessage(const std::string& msg) {
-    std::cout << "Handling message: " << msg << "\n";
-
+void Session::handleMessage(std::string_view msg) {
     m_server.onClientMessage(shared_from_this(), msg);
 }
 
-void Session::send(const std::string& msg) {
-    auto self = shared_from_this();
-    {
-        std::lock_guard<std::mutex> lock(m_writeMutex);
-        m_writeQueue.push_back(msg);
-        if (m_writing) return;
-        m_writing = true;
+// The buffer is reused across reads; only give memory back when one large
+// message left it far above what an idle session needs.
+void Session::recycleReadBuffer() {
+    if (m_buffer.size() == 0 && m_buffer.capacity() > m_options.readBufferIdleCap) {
+        m_buffer.shrink_to_fit();
+        Metrics::instance().readBufferShrinks.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Session::send(const std::string& msg, MessageClass cls, const std::string& collapseKey) {
+    send(makeMessage(msg, cls, collapseKey));
+}
+
+void Session::send(MessagePtr msg) {
+    m_outbox.push(std::move(msg));
+
+    // Only the producer that flips the flag schedules a drain; everyone else
+    // piggybacks on the drain that is already queued on the strand.
+    if (!m_drainScheduled.exchange(true, std::memory_order_acq_rel)) {
+        boost::asio::post(m_ws.get_executor(), [self = shared_from_this()]() {
+            self->drainOutbox();
+        });
+    }
+}
+
+void Session::drainOutbox() {
+    // Clear the flag before popping so a push racing with this drain either
+    // lands in the loop below or schedules the next drain itself.
+    m_drainScheduled.store(false, std::memory_order_seq_cst);
+
+    MessagePtr msg;
+    while (m_outbox.pop(msg)) {
+        if (!m_closed && !m_closing) enqueue(std::move(msg));
+    }
+    enforceQueueLimits();
+
+    if (m_closed || m_writing || m_writeQueue.empty()) return;
+
+    // Hold a partial batch back for the micro-flush window so a burst of
+    // draw points goes out in one write instead of one write per point.
+    bool batchFull = m_writeQueue.size() >= m_options.maxBatchMessages ||
+        m_queuedBytes >= m_options.maxBatchBytes;
+    if (m_options.flushWindow.count() > 0 && !batchFull) {
+        if (!m_flushArmed) {
+            m_flushArmed = true;
+            m_flushTimer.expires_after(m_options.flushWindow);
+            m_flushTimer.async_wait([this, self = shared_from_this()](boost::system::error_code ec) {
+                if (ec == boost::asio::error::operation_aborted) return;
+                m_flushArmed = false;
+                if (!m_writing && !m_writeQueue.empty()) doWrite();
+            });
+        }
+        return;
+    }
+
+    if (m_flushArmed) {
+        m_flushArmed = false;
+        m_flushTimer.cancel();
     }
     doWrite();
 }
 
-void Session::doWrite() {
-    auto self = shared_from_this();
-    std::string& msg = m_writeQueue.front();
+void Session::enqueue(MessagePtr msg) {
+    if ((m_options.slowConsumerPolicy & kCollapseState) &&
+        msg->messageClass() == MessageClass::state && !msg->collapseKey().empty()) {
+        // A newer snapshot supersedes any queued one with the same key.
+        for (auto it = m_writeQueue.begin(); it != m_writeQueue.end();) {
+            if ((*it)->messageClass() == MessageClass::state && (*it)->collapseKey() == msg->collapseKey()) {
+                m_queuedBytes -= (*it)->size();
+                it = m_writeQueue.erase(it);
+                Metrics::instance().statesCollapsed.fetch_add(1, std::memory_order_relaxed);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
 
-    m_ws.async_write(boost::asio::buffer(msg), [this, self](boost::system::error_code ec, std::size_t) {
-        std::lock_guard<std::mutex> lock(m_writeMutex);
-        if (ec) {
-            std::cerr << "Send error: " << ec.message() << "\n";
-            m_server.removeSession(self);
+    m_queuedBytes += msg->size();
+    m_writeQueue.push_back(std::move(msg));
+}
+
+bool Session::overQueueLimit() const {
+    return m_writeQueue.size() > m_options.maxQueueMessages || m_queuedBytes > m_options.maxQueueBytes;
+}
+
+void Session::enforceQueueLimits() {
+    if (!overQueueLimit()) {
+        clearOverLimit();
+        return;
+    }
+
+    auto& metrics = Metrics::instance();
+    if (!m_overLimit) {
+        m_overLimit = true;
+        metrics.queueOverLimit.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (m_options.slowConsumerPolicy & kDropOldestDraw) {
+        // Trim to 3/4 of the limits in one pass so a client that stays slow
+        // doesn't pay a queue scan for every new draw event.
+        const std::size_t targetMessages = m_options.maxQueueMessages / 4 * 3;
+        const std::size_t targetBytes = m_options.maxQueueBytes / 4 * 3;
+
+        std::deque<MessagePtr> kept;
+        std::size_t remaining = m_writeQueue.size();
+        std::uint64_t dropped = 0;
+        for (auto& queued : m_writeQueue) {
+            bool stillOver = remaining > targetMessages || m_queuedBytes > targetBytes;
+            if (stillOver && queued->messageClass() == MessageClass::draw) {
+                m_queuedBytes -= queued->size();
+                --remaining;
+                ++dropped;
+                continue;
+            }
+            kept.push_back(std::move(queued));
+        }
+        m_writeQueue.swap(kept);
+        metrics.drawsDropped.fetch_add(dropped, std::memory_order_relaxed);
+
+        if (!overQueueLimit()) {
+            clearOverLimit();
             return;
         }
+    }
+
+    if ((m_options.slowConsumerPolicy & kDisconnect) && !m_graceArmed) {
+        m_graceArmed = true;
+        m_graceTimer.expires_after(m_options.disconnectGrace);
+        m_graceTimer.async_wait([this, self = shared_from_this()](boost::system::error_code ec) {
+            if (ec == boost::asio::error::operation_aborted) return;
+            m_graceArmed = false;
+            if (m_closed || !overQueueLimit()) return;
+
+            LOG_WARN("SESSION", LogFields().session(m_id), "Slow consumer: ", m_writeQueue.size(),
+                " messages / ", m_queuedBytes, " bytes queued, disconnecting");
+            Metrics::instance().slowDisconnects.fetch_add(1, std::memory_order_relaxed);
+            abort();
+        });
+    }
+}
+
+void Session::clearOverLimit() {
+    m_overLimit = false;
+    if (m_graceArmed) {
+        m_graceArmed = false;
+        m_graceTimer.cancel();
+    }
+}
+
+// Hard close for clients that cannot keep up: no closing handshake, since
+// that would just queue behind everything the client isn't reading.
+void Session::abort() {
+    m_closed = true;
+    m_writeQueue.clear();
+    m_queuedBytes = 0;
+    m_flushTimer.cancel();
+    boost::system::error_code ec;
+    m_ws.next_layer().socket().close(ec);
+    m_server.removeSession(shared_from_this());
+}
+
+void Session::doWrite() {
+    auto self = shared_from_this();
+    m_writing = true;
+
+    // Gather everything up to the batch limits. The first message is always
+    // taken so an oversized payload still goes out on its own.
+    std::size_t batchBytes = 0;
+    while (!m_writeQueue.empty() && m_inFlight.size() < m_options.maxBatchMessages) {
+        const MessagePtr& next = m_writeQueue.front();
+        if (!m_inFlight.empty() && batchBytes + next->size() > m_options.maxBatchBytes) break;
+        batchBytes += next->size();
+        m_queuedBytes -= next->size();
+        m_inFlight.push_back(std::move(m_writeQueue.front()));
         m_writeQueue.pop_front();
-        if (!m_writeQueue.empty())
-            doWrite();
-        else
+    }
+
+    buildWriteBuffers();
+
+    auto& metrics = Metrics::instance();
+    metrics.socketWrites.fetch_add(1, std::memory_order_relaxed);
+    metrics.messagesWritten.fetch_add(m_inFlight.size(), std::memory_order_relaxed);
+
+    // Frames are written straight to the TCP socket; Beast handles the
+    // handshake, reads, pong replies and the closing handshake. FrameSocket
+    // queues its writes and ours behind each other so frames never
+    // interleave.
+    m_ws.next_layer().async_write_all(m_writeBuffers,
+        [this, self](boost::system::error_code ec, std::size_t bytes) {
+            m_inFlight.clear();
+            m_writeBuffers.clear();
+            m_envelopeHeaders.clear();
+
+            if (ec) {
+                LOG_DEBUG("SESSION", LogFields().session(m_id), "Send error: ", ec.message());
+                m_closed = true;
+                m_writeQueue.clear();
+                m_queuedBytes = 0;
+                m_server.removeSession(self);
+                return;
+            }
+            Metrics::instance().bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
+            if (m_overLimit && !overQueueLimit()) clearOverLimit();
+
+            if (!m_writeQueue.empty()) {
+                doWrite();
+                return;
+            }
             m_writing = false;
+            if (m_closing) doClose();
         });
 }
 
+void Session::buildWriteBuffers() {
+    // Compressed sessions skip the envelope: each message keeps its own shared
+    // compressed frame instead of being recompressed as part of an array.
+    const bool deflate = m_deflateWindowBits != 0;
+    const bool envelope = !deflate && m_batchEnvelope.load(std::memory_order_relaxed);
+
+    // Headers for envelope frames are computed per write, so reserve up front
+    // to keep the buffer sequence pointing at stable storage.
+    m_envelopeHeaders.reserve(m_inFlight.size());
+
+    std::size_t i = 0;
+    while (i < m_inFlight.size()) {
+        // A run of consecutive text messages can share one array frame.
+        std::size_t runEnd = i;
+        std::size_t runBytes = 0;
+        if (envelope) {
+            while (runEnd < m_inFlight.size() && m_inFlight[runEnd]->opcode() == WsOpcode::text) {
+                runBytes += m_inFlight[runEnd]->size();
+                ++runEnd;
+            }
+        }
+
+        if (runEnd - i > 1) {
+            // A payload that is itself an array (a canvas snapshot) is spliced
+            // in element by element so the client still sees one flat list.
+            std::size_t pieces = 0;
+            for (std::size_t k = i; k < runEnd; ++k) {
+                std::string_view piece = envelopePiece(*m_inFlight[k]);
+                runBytes -= m_inFlight[k]->size() - piece.size();
+                if (!piece.empty()) ++pieces;
+            }
+            m_envelopeHeaders.push_back(makeFrameHeader(WsOpcode::text, runBytes + (pieces ? pieces + 1 : 2)));
+            const FrameHeader& h = m_envelopeHeaders.back();
+            m_writeBuffers.emplace_back(h.data(), h.size);
+            m_writeBuffers.emplace_back(&kEnvelopeOpen, 1);
+            bool first = true;
+            for (std::size_t k = i; k < runEnd; ++k) {
+                std::string_view piece = envelopePiece(*m_inFlight[k]);
+                if (piece.empty()) continue;
+                if (!first) m_writeBuffers.emplace_back(&kEnvelopeComma, 1);
+                first = false;
+                m_writeBuffers.emplace_back(piece.data(), piece.size());
+            }
+            m_writeBuffers.emplace_back(&kEnvelopeClose, 1);
+            i = runEnd;
+            continue;
+        }
+
+        const OutboundMessage& msg = *m_inFlight[i];
+        ++i;
+
+        bool dataFrame = msg.opcode() == WsOpcode::text || msg.opcode() == WsOpcode::binary;
+        if (deflate && dataFrame && msg.size() >= m_options.deflateMinSize) {
+            const DeflatedFrame* frame = msg.deflated(m_deflateWindowBits, m_options.deflateLevel, m_options.deflateMemLevel);
+            if (frame) {
+                Metrics::instance().deflateFramesSent.fetch_add(1, std::memory_order_relaxed);
+                m_writeBuffers.emplace_back(frame->header.data(), frame->header.size);
+                m_writeBuffers.emplace_back(boost::asio::buffer(frame->payload));
+                continue;
+            }
+        }
+
+        m_writeBuffers.emplace_back(msg.header().data(), msg.header().size);
+        if (msg.size() > 0)
+            m_writeBuffers.emplace_back(boost::asio::buffer(msg.payload()));
+    }
+}
+
+void Session::setBatchEnvelope(bool enabled) {
+    m_batchEnvelope.store(enabled, std::memory_order_relaxed);
+}
+
 void Session::close() {
     auto self = shared_from_this();
+    boost::asio::dispatch(m_ws.get_executor(), [this, self]() {
+        if (m_closed || m_closing) return;
+        // Let queued frames finish first; Beast's close frame must not land
+        // in the middle of one of our writes.
+        m_closing = true;
+        if (!m_writing) doClose();
+    });
+}
+
+void Session::doClose() {
+    auto self = shared_from_this();
+    m_closed = true;
+    m_flushTimer.cancel();
+    m_graceTimer.cancel();
     m_ws.async_close(boost::beast::websocket::close_code::normal, [this, self](boost::system::error_code ec) {
         if (ec)
-            std::cerr << "Close error: " << ec.message() << "\n";
+            LOG_DEBUG("SESSION", LogFields().session(m_id), "Close error: ", ec.message());
         m_server.removeSession(self);
         });
 }
 
-void Session::startPing() {
-    auto self = shared_from_this();
-    m_pingTimer.expires_after(std::chrono::seconds(30));
-    m_pingTimer.async_wait([this, self](boost::system::error_code ec) {
-        if (!ec) {
-            if (!m_pongReceived) {
-                std::cerr << "[WARN] Heartbeat timeout\n";
-                close();
-                return;
-            }
-            m_pongReceived = false;
-
-            // Send ping only if connection is still open
-            if (m_ws.is_open()) {
-                m_ws.async_ping({}, [this, self](boost::system::error_code ec) {
-                    if (ec) {
-                        std::cerr << "Ping error: " << ec.message() << "\n";
-                        close();
-                        return;
-                    }
-                    startPing(); // schedule next ping
-                });
-            }
-        }
-        });
+bool Session::heartbeat() {
+    if (!m_pongReceived.exchange(false, std::memory_order_relaxed)) {
+        LOG_WARN("SESSION", LogFields().session(m_id), "Heartbeat timeout");
+        Metrics::instance().heartbeatTimeouts.fetch_add(1, std::memory_order_relaxed);
+        close(); // no-op if the session is already closing
+        return false;
+    }
+    // Ping goes through the normal write path so it is ordered with (and
+    // can be coalesced into) outgoing data frames. A closed session drops
+    // it and falls out of the wheel on the next interval.
+    send(pingMessage());
+    return true;
 }
 
 
 void Session::markPongReceived() {
-    m_pongReceived = true;
+    m_pongReceived.store(true, std::memory_order_relaxed);
 }
\ No newline at end of file
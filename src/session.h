@@ -2,41 +2,102 @@
 #include <boost/asio.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
+#include <atomic>
 #include <deque>
-#include <mutex>
 #include <string>
+#include <string_view>
 #include <memory>
+#include <vector>
 #include "session.h"
 #include "server.h"
-#include <iostream>
+#include "frameSocket.h"
+#include "outboundMessage.h"
+#include "mpscQueue.h"
+#include "sessionOptions.h"
 
 class Server; // forward declaration
 
+// All websocket state is owned by the session's strand (the executor of the
+// socket handed in by Server::doAccept), on the shard it was accepted onto. send(), close() and
+// markPongReceived() are safe to call from any thread; they only touch
+// atomics and the outbox and never block.
 class Session : public std::enable_shared_from_this<Session> {
 public:
-    Session(boost::asio::ip::tcp::socket socket, Server& server);
+    // socket must already belong to a strand on io context `shard`.
+    Session(boost::asio::ip::tcp::socket socket, Server& server, std::size_t shard);
 
     void start();
-    void send(const std::string& msg);
+    std::uint64_t id() const { return m_id; } // process-unique, for logging
+    std::size_t shard() const { return m_shard; }
+    void send(const std::string& msg,
+        MessageClass cls = MessageClass::control,
+        const std::string& collapseKey = std::string());
+    void send(MessagePtr msg); // shared buffer, no per-session copy
     void close();
-    void startPing();
     void markPongReceived();
+    // Called by HeartbeatService once per interval from its own strand.
+    // Closes the session if nothing was heard since the last call, otherwise
+    // queues a ping; returns false once the session should leave the wheel.
+    bool heartbeat();
+    // Wrap runs of queued JSON messages in one array frame ("hello" opt-in).
+    void setBatchEnvelope(bool enabled);
+    // Whether the client said it reads array frames, deflated or not.
+    bool acceptsBatches() const { return m_batchEnvelope.load(std::memory_order_relaxed); }
+    // Receive draw/clear/undo as StrokeCodec binary frames ("hello" opt-in).
+    void setBinaryStrokes(bool enabled) { m_binaryStrokes.store(enabled, std::memory_order_relaxed); }
+    bool wantsBinaryStrokes() const { return m_binaryStrokes.load(std::memory_order_relaxed); }
+    // Receive a PNG checkpoint plus newer strokes on join ("hello" opt-in).
+    void setCheckpoints(bool enabled) { m_checkpoints.store(enabled, std::memory_order_relaxed); }
+    bool wantsCheckpoints() const { return m_checkpoints.load(std::memory_order_relaxed); }
 
 private:
+    void enableDeflate();
     void doRead();
+    void drainOutbox();
+    void enqueue(MessagePtr msg);
+    bool overQueueLimit() const;
+    void enforceQueueLimits();
+    void clearOverLimit();
     void doWrite();
-    void handleMessage(const std::string& msg);
+    void buildWriteBuffers();
+    void doClose();
+    void abort();
+    void handleMessage(std::string_view msg);
+    void recycleReadBuffer();
 
-
-    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> m_ws;
+    const std::uint64_t m_id;
+    const std::size_t m_shard;
+    boost::beast::websocket::stream<FrameSocket> m_ws;
     boost::beast::flat_buffer m_buffer;
 
-    std::deque<std::string> m_writeQueue;
-    bool m_writing = false;
-    std::mutex m_writeMutex;
+    MpscQueue<MessagePtr> m_outbox;            // producers: any thread
+    std::atomic<bool> m_drainScheduled{ false };
+
+    std::deque<MessagePtr> m_writeQueue;       // strand only
+    std::size_t m_queuedBytes = 0;             // strand only
+    bool m_writing = false;                    // strand only
+    bool m_closing = false;                    // strand only
+    bool m_closed = false;                     // strand only
+
+    // Batch currently being written; kept alive until the write completes.
+    std::vector<MessagePtr> m_inFlight;
+    std::vector<boost::asio::const_buffer> m_writeBuffers;
+    std::vector<FrameHeader> m_envelopeHeaders;
+    std::atomic<bool> m_batchEnvelope{ false };
+    std::atomic<bool> m_binaryStrokes{ false };
+    std::atomic<bool> m_checkpoints{ false };
+    int m_deflateWindowBits = 0;               // negotiated server window, 0 = off
+
+    boost::asio::steady_timer m_flushTimer;
+    bool m_flushArmed = false;                 // strand only
+
+    // Slow-consumer state, see SessionOptions::slowConsumerPolicy.
+    boost::asio::steady_timer m_graceTimer;
+    bool m_graceArmed = false;                 // strand only
+    bool m_overLimit = false;                  // strand only
 
-    boost::asio::steady_timer m_pingTimer;
-    bool m_pongReceived = true;
+    std::atomic<bool> m_pongReceived{ true };
 
     Server& m_server;
+    const SessionOptions& m_options;
 };
\ No newline at end of file
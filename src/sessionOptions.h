@@ -0,0 +1,51 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Slow-consumer policies; combine with |. Control messages are never
+// dropped whatever is selected, so disconnect is the only hard backstop.
+enum SlowConsumerPolicy : std::uint32_t {
+    kDropOldestDraw = 1u << 0, // drop queued draw events, oldest first
+    kCollapseState = 1u << 1,  // keep only the newest state message per key
+    kDisconnect = 1u << 2      // close if still over the limit after the grace period
+};
+
+// Tunables shared by every Session of a Server. Loaded from config.json in
+// main.cpp; the defaults below are used for any key that is missing.
+struct SessionOptions {
+    // Write coalescing: one socket write carries at most this much.
+    std::size_t maxBatchBytes = 64 * 1024;
+    std::size_t maxBatchMessages = 256;
+
+    // How long a partially filled batch may wait for more messages before
+    // it is flushed. Zero flushes as soon as the socket is idle.
+    std::chrono::milliseconds flushWindow{ 0 };
+
+    // Per-session write queue limits (messages not yet handed to the socket).
+    std::size_t maxQueueBytes = 4 * 1024 * 1024;
+    std::size_t maxQueueMessages = 8192;
+    std::uint32_t slowConsumerPolicy = kDropOldestDraw | kCollapseState | kDisconnect;
+    std::chrono::milliseconds disconnectGrace{ 5000 };
+
+    // permessage-deflate. Always negotiated with server_no_context_takeover
+    // so a broadcast is compressed once and shared by every session that
+    // ended up with the same window size.
+    bool deflateEnabled = false;
+    int deflateWindowBits = 15;
+    int deflateLevel = 6;
+    int deflateMemLevel = 8;
+    std::size_t deflateMinSize = 128; // smaller payloads go out uncompressed
+
+    // Inbound frames larger than this fail the read and close the session.
+    std::size_t maxInboundMessage = 1024 * 1024;
+    // A read buffer grown past this by one big message is released once it
+    // has been consumed; smaller buffers are kept and reused across reads.
+    std::size_t readBufferIdleCap = 16 * 1024;
+
+    // Heartbeat: a session that sends nothing (pong or otherwise) for a whole
+    // interval is closed. The wheel advances once per tick, so pings for the
+    // connections that arrived within one tick go out together.
+    std::chrono::milliseconds heartbeatInterval{ 30000 };
+    std::chrono::milliseconds heartbeatTick{ 1000 };
+};
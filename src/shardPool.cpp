@@ -0,0 +1,84 @@
+#include "shardPool.h"
+#include "logger.h"
+#include <algorithm>
+#include <functional>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+thread_local std::size_t t_currentShard = ShardPool::kNoShard;
+
+bool pinCurrentThread(unsigned cpu) {
+#ifdef _WIN32
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (cpu % (sizeof(DWORD_PTR) * 8))) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+}
+
+ShardPool::ShardPool(std::size_t shards, std::size_t threadsPerShard)
+    : m_threadsPerShard(std::max<std::size_t>(1, threadsPerShard)) {
+    shards = std::max<std::size_t>(1, shards);
+    // A concurrency hint of 1 lets asio skip some scheduler locking.
+    int hint = static_cast<int>(m_threadsPerShard);
+    for (std::size_t i = 0; i < shards; ++i) {
+        m_shards.push_back(std::make_unique<boost::asio::io_context>(hint));
+        m_work.push_back(boost::asio::make_work_guard(*m_shards.back()));
+    }
+}
+
+ShardPool::~ShardPool() {
+    stop();
+    join();
+}
+
+void ShardPool::start(bool pinThreads) {
+    unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+    for (std::size_t shard = 0; shard < m_shards.size(); ++shard) {
+        for (std::size_t t = 0; t < m_threadsPerShard; ++t) {
+            m_threads.emplace_back([this, shard, pinThreads, cpus]() {
+                t_currentShard = shard;
+                if (pinThreads && !pinCurrentThread(static_cast<unsigned>(shard % cpus)))
+                    LOG_WARN("SHARD", "Could not pin shard ", shard, " to a CPU");
+                m_shards[shard]->run();
+            });
+        }
+    }
+    LOG_INFO("SHARD", "Started ", m_shards.size(), " shard(s) x ", m_threadsPerShard,
+        " thread(s)", pinThreads ? ", pinned" : "");
+}
+
+void ShardPool::stop() {
+    m_work.clear();
+    for (auto& io : m_shards) io->stop();
+}
+
+void ShardPool::join() {
+    for (auto& t : m_threads) {
+        if (t.joinable()) t.join();
+    }
+    m_threads.clear();
+}
+
+std::size_t ShardPool::currentShard() {
+    return t_currentShard;
+}
+
+std::size_t ShardPool::homeShard(std::string_view key) const {
+    return std::hash<std::string_view>()(key) % m_shards.size();
+}
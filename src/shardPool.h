@@ -0,0 +1,66 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// The server's threads and io_contexts. Each shard is one io_context run by
+// its own thread(s); a Session is accepted onto one shard and every handler
+// for it runs there for the life of the connection.
+//
+//   ShardPool(n, 1)  sharded: one io_context and one thread per core, no
+//                    scheduler shared between cores.
+//   ShardPool(1, n)  legacy: one io_context run by n threads.
+//
+// Cross-shard work: state owned by a shard (its sessions, timers, wheels)
+// must only be touched from that shard. Anything else hands the work over
+// with post(shard, fn), which queues fn on the target io_context and never
+// runs it inline; dispatch(shard, fn) runs it inline when already on that
+// shard. Work keyed by something other than a session, e.g. a room, should
+// run on homeShard(key) so it stays on one core whatever thread reports it.
+class ShardPool {
+public:
+    static constexpr std::size_t kNoShard = static_cast<std::size_t>(-1);
+
+    explicit ShardPool(std::size_t shards, std::size_t threadsPerShard = 1);
+    ~ShardPool();
+
+    ShardPool(const ShardPool&) = delete;
+    ShardPool& operator=(const ShardPool&) = delete;
+
+    std::size_t size() const { return m_shards.size(); }
+    std::size_t threadsPerShard() const { return m_threadsPerShard; }
+    boost::asio::io_context& io(std::size_t shard) { return *m_shards[shard]; }
+
+    // Starts the threads. With pinThreads, shard i's threads are bound to
+    // CPU i % hardware_concurrency (Linux and Windows; ignored elsewhere).
+    void start(bool pinThreads = false);
+    void stop();
+    void join();
+
+    // Shard of the calling thread, or kNoShard for threads outside any pool.
+    static std::size_t currentShard();
+    std::size_t homeShard(std::string_view key) const;
+
+    template <typename F>
+    void post(std::size_t shard, F&& fn) {
+        boost::asio::post(io(shard), std::forward<F>(fn));
+    }
+
+    template <typename F>
+    void dispatch(std::size_t shard, F&& fn) {
+        boost::asio::dispatch(io(shard), std::forward<F>(fn));
+    }
+
+private:
+    using WorkGuard = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+
+    std::vector<std::unique_ptr<boost::asio::io_context>> m_shards;
+    std::vector<WorkGuard> m_work;
+    std::vector<std::thread> m_threads;
+    std::size_t m_threadsPerShard;
+};
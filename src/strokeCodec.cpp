@@ -0,0 +1,213 @@
+#include "strokeCodec.h"
+#include <array>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+const std::array<std::uint32_t, 16> kPalette = {
+    0x000000, 0xFFFFFF, 0xFF0000, 0x00A000, 0x0000FF, 0xFFFF00, 0xFF8000, 0x800080,
+    0xFF69B4, 0x8B4513, 0x808080, 0xC0C0C0, 0x00FFFF, 0xFF00FF, 0x006400, 0x000080
+};
+
+const std::array<std::uint32_t, 14> kWidths = { 1, 2, 3, 4, 6, 8, 12, 16, 20, 24, 32, 40, 48, 64 };
+
+// Bounds-checked reader over the message bytes.
+struct Reader {
+    const std::uint8_t* p;
+    const std::uint8_t* end;
+
+    explicit Reader(std::string_view s)
+        : p(reinterpret_cast<const std::uint8_t*>(s.data())), end(p + s.size()) {
+    }
+
+    bool u8(std::uint8_t& v) {
+        if (p == end) return false;
+        v = *p++;
+        return true;
+    }
+
+    bool varint(std::uint32_t& v) {
+        v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (p == end) return false;
+            std::uint8_t b = *p++;
+            v |= static_cast<std::uint32_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    bool zigzag(std::int32_t& v) {
+        std::uint32_t u;
+        if (!varint(u)) return false;
+        v = static_cast<std::int32_t>((u >> 1) ^ (~(u & 1) + 1));
+        return true;
+    }
+};
+
+void putVarint(std::string& out, std::uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+void putZigzag(std::string& out, std::int32_t v) {
+    putVarint(out, (static_cast<std::uint32_t>(v) << 1) ^ static_cast<std::uint32_t>(v >> 31));
+}
+
+bool readColor(Reader& r, std::uint32_t& rgb) {
+    std::uint8_t idx;
+    if (!r.u8(idx)) return false;
+    if (idx != StrokeCodec::kLiteral) {
+        if (idx >= kPalette.size()) return false;
+        rgb = kPalette[idx];
+        return true;
+    }
+    std::uint8_t c[3];
+    if (!r.u8(c[0]) || !r.u8(c[1]) || !r.u8(c[2])) return false;
+    rgb = (std::uint32_t(c[0]) << 16) | (std::uint32_t(c[1]) << 8) | c[2];
+    return true;
+}
+
+bool readWidth(Reader& r, std::uint32_t& width) {
+    std::uint8_t idx;
+    if (!r.u8(idx)) return false;
+    if (idx != StrokeCodec::kLiteral) {
+        if (idx >= kWidths.size()) return false;
+        width = kWidths[idx];
+        return true;
+    }
+    return r.varint(width) && width > 0;
+}
+
+// Walks the draw body; calls onPoint with absolute coordinates.
+template <typename OnPoint>
+bool walkDraw(std::string_view body, std::uint32_t& rgb, std::uint32_t& width, OnPoint&& onPoint) {
+    Reader r(body);
+    std::uint32_t count;
+    if (!readColor(r, rgb) || !readWidth(r, width) || !r.varint(count)) return false;
+    if (count == 0 || count > StrokeCodec::kMaxPoints) return false;
+
+    // Summed wide so hostile deltas cannot overflow before the range check.
+    std::int64_t x = 0, y = 0;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        std::int32_t dx, dy;
+        if (!r.zigzag(dx) || !r.zigzag(dy)) return false;
+        x += dx;
+        y += dy;
+        if (x < -StrokeCodec::kMaxCoord || x > StrokeCodec::kMaxCoord ||
+            y < -StrokeCodec::kMaxCoord || y > StrokeCodec::kMaxCoord) return false;
+        onPoint(static_cast<std::int32_t>(x), static_cast<std::int32_t>(y));
+    }
+    return r.p == r.end;
+}
+
+// Draw message from any indexable point source (getPoint(i) -> Point).
+template <typename GetPoint>
+void appendDrawMessage(std::string& out, std::string_view room, std::uint32_t rgb, std::uint32_t width,
+    std::size_t count, GetPoint&& getPoint) {
+    out.push_back(static_cast<char>(StrokeCodec::Op::draw));
+    out.push_back(static_cast<char>(room.size()));
+    out.append(room.data(), room.size());
+
+    std::uint8_t colorIdx = StrokeCodec::kLiteral;
+    for (std::size_t i = 0; i < kPalette.size(); ++i) {
+        if (kPalette[i] == rgb) colorIdx = static_cast<std::uint8_t>(i);
+    }
+    out.push_back(static_cast<char>(colorIdx));
+    if (colorIdx == StrokeCodec::kLiteral) {
+        out.push_back(static_cast<char>((rgb >> 16) & 0xFF));
+        out.push_back(static_cast<char>((rgb >> 8) & 0xFF));
+        out.push_back(static_cast<char>(rgb & 0xFF));
+    }
+
+    std::uint8_t widthIdx = StrokeCodec::kLiteral;
+    for (std::size_t i = 0; i < kWidths.size(); ++i) {
+        if (kWidths[i] == width) widthIdx = static_cast<std::uint8_t>(i);
+    }
+    out.push_back(static_cast<char>(widthIdx));
+    if (widthIdx == StrokeCodec::kLiteral) putVarint(out, width);
+
+    putVarint(out, static_cast<std::uint32_t>(count));
+    std::int32_t px = 0, py = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        StrokeCodec::Point p = getPoint(i);
+        putZigzag(out, p.x - px);
+        putZigzag(out, p.y - py);
+        px = p.x;
+        py = p.y;
+    }
+}
+
+}
+
+bool StrokeCodec::parseHeader(std::string_view msg, Header& out) {
+    Reader r(msg);
+    std::uint8_t op, roomLen;
+    if (!r.u8(op) || !r.u8(roomLen)) return false;
+    if (op < 1 || op > 3 || roomLen == 0) return false;
+    if (static_cast<std::size_t>(r.end - r.p) < roomLen) return false;
+
+    out.op = static_cast<Op>(op);
+    out.room = msg.substr(2, roomLen);
+    out.body = msg.substr(2 + roomLen);
+    if (out.op != Op::draw && !out.body.empty()) return false;
+    return true;
+}
+
+bool StrokeCodec::validateDraw(std::string_view body) {
+    std::uint32_t rgb, width;
+    return walkDraw(body, rgb, width, [](std::int32_t, std::int32_t) {});
+}
+
+bool StrokeCodec::decodeDraw(std::string_view body, Stroke& out) {
+    out.points.clear();
+    return walkDraw(body, out.rgb, out.width, [&](std::int32_t x, std::int32_t y) {
+        out.points.push_back({ x, y });
+    });
+}
+
+void StrokeCodec::appendDraw(std::string& out, std::string_view room, std::uint32_t rgb, std::uint32_t width,
+    const float* xs, const float* ys, std::size_t count) {
+    appendDrawMessage(out, room, rgb, width, count, [&](std::size_t i) {
+        return Point{ static_cast<std::int32_t>(std::lround(xs[i] * kCoordScale)),
+            static_cast<std::int32_t>(std::lround(ys[i] * kCoordScale)) };
+    });
+}
+
+std::string StrokeCodec::colorToHex(std::uint32_t rgb) {
+    char buf[8];
+    std::snprintf(buf, sizeof(buf), "#%06x", rgb & 0xFFFFFF);
+    return buf;
+}
+
+nlohmann::json StrokeCodec::toJson(const Header& header) {
+    std::string room(header.room);
+    switch (header.op) {
+    case Op::clear:
+        return { {"type", "clear"}, {"room", room} };
+    case Op::undo:
+        return { {"type", "undo"}, {"room", room} };
+    case Op::draw:
+        break;
+    }
+
+    std::uint32_t rgb = 0, width = 1;
+    nlohmann::json points = nlohmann::json::array();
+    walkDraw(header.body, rgb, width, [&](std::int32_t x, std::int32_t y) {
+        points.push_back({ double(x) / kCoordScale, double(y) / kCoordScale });
+    });
+
+    return {
+        {"type", "draw"},
+        {"room", room},
+        {"payload", {
+            {"color", colorToHex(rgb)},
+            {"width", width},
+            {"points", std::move(points)}
+        }}
+    };
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Compact binary WebSocket format for draw / clear / undo, opted into per
+// session with {"type":"hello","payload":{"binary":true}}.
+//
+//   u8      op           1 = draw, 2 = clear, 3 = undo
+//   u8      roomLen      followed by roomLen bytes of room id (no '#'),
+//                        so room ids are at most kMaxRoom bytes
+//   draw only:
+//   u8      color        palette index, or 0xFF followed by 3 bytes R G B
+//   u8      width        width table index, or 0xFF followed by a varint (px)
+//   varint  pointCount   1..kMaxPoints
+//   zigzag  x0, y0       first point, in 1/kCoordScale px
+//   zigzag  dx, dy       (pointCount - 1) deltas from the previous point;
+//                        every point stays within +-kMaxCoord
+//
+// Varints are LEB128; zigzag maps signed deltas onto them. The server only
+// validates and relays these bytes; JSON is produced for legacy clients as
+//   {"type":"draw","room":r,"payload":{"color":"#rrggbb","width":w,"points":[[x,y],...]}}
+class StrokeCodec {
+public:
+    enum class Op : std::uint8_t { draw = 1, clear = 2, undo = 3 };
+
+    static constexpr int kCoordScale = 4;
+    static constexpr std::size_t kMaxPoints = 4096;
+    static constexpr std::uint8_t kLiteral = 0xFF;
+    static constexpr std::size_t kMaxRoom = 255;
+    static constexpr std::int32_t kMaxCoord = 10'000'000 * kCoordScale; // 1e7 px either way
+
+    struct Header {
+        Op op;
+        std::string_view room;
+        std::string_view body; // draw fields, empty for clear/undo
+    };
+
+    struct Point {
+        std::int32_t x; // 1/kCoordScale px
+        std::int32_t y;
+    };
+
+    struct Stroke {
+        std::uint32_t rgb = 0;
+        std::uint32_t width = 1;
+        std::vector<Point> points;
+    };
+
+    // Structural checks only; neither call allocates.
+    static bool parseHeader(std::string_view msg, Header& out);
+    static bool validateDraw(std::string_view body);
+
+    static bool decodeDraw(std::string_view body, Stroke& out);
+    // Appends a draw message for points given in px as separate x / y arrays.
+    static void appendDraw(std::string& out, std::string_view room, std::uint32_t rgb, std::uint32_t width,
+        const float* xs, const float* ys, std::size_t count);
+
+    // Legacy JSON message for a binary message that passed parseHeader.
+    static nlohmann::json toJson(const Header& header);
+
+    static std::string colorToHex(std::uint32_t rgb);
+};
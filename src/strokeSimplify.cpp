@@ -0,0 +1,170 @@
+#include "strokeSimplify.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GUESSIO_SIMPLIFY_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+SimplifyOptions g_defaults;  // written once by main before any io thread starts
+bool g_simdEnabled = true;
+
+struct Farthest {
+    float d2 = -1.0f;
+    std::size_t index = 0;
+};
+
+// Squared distance of each point in (first, last) to the segment
+// first..last, clamped to its ends so hooks past an endpoint are kept.
+// Returns the largest and the first index holding it. The SSE2 loop keeps
+// a per-lane first maximum and the reduction breaks ties by lowest index,
+// which is what the scalar loop finds, so both paths agree exactly.
+Farthest farthestPoint(const float* xs, const float* ys, std::size_t first, std::size_t last) {
+    const float ax = xs[first];
+    const float ay = ys[first];
+    const float ex = xs[last] - ax;
+    const float ey = ys[last] - ay;
+    const float len2 = ex * ex + ey * ey;
+    const float inv = len2 > 0.0f ? 1.0f / len2 : 0.0f;
+
+    Farthest best;
+    std::size_t i = first + 1;
+
+#ifdef GUESSIO_SIMPLIFY_SSE2
+    if (g_simdEnabled && last - i >= 4) {
+        const __m128 vax = _mm_set1_ps(ax);
+        const __m128 vay = _mm_set1_ps(ay);
+        const __m128 vex = _mm_set1_ps(ex);
+        const __m128 vey = _mm_set1_ps(ey);
+        const __m128 vinv = _mm_set1_ps(inv);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        __m128 bestD2 = _mm_set1_ps(-1.0f);
+        __m128i bestIdx = _mm_setzero_si128();
+        __m128i idx = _mm_setr_epi32(0, 1, 2, 3);
+        const __m128i four = _mm_set1_epi32(4);
+        const std::size_t base = i;
+        for (; i + 4 <= last; i += 4) {
+            __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + i), vax);
+            __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + i), vay);
+            __m128 t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(dx, vex), _mm_mul_ps(dy, vey)), vinv);
+            t = _mm_min_ps(_mm_max_ps(t, zero), one);
+            __m128 qx = _mm_sub_ps(dx, _mm_mul_ps(t, vex));
+            __m128 qy = _mm_sub_ps(dy, _mm_mul_ps(t, vey));
+            __m128 d2 = _mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy));
+            __m128 better = _mm_cmpgt_ps(d2, bestD2);
+            bestD2 = _mm_or_ps(_mm_and_ps(better, d2), _mm_andnot_ps(better, bestD2));
+            __m128i b = _mm_castps_si128(better);
+            bestIdx = _mm_or_si128(_mm_and_si128(b, idx), _mm_andnot_si128(b, bestIdx));
+            idx = _mm_add_epi32(idx, four);
+        }
+        alignas(16) float laneD2[4];
+        alignas(16) std::int32_t laneIdx[4];
+        _mm_store_ps(laneD2, bestD2);
+        _mm_store_si128(reinterpret_cast<__m128i*>(laneIdx), bestIdx);
+        for (int lane = 0; lane < 4; ++lane) {
+            if (laneD2[lane] < 0.0f) continue;
+            std::size_t index = base + static_cast<std::size_t>(laneIdx[lane]);
+            if (laneD2[lane] > best.d2 || (laneD2[lane] == best.d2 && index < best.index)) {
+                best.d2 = laneD2[lane];
+                best.index = index;
+            }
+        }
+    }
+#endif
+
+    for (; i < last; ++i) {
+        float dx = xs[i] - ax;
+        float dy = ys[i] - ay;
+        float t = (dx * ex + dy * ey) * inv;
+        t = t > 0.0f ? t : 0.0f;
+        t = t < 1.0f ? t : 1.0f;
+        float qx = dx - t * ex;
+        float qy = dy - t * ey;
+        float d2 = qx * qx + qy * qy;
+        if (d2 > best.d2) {
+            best.d2 = d2;
+            best.index = i;
+        }
+    }
+    return best;
+}
+
+std::size_t dropClosePoints(float* xs, float* ys, std::size_t count, float minDistance) {
+    const float min2 = minDistance * minDistance;
+    std::size_t kept = 1;
+    for (std::size_t i = 1; i + 1 < count; ++i) {
+        float dx = xs[i] - xs[kept - 1];
+        float dy = ys[i] - ys[kept - 1];
+        if (dx * dx + dy * dy < min2) continue;
+        xs[kept] = xs[i];
+        ys[kept] = ys[i];
+        ++kept;
+    }
+    // The last point always stays; it replaces a kept point that sits on top of it.
+    if (kept > 1) {
+        float dx = xs[count - 1] - xs[kept - 1];
+        float dy = ys[count - 1] - ys[kept - 1];
+        if (dx * dx + dy * dy < min2) --kept;
+    }
+    xs[kept] = xs[count - 1];
+    ys[kept] = ys[count - 1];
+    return kept + 1;
+}
+
+std::size_t douglasPeucker(float* xs, float* ys, std::size_t count, float tolerance) {
+    thread_local std::vector<std::uint8_t> keep;
+    thread_local std::vector<std::pair<std::size_t, std::size_t>> stack;
+    keep.assign(count, 0);
+    keep[0] = keep[count - 1] = 1;
+    stack.clear();
+    stack.emplace_back(0, count - 1);
+
+    const float tol2 = tolerance * tolerance;
+    while (!stack.empty()) {
+        auto [first, last] = stack.back();
+        stack.pop_back();
+        if (last - first < 2) continue;
+        Farthest f = farthestPoint(xs, ys, first, last);
+        if (f.d2 <= tol2) continue;
+        keep[f.index] = 1;
+        stack.emplace_back(f.index, last);
+        stack.emplace_back(first, f.index);
+    }
+
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!keep[i]) continue;
+        xs[kept] = xs[i];
+        ys[kept] = ys[i];
+        ++kept;
+    }
+    return kept;
+}
+}
+
+namespace StrokeSimplify {
+
+std::size_t simplify(float* xs, float* ys, std::size_t count, const SimplifyOptions& options) {
+    if (count < 3) return count;
+    if (options.minDistance > 0.0f) count = dropClosePoints(xs, ys, count, options.minDistance);
+    if (options.tolerance > 0.0f && count >= 3) count = douglasPeucker(xs, ys, count, options.tolerance);
+    return count;
+}
+
+void setDefaults(const SimplifyOptions& options) {
+    g_defaults = options;
+}
+
+SimplifyOptions defaults() {
+    return g_defaults;
+}
+
+void setSimdEnabled(bool enabled) {
+    g_simdEnabled = enabled;
+}
+
+}
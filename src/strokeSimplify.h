@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+
+// Server-side stroke simplification: drops pointer samples that do not
+// change what is drawn. Applied per room to the stored stroke before it is
+// fanned out, so history and live clients see the same points.
+//
+//   minDistance  a point closer than this (px) to the last kept point is
+//                dropped (sub-pixel jitter, repeated samples)
+//   tolerance    Ramer-Douglas-Peucker: points within this distance (px)
+//                of the simplified polyline are dropped
+//
+// Both are off at 0. The first and last points are always kept.
+struct SimplifyOptions {
+    float tolerance = 0.0f;
+    float minDistance = 0.0f;
+
+    bool enabled() const { return tolerance > 0.0f || minDistance > 0.0f; }
+};
+
+namespace StrokeSimplify {
+
+// Simplifies the points in place and returns how many remain, compacted
+// to the front of both arrays. Deterministic: the SSE2 distance scan and
+// the scalar fallback pick the same points.
+std::size_t simplify(float* xs, float* ys, std::size_t count, const SimplifyOptions& options);
+
+// Process-wide default for new rooms (DRAW_SIMPLIFY_* in config.json).
+void setDefaults(const SimplifyOptions& options);
+SimplifyOptions defaults();
+
+// Forces the scalar fallback, for comparing against the SIMD path.
+void setSimdEnabled(bool enabled);
+
+}
@@ -0,0 +1,254 @@
+#include "strokeStore.h"
+#include "strokeCodec.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+namespace {
+
+bool parseHexColor(const std::string& s, std::uint32_t& rgb) {
+    if (s.size() != 7 || s[0] != '#') return false;
+    rgb = 0;
+    for (std::size_t i = 1; i < 7; ++i) {
+        char c = s[i];
+        std::uint32_t v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+        else return false;
+        rgb = (rgb << 4) | v;
+    }
+    return true;
+}
+
+// Coordinates a binary draw could carry too; anything else stays raw.
+bool inRange(const nlohmann::json& v) {
+    if (!v.is_number()) return false;
+    constexpr double kMax = double(StrokeCodec::kMaxCoord) / StrokeCodec::kCoordScale;
+    double d = v.get<double>();
+    return d > -kMax && d < kMax;
+}
+
+// Number of points if payload is {"color":"#rrggbb","width":n,"points":[[x,y],...]}
+// and nothing else; 0 otherwise.
+std::size_t canonicalPointCount(const nlohmann::json& payload, std::uint32_t& rgb) {
+    if (!payload.is_object() || payload.size() != 3) return 0;
+    auto color = payload.find("color");
+    auto width = payload.find("width");
+    auto points = payload.find("points");
+    if (color == payload.end() || width == payload.end() || points == payload.end()) return 0;
+    if (!color->is_string() || !parseHexColor(color->get_ref<const std::string&>(), rgb)) return 0;
+    if (!inRange(*width) || !points->is_array() || points->empty()) return 0;
+    for (const auto& p : *points) {
+        if (!p.is_array() || p.size() != 2 || !inRange(p[0]) || !inRange(p[1])) return 0;
+    }
+    return points->size();
+}
+
+// Shortest text that reads back as the same float.
+void appendNumber(std::string& out, float v) {
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, res.ptr);
+}
+
+}
+
+StrokeStore::StrokeStore(std::string_view room)
+    : m_room(room),
+    m_roomJson(nlohmann::json(m_room).dump()) {
+}
+
+StrokeStore::StrokeStore(StrokeStore&&) noexcept = default;
+StrokeStore& StrokeStore::operator=(StrokeStore&&) noexcept = default;
+StrokeStore::~StrokeStore() = default;
+
+StrokeStore::Record& StrokeStore::record(std::size_t i) const {
+    return m_records[i / kRecordChunk][i % kRecordChunk];
+}
+
+StrokeStore::Record& StrokeStore::pushRecord() {
+    if (m_count == m_records.size() * kRecordChunk)
+        m_records.push_back(std::make_unique<Record[]>(kRecordChunk));
+    return record(m_count++);
+}
+
+// A stroke's points are never split across chunks, so every stroke can be
+// walked as two plain arrays. Oversized strokes get a chunk of their own.
+StrokeStore::PointChunk& StrokeStore::allocPoints(std::uint32_t count, Record& rec) {
+    if (m_points.empty() || m_points.back().capacity - m_points.back().used < count) {
+        PointChunk chunk;
+        chunk.capacity = std::max(count, kPointChunk);
+        chunk.data = std::make_unique<float[]>(std::size_t(chunk.capacity) * 2);
+        m_points.push_back(std::move(chunk));
+    }
+    PointChunk& chunk = m_points.back();
+    rec.chunk = static_cast<std::uint32_t>(m_points.size() - 1);
+    rec.offset = chunk.used;
+    rec.count = count;
+    chunk.used += count;
+    return chunk;
+}
+
+char* StrokeStore::allocBytes(std::uint32_t size, Record& rec) {
+    if (m_bytes.empty() || m_bytes.back().capacity - m_bytes.back().used < size) {
+        ByteChunk chunk;
+        chunk.capacity = std::max(size, kByteChunk);
+        chunk.data = std::make_unique<char[]>(chunk.capacity);
+        m_bytes.push_back(std::move(chunk));
+    }
+    ByteChunk& chunk = m_bytes.back();
+    rec.chunk = static_cast<std::uint32_t>(m_bytes.size() - 1);
+    rec.offset = chunk.used;
+    rec.count = size;
+    chunk.used += size;
+    return chunk.data.get() + rec.offset;
+}
+
+StrokeStore::Stored StrokeStore::appendBinary(std::string_view body) {
+    // Decoded through a per-thread scratch stroke, then copied into the arena.
+    // The codec already caps the point count.
+    thread_local StrokeCodec::Stroke scratch;
+    if (!StrokeCodec::decodeDraw(body, scratch)) return Stored::rejected;
+
+    Record& rec = pushRecord();
+    rec.kind = Kind::binary;
+    rec.rgb = scratch.rgb;
+    rec.width = std::clamp(static_cast<float>(scratch.width), kMinWidth, kMaxWidth);
+    PointChunk& chunk = allocPoints(static_cast<std::uint32_t>(scratch.points.size()), rec);
+    float* xs = chunk.xs() + rec.offset;
+    float* ys = chunk.ys() + rec.offset;
+    constexpr float kScale = 1.0f / StrokeCodec::kCoordScale;
+    for (std::size_t i = 0; i < scratch.points.size(); ++i) {
+        xs[i] = static_cast<float>(scratch.points[i].x) * kScale;
+        ys[i] = static_cast<float>(scratch.points[i].y) * kScale;
+    }
+    return rec.width == static_cast<float>(scratch.width) ? Stored::asSent : Stored::clamped;
+}
+
+StrokeStore::Stored StrokeStore::appendJson(const nlohmann::json& payload) {
+    Record& rec = pushRecord();
+    rec.rgb = 0;
+    rec.width = 0;
+
+    std::uint32_t rgb = 0;
+    std::size_t count = canonicalPointCount(payload, rgb);
+    if (count == 0) {
+        std::string text = payload.dump();
+        rec.kind = Kind::raw;
+        char* dst = allocBytes(static_cast<std::uint32_t>(text.size()), rec);
+        std::copy(text.begin(), text.end(), dst);
+        return Stored::asSent;
+    }
+
+    float width = payload["width"].get<float>();
+    rec.kind = Kind::json;
+    rec.rgb = rgb;
+    rec.width = std::clamp(width, kMinWidth, kMaxWidth);
+    bool clamped = rec.width != width || count > StrokeCodec::kMaxPoints;
+    count = std::min(count, StrokeCodec::kMaxPoints);
+    PointChunk& chunk = allocPoints(static_cast<std::uint32_t>(count), rec);
+    float* xs = chunk.xs() + rec.offset;
+    float* ys = chunk.ys() + rec.offset;
+    const auto& points = payload["points"];
+    for (std::size_t i = 0; i < count; ++i) {
+        xs[i] = points[i][0].get<float>();
+        ys[i] = points[i][1].get<float>();
+    }
+    return clamped ? Stored::clamped : Stored::asSent;
+}
+
+bool StrokeStore::popBack() {
+    if (m_count == 0) return false;
+    const Record& rec = record(--m_count);
+
+    // The last stroke is always at the end of the newest chunk it used.
+    if (rec.kind == Kind::raw) {
+        m_bytes[rec.chunk].used = rec.offset;
+        while (m_bytes.size() > 1 && m_bytes.back().used == 0 && m_bytes[m_bytes.size() - 2].used == 0)
+            m_bytes.pop_back();
+    }
+    else {
+        m_points[rec.chunk].used = rec.offset;
+        while (m_points.size() > 1 && m_points.back().used == 0 && m_points[m_points.size() - 2].used == 0)
+            m_points.pop_back();
+    }
+    // Keep one empty record chunk as headroom for the next append.
+    if (m_records.size() > 1 && m_records.size() * kRecordChunk - m_count > 2 * kRecordChunk)
+        m_records.pop_back();
+    return true;
+}
+
+std::size_t StrokeStore::simplifyBack(const SimplifyOptions& options) {
+    if (m_count == 0) return 0;
+    Record& rec = record(m_count - 1);
+    if (rec.kind == Kind::raw) return 0;
+
+    // The newest stroke ends its chunk, so shrinking it just moves `used` back.
+    PointChunk& chunk = m_points[rec.chunk];
+    std::size_t kept = StrokeSimplify::simplify(chunk.xs() + rec.offset, chunk.ys() + rec.offset, rec.count, options);
+    std::size_t removed = rec.count - kept;
+    rec.count = static_cast<std::uint32_t>(kept);
+    chunk.used = rec.offset + rec.count;
+    return removed;
+}
+
+void StrokeStore::clear() {
+    m_count = 0;
+    if (m_records.size() > 1) m_records.resize(1);
+    if (!m_points.empty()) {
+        m_points.resize(1);
+        if (m_points[0].capacity != kPointChunk) m_points.clear(); // don't keep an oversized chunk
+        else m_points[0].used = 0;
+    }
+    if (!m_bytes.empty()) {
+        m_bytes.resize(1);
+        if (m_bytes[0].capacity != kByteChunk) m_bytes.clear();
+        else m_bytes[0].used = 0;
+    }
+}
+
+StrokeStore::StrokeView StrokeStore::operator[](std::size_t i) const {
+    const Record& rec = record(i);
+    StrokeView v{ rec.kind, rec.rgb, rec.width, nullptr, nullptr, 0, {} };
+    if (rec.kind == Kind::raw) {
+        v.raw = std::string_view(m_bytes[rec.chunk].data.get() + rec.offset, rec.count);
+    }
+    else {
+        const PointChunk& chunk = m_points[rec.chunk];
+        v.xs = chunk.xs() + rec.offset;
+        v.ys = chunk.ys() + rec.offset;
+        v.count = rec.count;
+    }
+    return v;
+}
+
+void StrokeStore::appendJsonMessage(std::string& out, const StrokeView& stroke) const {
+    out += R"({"type":"draw","room":)";
+    out += m_roomJson;
+    out += R"(,"payload":)";
+    if (stroke.kind == Kind::raw) {
+        out += stroke.raw;
+        out += '}';
+        return;
+    }
+    out += R"({"color":")";
+    out += StrokeCodec::colorToHex(stroke.rgb);
+    out += R"(","width":)";
+    appendNumber(out, stroke.width);
+    out += R"(,"points":[)";
+    for (std::uint32_t i = 0; i < stroke.count; ++i) {
+        if (i) out += ',';
+        out += '[';
+        appendNumber(out, stroke.xs[i]);
+        out += ',';
+        appendNumber(out, stroke.ys[i]);
+        out += ']';
+    }
+    out += "]}}";
+}
+
+void StrokeStore::appendBinaryMessage(std::string& out, const StrokeView& stroke) const {
+    StrokeCodec::appendDraw(out, m_room, stroke.rgb, static_cast<std::uint32_t>(std::lround(stroke.width)),
+        stroke.xs, stroke.ys, stroke.count);
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "strokeSimplify.h"
+
+// A room's drawing history. Strokes are fixed-size records and their points
+// live in structure-of-arrays chunks (all x then all y, in px), so a stroke
+// costs one record plus 8 bytes per point and appending never allocates per
+// stroke: records, points and the odd non-canonical payload each go into
+// chunked arenas that grow a chunk at a time.
+//
+// Draw payloads of the canonical shape
+//   {"color":"#rrggbb","width":w,"points":[[x,y],...]}
+// and binary StrokeCodec draws are stored as points; any other JSON payload
+// is kept verbatim. Messages are serialized from the store on demand.
+// Stored strokes are clamped to kMinWidth..kMaxWidth and at most
+// StrokeCodec::kMaxPoints points, so one stroke has a bounded raster cost.
+//
+// Not thread-safe; only touched on its Room's strand.
+class StrokeStore {
+public:
+    enum class Kind : std::uint8_t {
+        binary, // arrived as a StrokeCodec message
+        json,   // canonical JSON payload
+        raw     // any other JSON payload, stored serialized
+    };
+
+    enum class Stored : std::uint8_t {
+        rejected, // malformed binary body; nothing stored
+        asSent,
+        clamped   // width or points cut to the limits; relay the stored copy
+    };
+
+    static constexpr float kMinWidth = 1.0f;
+    static constexpr float kMaxWidth = 64.0f; // widest entry in StrokeCodec's width table
+
+    // Valid until the next popBack() or clear().
+    struct StrokeView {
+        Kind kind;
+        std::uint32_t rgb;
+        float width;
+        const float* xs;
+        const float* ys;
+        std::uint32_t count;
+        std::string_view raw; // Kind::raw only: the payload object
+    };
+
+    // room is the id every serialized message carries: the owning Room's
+    // normalized id, whatever spelling a client used.
+    explicit StrokeStore(std::string_view room = {});
+    StrokeStore(StrokeStore&&) noexcept;
+    StrokeStore& operator=(StrokeStore&&) noexcept;
+    ~StrokeStore();
+
+    // body is the draw part of a message that passed StrokeCodec::parseHeader.
+    Stored appendBinary(std::string_view body);
+    Stored appendJson(const nlohmann::json& payload);
+    bool popBack();
+    // Simplifies the newest stroke's points in place and hands the freed
+    // space back to its chunk. Returns the points removed; Kind::raw
+    // strokes are left alone.
+    std::size_t simplifyBack(const SimplifyOptions& options);
+    void clear(); // keeps one chunk of each arena for reuse
+
+    std::size_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    StrokeView operator[](std::size_t i) const;
+
+    template <typename F>
+    void forEach(F&& fn, std::size_t first = 0) const {
+        for (std::size_t i = first; i < m_count; ++i) fn((*this)[i]);
+    }
+
+    // {"type":"draw","room":..,"payload":{..}} and the StrokeCodec message.
+    void appendJsonMessage(std::string& out, const StrokeView& stroke) const;
+    void appendBinaryMessage(std::string& out, const StrokeView& stroke) const;
+
+private:
+    struct Record {
+        std::uint32_t rgb;
+        float width;
+        std::uint32_t chunk;  // point chunk, or byte chunk for Kind::raw
+        std::uint32_t offset;
+        std::uint32_t count;  // points, or bytes for Kind::raw
+        Kind kind;
+    };
+
+    // Points are [x0..x(capacity-1), y0..y(capacity-1)].
+    struct PointChunk {
+        std::unique_ptr<float[]> data;
+        std::uint32_t capacity = 0;
+        std::uint32_t used = 0;
+        float* xs() const { return data.get(); }
+        float* ys() const { return data.get() + capacity; }
+    };
+
+    struct ByteChunk {
+        std::unique_ptr<char[]> data;
+        std::uint32_t capacity = 0;
+        std::uint32_t used = 0;
+    };
+
+    static constexpr std::size_t kRecordChunk = 1024;
+    static constexpr std::uint32_t kPointChunk = 16 * 1024;
+    static constexpr std::uint32_t kByteChunk = 64 * 1024;
+
+    Record& pushRecord();
+    Record& record(std::size_t i) const;
+    PointChunk& allocPoints(std::uint32_t count, Record& rec);
+    char* allocBytes(std::uint32_t size, Record& rec);
+
+    std::vector<std::unique_ptr<Record[]>> m_records;
+    std::size_t m_count = 0;
+    std::vector<PointChunk> m_points;
+    std::vector<ByteChunk> m_bytes;
+
+    std::string m_room;     // every stroke in a store belongs to one room
+    std::string m_roomJson; // m_room as a quoted JSON string
+};
@@ -0,0 +1,90 @@
+#include "timerService.h"
+#include "metrics.h"
+#include <algorithm>
+
+TimerService::TimerService(boost::asio::io_context& io, std::chrono::milliseconds tick, std::size_t slots)
+    : m_strand(boost::asio::make_strand(io)),
+    m_timer(m_strand),
+    m_tick(std::max(tick, std::chrono::milliseconds(1))),
+    m_slots(std::max<std::size_t>(1, slots)) {
+}
+
+TimerService::TimerId TimerService::schedule(std::chrono::milliseconds delay, std::function<void()> fn) {
+    TimerId id = m_nextId.fetch_add(1, std::memory_order_relaxed);
+    auto deadline = std::chrono::steady_clock::now() + delay;
+    Metrics::instance().timersScheduled.fetch_add(1, std::memory_order_relaxed);
+    boost::asio::post(m_strand, [this, id, deadline, fn = std::move(fn)]() mutable {
+        insert(id, deadline, std::move(fn));
+    });
+    return id;
+}
+
+void TimerService::cancel(TimerId id) {
+    if (id == kNoTimer) return;
+    boost::asio::post(m_strand, [this, id]() {
+        // The id stays in its bucket and is dropped when the wheel gets there.
+        if (m_timers.erase(id))
+            Metrics::instance().timersCancelled.fetch_add(1, std::memory_order_relaxed);
+    });
+}
+
+void TimerService::insert(TimerId id, std::chrono::steady_clock::time_point deadline, std::function<void()> fn) {
+    if (!m_armed) {
+        m_armed = true;
+        m_nextTick = std::chrono::steady_clock::now();
+        scheduleTick();
+    }
+
+    // m_nextTick is when the bucket under the cursor is visited; every later
+    // visit is one tick further. Pick the first visit at or after deadline.
+    std::size_t visits = 1;
+    if (deadline > m_nextTick) {
+        auto ahead = deadline - m_nextTick;
+        auto tick = std::chrono::duration_cast<std::chrono::steady_clock::duration>(m_tick);
+        visits += static_cast<std::size_t>((ahead + tick - std::chrono::steady_clock::duration(1)) / tick);
+    }
+    std::size_t slot = (m_cursor + visits - 1) % m_slots.size();
+    m_slots[slot].push_back(id);
+    m_timers.emplace(id, Timer{ (visits - 1) / m_slots.size(), std::move(fn) });
+}
+
+void TimerService::scheduleTick() {
+    // Absolute deadlines so slow ticks don't accumulate drift.
+    m_nextTick += m_tick;
+    m_timer.expires_at(m_nextTick);
+    m_timer.async_wait([this](boost::system::error_code ec) {
+        if (ec) return;
+        onTick();
+        if (m_timers.empty()) {
+            m_armed = false; // the next schedule() restarts the wheel
+            return;
+        }
+        scheduleTick();
+    });
+}
+
+void TimerService::onTick() {
+    auto& bucket = m_slots[m_cursor];
+    m_cursor = (m_cursor + 1) % m_slots.size();
+
+    // Timers on a later lap are compacted in place and stay for the next
+    // revolution; due ones fire after the bucket is settled, so a handler
+    // that schedules again never sees it half-compacted.
+    std::vector<std::function<void()>> due;
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < bucket.size(); ++i) {
+        auto it = m_timers.find(bucket[i]);
+        if (it == m_timers.end()) continue; // cancelled
+        if (it->second.laps > 0) {
+            --it->second.laps;
+            bucket[kept++] = bucket[i];
+            continue;
+        }
+        due.push_back(std::move(it->second.fn));
+        m_timers.erase(it);
+    }
+    bucket.resize(kept);
+
+    Metrics::instance().timersFired.fetch_add(due.size(), std::memory_order_relaxed);
+    for (auto& fn : due) fn();
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// One-shot timers for everything on a shard (round expiry, hint reveals,
+// countdowns) on a single hashed timing wheel instead of a thread or a
+// steady_timer each. The wheel has `slots` buckets of `tick` and one timer,
+// which only runs while something is pending. A deadline further out than
+// a revolution stays in its bucket and is skipped until its last lap.
+// Timers fire up to one tick late, never early.
+class TimerService {
+public:
+    using TimerId = std::uint64_t;
+    static constexpr TimerId kNoTimer = 0;
+
+    explicit TimerService(boost::asio::io_context& io,
+        std::chrono::milliseconds tick = std::chrono::milliseconds(100),
+        std::size_t slots = 512);
+
+    // Thread-safe. fn runs on the service's strand and should only hand the
+    // work to its owner (e.g. post to a room's strand); capture owners
+    // weakly, a timer may fire after they are gone unless cancelled.
+    TimerId schedule(std::chrono::milliseconds delay, std::function<void()> fn);
+    // Thread-safe; kNoTimer and timers that already fired are ignored. A
+    // cancel issued after schedule from the same thread always wins.
+    void cancel(TimerId id);
+
+private:
+    struct Timer {
+        std::size_t laps; // full revolutions still to skip
+        std::function<void()> fn;
+    };
+
+    void insert(TimerId id, std::chrono::steady_clock::time_point deadline, std::function<void()> fn);
+    void scheduleTick();
+    void onTick();
+
+    boost::asio::strand<boost::asio::io_context::executor_type> m_strand;
+    boost::asio::steady_timer m_timer;
+    const std::chrono::milliseconds m_tick;
+    std::chrono::steady_clock::time_point m_nextTick; // strand only
+    std::atomic<TimerId> m_nextId{ 1 };
+
+    std::vector<std::vector<TimerId>> m_slots;    // strand only; may hold cancelled ids
+    std::unordered_map<TimerId, Timer> m_timers;  // strand only; pending timers
+    std::size_t m_cursor = 0;                     // strand only
+    bool m_armed = false;                         // strand only
+};
@@ -0,0 +1,27 @@
+#include "wsFrame.h"
+
+FrameHeader makeFrameHeader(WsOpcode opcode, std::size_t payloadSize, bool rsv1) {
+    FrameHeader h;
+    h.bytes[0] = static_cast<std::uint8_t>(0x80 | (rsv1 ? 0x40 : 0x00) | static_cast<std::uint8_t>(opcode));
+
+    if (payloadSize < 126) {
+        h.bytes[1] = static_cast<std::uint8_t>(payloadSize);
+        h.size = 2;
+    }
+    else if (payloadSize <= 0xFFFF) {
+        h.bytes[1] = 126;
+        h.bytes[2] = static_cast<std::uint8_t>(payloadSize >> 8);
+        h.bytes[3] = static_cast<std::uint8_t>(payloadSize);
+        h.size = 4;
+    }
+    else {
+        h.bytes[1] = 127;
+        std::uint64_t len = payloadSize;
+        for (int i = 0; i < 8; ++i) {
+            h.bytes[9 - i] = static_cast<std::uint8_t>(len);
+            len >>= 8;
+        }
+        h.size = 10;
+    }
+    return h;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Minimal RFC 6455 framing for server-to-client messages. Server frames are
+// never masked, so a header depends only on opcode, flags and length and can
+// be built once per message and shared by every session that sends it.
+enum class WsOpcode : std::uint8_t {
+    text = 0x1,
+    binary = 0x2,
+    close = 0x8,
+    ping = 0x9,
+    pong = 0xA
+};
+
+struct FrameHeader {
+    std::array<std::uint8_t, 10> bytes{};
+    std::uint8_t size = 0;
+
+    const void* data() const { return bytes.data(); }
+};
+
+// fin is always set; rsv1 marks a permessage-deflate compressed payload.
+FrameHeader makeFrameHeader(WsOpcode opcode, std::size_t payloadSize, bool rsv1 = false);
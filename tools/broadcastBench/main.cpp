@@ -0,0 +1,202 @@
+#include "metrics.h"
+#include "mpscQueue.h"
+#include "outboundMessage.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+// Measures what one broadcast costs across many session queues, e.g.
+//
+//   BroadcastBench --queues 5000 --broadcasts 2000
+//
+// compares three fan-outs of the same serialized payload:
+//   copy    a std::string copy per session, as Room::broadcast used to
+//   shared  one OutboundMessage, a MessagePtr per session write queue
+//   outbox  the same, pushed through each Session's MpscQueue outbox and
+//           drained into its write queue, as Session::send does now
+// Queues keep their last --depth messages, standing in for writes that
+// have not finished yet. No sockets or strands are involved.
+
+namespace {
+std::atomic<std::uint64_t> g_allocations{0};
+}
+
+// Counts every allocation, so the benchmark can report allocations per
+// broadcast.
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+struct Options {
+    std::size_t queues = 5000;
+    std::size_t broadcasts = 2000;
+    std::size_t depth = 4;
+    std::size_t payloadBytes = 308;
+};
+
+void usage() {
+    std::cout <<
+        "usage: BroadcastBench [options]\n"
+        "  --queues N        session queues a broadcast reaches (5000)\n"
+        "  --broadcasts N    broadcasts per fan-out (2000)\n"
+        "  --depth N         messages each queue keeps, i.e. writes in flight (4)\n"
+        "  --payload N       payload size in bytes (308, a typical draw message)\n";
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            std::exit(0);
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--queues") options.queues = std::stoul(value);
+            else if (arg == "--broadcasts") options.broadcasts = std::stoul(value);
+            else if (arg == "--depth") options.depth = std::stoul(value);
+            else if (arg == "--payload") options.payloadBytes = std::stoul(value);
+            else {
+                std::cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Bad value for " << arg << ": " << value << "\n";
+            return false;
+        }
+    }
+    return options.queues > 0 && options.broadcasts > 0;
+}
+
+// A draw message padded to the requested size, serialized once per broadcast.
+std::string drawPayload(std::size_t size) {
+    nlohmann::json j = {
+        {"type", "draw"},
+        {"room", "loadgen0"},
+        {"payload", {
+            {"color", "#1E90FF"},
+            {"width", 4},
+            {"points", {{10, 20}, {11, 22}, {13, 25}, {16, 29}, {20, 34}, {25, 40}}}
+        }}
+    };
+    std::string payload = j.dump();
+    if (payload.size() < size) {
+        j["payload"]["id"] = std::string(size - payload.size() - 8, 'x');
+        payload = j.dump();
+    }
+    return payload;
+}
+
+struct Result {
+    std::uint64_t allocations = 0;
+    std::uint64_t bytesCopied = 0;
+    double seconds = 0;
+};
+
+// Runs broadcast(payload) options.broadcasts times and returns the totals.
+// The first depth broadcasts fill the queues and are not counted.
+template <class Broadcast>
+Result run(const Options& options, const std::string& serialized, Broadcast&& broadcast) {
+    for (std::size_t i = 0; i < options.depth; ++i) broadcast(serialized);
+
+    using clock = std::chrono::steady_clock;
+    Result r;
+    std::uint64_t before = g_allocations.load(std::memory_order_relaxed);
+    auto started = clock::now();
+    for (std::size_t i = 0; i < options.broadcasts; ++i) r.bytesCopied += broadcast(serialized);
+    r.seconds = std::chrono::duration<double>(clock::now() - started).count();
+    r.allocations = g_allocations.load(std::memory_order_relaxed) - before;
+    return r;
+}
+
+void report(const char* name, const Options& options, const Result& r) {
+    double n = static_cast<double>(options.broadcasts);
+    char out[200];
+    std::snprintf(out, sizeof(out), "%-7s %9.1f allocations %11.0f bytes copied %8.3f ms   per broadcast",
+        name, static_cast<double>(r.allocations) / n, static_cast<double>(r.bytesCopied) / n, r.seconds * 1e3 / n);
+    std::cout << out << "\n";
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+    const std::string serialized = drawPayload(options.payloadBytes);
+    std::cout << options.queues << " queues, " << serialized.size() << "-byte payload, depth "
+        << options.depth << ", " << options.broadcasts << " broadcasts\n";
+
+    // Each broadcast copies the serialized message once, as every caller's
+    // dump() or string building does, and returns the bytes it copied.
+    {
+        std::vector<std::deque<std::string>> queues(options.queues);
+        report("copy", options, run(options, serialized, [&](const std::string& s) {
+            std::string payload = s;
+            std::uint64_t copied = payload.size();
+            for (auto& q : queues) {
+                q.push_back(payload);
+                copied += payload.size();
+                if (q.size() > options.depth) q.pop_front();
+            }
+            return copied;
+        }));
+    }
+    {
+        std::vector<std::deque<MessagePtr>> queues(options.queues);
+        report("shared", options, run(options, serialized, [&](const std::string& s) {
+            MessagePtr msg = makeMessage(s, MessageClass::draw);
+            for (auto& q : queues) {
+                q.push_back(msg);
+                if (q.size() > options.depth) q.pop_front();
+            }
+            return static_cast<std::uint64_t>(s.size());
+        }));
+    }
+    {
+        struct Queue {
+            MpscQueue<MessagePtr> outbox;
+            std::deque<MessagePtr> writeQueue;
+        };
+        std::vector<Queue> queues(options.queues);
+        report("outbox", options, run(options, serialized, [&](const std::string& s) {
+            MessagePtr msg = makeMessage(s, MessageClass::draw);
+            for (auto& q : queues) q.outbox.push(msg);
+            for (auto& q : queues) {
+                MessagePtr next;
+                while (q.outbox.pop(next)) q.writeQueue.push_back(std::move(next));
+                while (q.writeQueue.size() > options.depth) q.writeQueue.pop_front();
+            }
+            return static_cast<std::uint64_t>(s.size());
+        }));
+    }
+
+    const Metrics& m = Metrics::instance();
+    std::cout << "metrics: " << m.messagesAllocated.load() << " buffers, "
+        << m.payloadBytesSerialized.load() << " bytes serialized\n";
+    return 0;
+}
@@ -0,0 +1,283 @@
+#include "guessMatcher.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Checks GuessMatcher against a plain DP Levenshtein and times it, e.g.
+//
+//   GuessMatcherBench --pairs 200000 --seconds 2
+//
+// The bit-parallel distance is private, so it is checked through match():
+// each random answer/guess pair is matched under every close distance from
+// 0 to kMaxBound, which pins the distance down wherever the bound reaches.
+// The benchmark runs on one thread, so its rate is per core.
+
+namespace {
+constexpr std::size_t kMaxBound = 16;
+
+struct Options {
+    std::uint64_t pairs = 200000;
+    std::uint32_t seed = 1;
+    double seconds = 2.0;
+};
+
+void usage() {
+    std::cout <<
+        "usage: GuessMatcherBench [options]\n"
+        "  --pairs N         random answer/guess pairs to check (200000, 0 = skip)\n"
+        "  --seed N          random seed (1)\n"
+        "  --seconds S       time per benchmark (2, 0 = skip)\n";
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            std::exit(0);
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--pairs") options.pairs = std::stoull(value);
+            else if (arg == "--seed") options.seed = static_cast<std::uint32_t>(std::stoul(value));
+            else if (arg == "--seconds") options.seconds = std::stod(value);
+            else {
+                std::cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Bad value for " << arg << ": " << value << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int g_failures = 0;
+
+void fail(std::string_view what, std::string_view answer, std::string_view guess) {
+    if (++g_failures <= 20) std::cerr << "FAIL " << what << ": \"" << answer << "\" vs \"" << guess << "\"\n";
+}
+
+const char* name(GuessMatcher::Match m) {
+    return m == GuessMatcher::Match::exact ? "exact" : m == GuessMatcher::Match::close ? "close" : "miss";
+}
+
+// ---- known answers ----
+
+void checkKnownAnswers() {
+    struct Case { std::string_view answer; std::string_view guess; GuessMatcher::Match expected; };
+    using M = GuessMatcher::Match;
+    static const Case cases[] = {
+        { "creme brulee", "Crème  Brûlée", M::exact },
+        { "creme brulee", "  CREME BRULEE ", M::exact },
+        { "giraffe", "\xEF\xBC\xA7\xEF\xBC\xA9\xEF\xBC\xB2\xEF\xBC\xA1\xEF\xBC\xA6\xEF\xBC\xA6\xEF\xBC\xA5", M::exact }, // fullwidth
+        { "strasse", "Straße", M::exact },
+        { "\xD0\xB5\xD0\xB6", "\xD0\x81\xD0\x96", M::exact }, // еж / ЁЖ
+        { "cafe", "cafe\xCC\x81", M::exact }, // combining acute
+        { "elephant", "elefant", M::close },
+        { "elephant", "elephnat", M::close },
+        { "elephant", "giraffe", M::miss },
+        { "cat", "cut", M::miss }, // too short to be close
+        { "hippopotamus", "hipopotamus", M::close },
+        { "hippopotamus", "hippo", M::miss },
+    };
+    MatchOptions options;
+    options.closeDistance = 2;
+    for (const Case& c : cases) {
+        GuessMatcher matcher(std::string(c.answer), options);
+        GuessMatcher::Match got = matcher.match(c.guess);
+        if (got != c.expected) fail(std::string("expected ") + name(c.expected) + ", got " + name(got), c.answer, c.guess);
+    }
+    std::cout << "known answers: " << std::size(cases) << " cases\n";
+}
+
+// ---- DP reference ----
+
+std::size_t levenshtein(const std::u32string& a, const std::u32string& b) {
+    std::vector<std::size_t> row(b.size() + 1);
+    for (std::size_t j = 0; j <= b.size(); ++j) row[j] = j;
+    for (std::size_t i = 1; i <= a.size(); ++i) {
+        std::size_t diagonal = row[0];
+        row[0] = i;
+        for (std::size_t j = 1; j <= b.size(); ++j) {
+            std::size_t above = row[j];
+            row[j] = std::min({ above + 1, row[j - 1] + 1, diagonal + (a[i - 1] == b[j - 1] ? 0 : 1) });
+            diagonal = above;
+        }
+    }
+    return row[b.size()];
+}
+
+// What match() should say, from the normalized strings and the DP.
+GuessMatcher::Match reference(const std::u32string& answer, const std::u32string& guess, std::size_t closeDistance) {
+    if (guess == answer) return GuessMatcher::Match::exact;
+    if (answer.empty() || answer.size() > 64) return GuessMatcher::Match::miss;
+    std::size_t bound = std::min(closeDistance, answer.size() / 4);
+    if (bound == 0) return GuessMatcher::Match::miss;
+    return levenshtein(answer, guess) <= bound ? GuessMatcher::Match::close : GuessMatcher::Match::miss;
+}
+
+// A few letters (some of them multi-byte, one outside the BMP) and a space,
+// so random strings share plenty and the distances stay small.
+const std::vector<std::string>& alphabet() {
+    static const std::vector<std::string> letters = {
+        "a", "b", "c", "d", "E", " ", "\xC3\xA9" /* é */, "\xD0\xB6" /* ж */,
+        "\xCE\xA9" /* Ω */, "\xF0\x9F\x8E\xA8" /* 🎨 */, "\xE2\x82\xAC" /* € */,
+    };
+    return letters;
+}
+
+std::string randomWord(std::mt19937& rng, std::size_t length) {
+    const auto& letters = alphabet();
+    std::string word;
+    for (std::size_t i = 0; i < length; ++i) word += letters[rng() % letters.size()];
+    return word;
+}
+
+// Edits whole code points, so the guess stays valid UTF-8.
+std::string randomEdits(std::mt19937& rng, const std::string& word, int edits) {
+    std::vector<std::string> points;
+    for (std::size_t i = 0; i < word.size();) {
+        std::size_t len = 1;
+        while (i + len < word.size() && (static_cast<unsigned char>(word[i + len]) & 0xC0) == 0x80) ++len;
+        points.push_back(word.substr(i, len));
+        i += len;
+    }
+    const auto& letters = alphabet();
+    for (int e = 0; e < edits; ++e) {
+        std::size_t at = points.empty() ? 0 : rng() % (points.size() + 1);
+        switch (rng() % 3) {
+        case 0: points.insert(points.begin() + at, letters[rng() % letters.size()]); break;
+        case 1: if (at < points.size()) points.erase(points.begin() + at); break;
+        case 2: if (at < points.size()) points[at] = letters[rng() % letters.size()]; break;
+        }
+    }
+    std::string out;
+    for (const auto& p : points) out += p;
+    return out;
+}
+
+void checkAgainstReference(const Options& options) {
+    if (options.pairs == 0) return;
+    std::mt19937 rng(options.seed);
+    std::u32string answerNorm, guessNorm;
+    std::uint64_t close = 0, exact = 0;
+    for (std::uint64_t n = 0; n < options.pairs; ++n) {
+        // Up to 72 letters, so answers past the 64-letter limit come up too.
+        std::string answer = randomWord(rng, 1 + rng() % 72);
+        std::string guess = rng() % 8 == 0
+            ? randomWord(rng, 1 + rng() % 72)
+            : randomEdits(rng, answer, static_cast<int>(rng() % (kMaxBound + 3)));
+        GuessMatcher::normalize(answer, answerNorm);
+        GuessMatcher::normalize(guess, guessNorm);
+
+        for (std::size_t closeDistance = 0; closeDistance <= kMaxBound; ++closeDistance) {
+            MatchOptions matchOptions;
+            matchOptions.closeDistance = closeDistance;
+            GuessMatcher matcher(answer, matchOptions);
+            GuessMatcher::Match expected = reference(answerNorm, guessNorm, closeDistance);
+            GuessMatcher::Match got = matcher.match(guess);
+            if (got != expected) {
+                fail("distance " + std::to_string(closeDistance) + ": expected " + name(expected) + ", got " + name(got), answer, guess);
+                break;
+            }
+            if (matcher.matchNormalized(guessNorm) != got) fail("matchNormalized differs from match", answer, guess);
+            if (closeDistance == kMaxBound) {
+                close += got == GuessMatcher::Match::close;
+                exact += got == GuessMatcher::Match::exact;
+            }
+        }
+    }
+    std::cout << "reference: " << options.pairs << " pairs x " << kMaxBound + 1 << " bounds checked against DP ("
+        << close << " close, " << exact << " exact at bound " << kMaxBound << ")\n";
+}
+
+// ---- benchmark ----
+
+// Guesses as chat sends them for one answer: mostly wrong words, some near
+// misses, a few right, a little non-ASCII.
+std::vector<std::string> chatGuesses(const std::string& answer, std::mt19937& rng) {
+    static const char* const words[] = {
+        "giraffe", "elephant", "banana", "house", "car", "tree", "dog", "cat", "pizza", "rocket",
+        "Mountain", "LIGHTHOUSE", "ice cream", "spider man", "snowman", "Café", "crème brûlée",
+        "\xD0\xBA\xD0\xBE\xD1\x82" /* кот */, "lol", "is it a boat?", "hippopotamus", "keyboard",
+    };
+    std::vector<std::string> guesses;
+    for (int i = 0; i < 4096; ++i) {
+        unsigned roll = rng() % 20;
+        if (roll == 0) guesses.push_back(answer);
+        else if (roll < 4) guesses.push_back(randomEdits(rng, answer, 1 + static_cast<int>(rng() % 2)));
+        else guesses.push_back(words[rng() % std::size(words)]);
+    }
+    return guesses;
+}
+
+template <class Match>
+void timeMatch(const char* label, const std::vector<std::string>& guesses, double seconds, Match&& match) {
+    using clock = std::chrono::steady_clock;
+    std::uint64_t hits = 0, done = 0;
+    auto started = clock::now();
+    double elapsed = 0;
+    do {
+        for (const std::string& g : guesses) hits += match(g);
+        done += guesses.size();
+        elapsed = std::chrono::duration<double>(clock::now() - started).count();
+    } while (elapsed < seconds);
+    char out[200];
+    std::snprintf(out, sizeof(out), "%-22s %8.2f M guesses/s %7.1f ns/guess (%llu non-miss)",
+        label, static_cast<double>(done) / elapsed / 1e6, elapsed * 1e9 / static_cast<double>(done),
+        static_cast<unsigned long long>(hits));
+    std::cout << out << "\n";
+}
+
+void bench(const Options& options) {
+    if (options.seconds <= 0) return;
+    std::mt19937 rng(options.seed);
+    for (const char* answer : { "elephant", "hippopotamus", "creme brulee" }) {
+        std::vector<std::string> guesses = chatGuesses(answer, rng);
+        GuessMatcher matcher(answer, GuessMatcher::defaults());
+        std::cout << "answer \"" << answer << "\", " << guesses.size() << " chat guesses:\n";
+        timeMatch("  GuessMatcher::match", guesses, options.seconds,
+            [&](const std::string& g) { return matcher.match(g) != GuessMatcher::Match::miss; });
+        // What GameProtocol did before: ASCII tolower and ==.
+        std::string lowered;
+        timeMatch("  tolower ==", guesses, options.seconds, [&](const std::string& g) {
+            lowered = g;
+            for (char& c : lowered) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            return lowered == answer;
+        });
+    }
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    checkKnownAnswers();
+    checkAgainstReference(options);
+    if (g_failures) {
+        std::cerr << g_failures << " failures\n";
+        return 1;
+    }
+    bench(options);
+    return 0;
+}
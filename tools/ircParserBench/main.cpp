@@ -0,0 +1,426 @@
+#include "ircMessage.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Checks and times IrcMessage::parse/unescape against the chat corpus in
+// corpus/, e.g.
+//
+//   IrcParserBench --corpus tools/ircParserBench/corpus --fuzz 3000000
+//
+// runs the known-answer cases, parses every corpus line, mutates corpus
+// lines at random and checks what the parser makes of them (build with
+// ASan/UBSan for this part to mean much), then times the TwitchClient line
+// path against the getline/find code it replaced.
+
+namespace {
+std::atomic<std::uint64_t> g_allocations{0};
+}
+
+// Counts every allocation, so the benchmark can report allocations per line.
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+struct Options {
+    std::string corpus = "corpus";
+    std::uint64_t fuzz = 200000;
+    std::uint32_t seed = 1;
+    double seconds = 2.0;
+};
+
+void usage() {
+    std::cout <<
+        "usage: IrcParserBench [options]\n"
+        "  --corpus DIR      directory of *.txt corpus files, one IRC line each (corpus)\n"
+        "  --fuzz N          mutated lines to parse (200000, 0 = skip)\n"
+        "  --seed N          mutation seed (1)\n"
+        "  --seconds S       time per benchmark (2, 0 = skip)\n";
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            std::exit(0);
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--corpus") options.corpus = value;
+            else if (arg == "--fuzz") options.fuzz = std::stoull(value);
+            else if (arg == "--seed") options.seed = static_cast<std::uint32_t>(std::stoul(value));
+            else if (arg == "--seconds") options.seconds = std::stod(value);
+            else {
+                std::cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Bad value for " << arg << ": " << value << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+int g_failures = 0;
+
+void fail(std::string_view what, std::string_view line) {
+    if (++g_failures <= 20) std::cerr << "FAIL " << what << ": \"" << line << "\"\n";
+}
+
+// ---- known answers ----
+
+struct Expected {
+    std::string_view line;
+    bool ok;
+    std::string_view tags;
+    std::string_view prefix;
+    std::string_view command;
+    std::vector<std::string_view> params;
+};
+
+const std::vector<Expected>& knownAnswers() {
+    static const std::vector<Expected> cases = {
+        { "PING :tmi.twitch.tv\r", true, "", "", "PING", { "tmi.twitch.tv" } },
+        { "PING", true, "", "", "PING", {} },
+        { ":tmi.twitch.tv 001 bot :Welcome, GLHF!", true, "", "tmi.twitch.tv", "001", { "bot", "Welcome, GLHF!" } },
+        { "@display-name=Foo\\sBar;login=foo :foo!foo@foo.tmi.twitch.tv PRIVMSG #chan :!guess 12:30",
+            true, "display-name=Foo\\sBar;login=foo", "foo!foo@foo.tmi.twitch.tv", "PRIVMSG", { "#chan", "!guess 12:30" } },
+        { ":a!b@c PRIVMSG #x ::-)", true, "", "a!b@c", "PRIVMSG", { "#x", ":-)" } },
+        { ":a!b@c PRIVMSG #x :", true, "", "a!b@c", "PRIVMSG", { "#x", "" } },
+        { "CMD  a   b  :c  d  ", true, "", "", "CMD", { "a", "b", "c  d  " } },
+        { "   PRIVMSG #x :leading", true, "", "", "PRIVMSG", { "#x", "leading" } },
+        { "CMD 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16", true, "", "", "CMD",
+            { "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15 16" } },
+        { "CMD 1 2 3 4 5 6 7 8 9 10 11 12 13 14 :fifteen with spaces", true, "", "", "CMD",
+            { "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "fifteen with spaces" } },
+        { "", false, "", "", "", {} },
+        { "\r", false, "", "", "", {} },
+        { "@a=b", false, "a=b", "", "", {} },
+        { "@a=b :prefix", false, "a=b", "prefix", "", {} },
+        { ":prefix   ", false, "", "prefix", "", {} },
+    };
+    return cases;
+}
+
+void checkKnownAnswers() {
+    int checked = 0;
+    for (const Expected& e : knownAnswers()) {
+        IrcMessage msg;
+        bool ok = IrcMessage::parse(e.line, msg);
+        ++checked;
+        if (ok != e.ok) {
+            fail(ok ? "parsed, should fail" : "failed, should parse", e.line);
+            continue;
+        }
+        if (msg.tags != e.tags) fail("tags", e.line);
+        if (msg.prefix != e.prefix) fail("prefix", e.line);
+        if (msg.command != e.command) fail("command", e.line);
+        if (!ok) continue;
+        if (msg.paramCount != e.params.size()) {
+            fail("param count", e.line);
+            continue;
+        }
+        for (std::size_t i = 0; i < e.params.size(); ++i)
+            if (msg.param(i) != e.params[i]) fail("param", e.line);
+    }
+
+    IrcMessage msg;
+    IrcMessage::parse("@display-name=Foo\\sBar;login=foo;emotes=;flag :foo!x@y PRIVMSG #c :hi", msg);
+    ++checked;
+    if (msg.tag("display-name") != "Foo\\sBar" || msg.tag("login") != "foo" || msg.tag("emotes") != ""
+        || msg.tag("flag") != "" || msg.tag("missing") != "" || msg.tag("log") != "" || msg.nick() != "foo"
+        || msg.lastParam() != "hi" || msg.param(5) != "")
+        fail("tags/nick/params", "@display-name=Foo\\sBar;login=foo;emotes=;flag ...");
+
+    struct Unescaped { std::string_view raw; std::string_view out; };
+    static const Unescaped unescapes[] = {
+        { "plain", "plain" },
+        { "", "" },
+        { "Foo\\sBar", "Foo Bar" },
+        { "a\\:b\\s\\\\\\r\\n", "a;b \\\r\n" },
+        { "trailing\\", "trailing" },
+        { "\\q", "q" },
+        { "\\\\s", "\\s" },
+    };
+    std::string scratch;
+    for (const Unescaped& u : unescapes) {
+        ++checked;
+        if (IrcMessage::unescape(u.raw, scratch) != u.out) fail("unescape", u.raw);
+    }
+    std::cout << "known answers: " << checked << " cases\n";
+}
+
+// ---- corpus ----
+
+std::vector<std::string> loadCorpus(const std::string& dir) {
+    std::vector<std::filesystem::path> files;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec))
+        if (entry.path().extension() == ".txt") files.push_back(entry.path());
+    if (ec) std::cerr << "Can't read " << dir << ": " << ec.message() << "\n";
+    std::sort(files.begin(), files.end());
+
+    std::vector<std::string> lines;
+    for (const auto& path : files) {
+        std::ifstream in(path, std::ios::binary);
+        // Split on '\n' only, as TwitchClient does; parse() drops the '\r'.
+        for (std::string line; std::getline(in, line);)
+            if (!line.empty()) lines.push_back(line);
+    }
+    return lines;
+}
+
+// What every parse must satisfy, whatever the input.
+void checkInvariants(std::string_view line, std::string& scratch) {
+    IrcMessage msg;
+    bool ok = IrcMessage::parse(line, msg);
+    auto inside = [&](std::string_view v) {
+        return v.empty() || (v.data() >= line.data() && v.data() + v.size() <= line.data() + line.size());
+    };
+    if (!inside(msg.tags) || !inside(msg.prefix) || !inside(msg.command)) fail("view outside the line", line);
+    if (msg.tags.find(' ') != std::string_view::npos) fail("space in tags", line);
+    if (msg.prefix.find(' ') != std::string_view::npos) fail("space in prefix", line);
+    if (!ok) return;
+
+    if (msg.command.empty() || msg.command.find(' ') != std::string_view::npos) fail("bad command", line);
+    if (msg.paramCount > IrcMessage::kMaxParams) {
+        fail("too many params", line);
+        return;
+    }
+    for (std::size_t i = 0; i < msg.paramCount; ++i) {
+        std::string_view p = msg.param(i);
+        if (!inside(p)) fail("param outside the line", line);
+        bool last = i + 1 == msg.paramCount;
+        if (!last && (p.empty() || p.find(' ') != std::string_view::npos)) fail("bad middle param", line);
+    }
+
+    // Everything TwitchClient reads off a chat line.
+    for (std::string_view key : { "display-name", "login", "id", "" }) {
+        std::string_view value = msg.tag(key);
+        if (!inside(value)) fail("tag outside the line", line);
+        std::string_view name = IrcMessage::unescape(value, scratch);
+        if (name.size() > value.size()) fail("unescape grew", line);
+    }
+    if (!inside(msg.nick()) || !inside(msg.lastParam())) fail("nick/lastParam outside the line", line);
+}
+
+std::string mutate(const std::vector<std::string>& corpus, std::mt19937& rng) {
+    static const char kInteresting[] = { ' ', ':', '@', ';', '=', '\\', '\r', '\n', '!', '\0', 's', '#' };
+    auto pick = [&](std::size_t n) { return static_cast<std::size_t>(rng() % (n ? n : 1)); };
+
+    std::string line = corpus[pick(corpus.size())];
+    int edits = 1 + static_cast<int>(rng() % 8);
+    for (int i = 0; i < edits; ++i) {
+        std::size_t at = pick(line.size() + 1);
+        switch (rng() % 6) {
+        case 0: line.insert(at, 1, kInteresting[pick(sizeof(kInteresting))]); break;
+        case 1: if (at < line.size()) line[at] = static_cast<char>(rng()); break;
+        case 2: line.erase(at, pick(16)); break;
+        case 3: line.insert(at, std::string(1 + pick(32), kInteresting[pick(sizeof(kInteresting))])); break;
+        case 4: line = line.substr(0, at); break;
+        case 5: {
+            const std::string& other = corpus[pick(corpus.size())];
+            std::size_t from = pick(other.size() + 1);
+            line.insert(at, other, from, pick(other.size() - from + 1));
+            break;
+        }
+        }
+    }
+    return line;
+}
+
+void fuzz(const std::vector<std::string>& corpus, const Options& options) {
+    std::string scratch;
+    for (const std::string& line : corpus) checkInvariants(line, scratch);
+    if (options.fuzz == 0 || corpus.empty()) return;
+
+    std::mt19937 rng(options.seed);
+    for (std::uint64_t n = 0; n < options.fuzz; ++n) {
+        std::string line = mutate(corpus, rng);
+        // An exact-size copy, so a sanitizer sees any read past the end.
+        std::unique_ptr<char[]> exact(new char[line.size() ? line.size() : 1]);
+        std::copy(line.begin(), line.end(), exact.get());
+        checkInvariants(std::string_view(exact.get(), line.size()), scratch);
+    }
+    std::cout << "fuzz: " << corpus.size() << " corpus lines, " << options.fuzz
+        << " mutated lines, seed " << options.seed << "\n";
+}
+
+// ---- benchmark ----
+
+// The corpus as one read buffer, lines ending in "\r\n" like Twitch sends.
+std::string buildBuffer(const std::vector<std::string>& corpus) {
+    std::string buffer;
+    for (std::string line : corpus) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        buffer += line;
+        buffer += "\r\n";
+    }
+    return buffer;
+}
+
+// The per-line work TwitchClient::handleLine does, without the logging and
+// the game: parse in place, then copy out channel, user and text.
+struct InPlacePath {
+    std::string tagScratch, channel, user, text;
+    std::size_t sink = 0;
+
+    void pass(std::string_view pending) {
+        for (std::size_t consumed = 0, eol; (eol = pending.find('\n', consumed)) != std::string_view::npos; consumed = eol + 1) {
+            IrcMessage msg;
+            if (!IrcMessage::parse(pending.substr(consumed, eol - consumed), msg)) continue;
+            if (msg.command == "PING" || msg.command == "001" || msg.paramCount == 0) {
+                sink += msg.command.size();
+                continue;
+            }
+            channel.assign(msg.param(0));
+            if (msg.command == "PRIVMSG" && msg.paramCount >= 2) {
+                std::string_view username = IrcMessage::unescape(msg.tag("display-name"), tagScratch);
+                if (username.empty()) username = msg.tag("login");
+                if (username.empty()) username = msg.nick();
+                user.assign(username);
+                text.assign(msg.lastParam());
+                sink += user.size() + text.size() + channel.size();
+            }
+        }
+    }
+};
+
+// The getline/find/substr code TwitchClient::doRead had before the parser.
+struct GetlinePath {
+    std::size_t sink = 0;
+
+    void pass(const std::string& buffer) {
+        std::istringstream is(buffer);
+        std::string line;
+        while (std::getline(is, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+            if (line.rfind("PING", 0) == 0) {
+                ++sink;
+                continue;
+            }
+            if (line.find(" 001 ") != std::string::npos) {
+                ++sink;
+                continue;
+            }
+            if (line.find("PRIVMSG") != std::string::npos) {
+                std::string username;
+                if (line[0] == '@') {
+                    size_t dnPos = line.find("display-name=");
+                    if (dnPos != std::string::npos) {
+                        size_t end = line.find(';', dnPos);
+                        if (end == std::string::npos) end = line.find(' ', dnPos);
+                        if (end != std::string::npos)
+                            username = line.substr(dnPos + 13, end - (dnPos + 13));
+                    }
+                    if (username.empty()) {
+                        size_t loginPos = line.find("login=");
+                        if (loginPos != std::string::npos) {
+                            size_t end = line.find(';', loginPos);
+                            if (end == std::string::npos) end = line.find(' ', loginPos);
+                            if (end != std::string::npos)
+                                username = line.substr(loginPos + 6, end - (loginPos + 6));
+                        }
+                    }
+                }
+                if (username.empty()) {
+                    size_t exMark = line.find('!');
+                    if (exMark != std::string::npos && exMark > 1)
+                        username = line.substr(1, exMark - 1);
+                }
+                std::string message;
+                size_t lastColon = line.rfind(':');
+                if (lastColon != std::string::npos)
+                    message = line.substr(lastColon + 1);
+                sink += username.size() + message.size();
+            }
+        }
+    }
+};
+
+template <class Pass>
+void timePath(const char* name, const std::string& buffer, std::size_t lines, double seconds, Pass&& pass) {
+    pass(); // warm up, and let the reused strings grow
+    using clock = std::chrono::steady_clock;
+    std::uint64_t allocationsBefore = g_allocations.load(std::memory_order_relaxed);
+    std::uint64_t passes = 0;
+    auto started = clock::now();
+    double elapsed = 0;
+    do {
+        for (int i = 0; i < 16; ++i) pass();
+        passes += 16;
+        elapsed = std::chrono::duration<double>(clock::now() - started).count();
+    } while (elapsed < seconds);
+    std::uint64_t allocations = g_allocations.load(std::memory_order_relaxed) - allocationsBefore;
+
+    double total = static_cast<double>(passes) * static_cast<double>(lines);
+    char out[200];
+    std::snprintf(out, sizeof(out), "%-9s %8.2f M lines/s %8.1f MB/s %6.2f allocations/line",
+        name, total / elapsed / 1e6, static_cast<double>(passes) * static_cast<double>(buffer.size()) / elapsed / 1e6,
+        static_cast<double>(allocations) / total);
+    std::cout << out << "\n";
+}
+
+void bench(const std::vector<std::string>& corpus, const Options& options) {
+    if (options.seconds <= 0 || corpus.empty()) return;
+    std::string buffer = buildBuffer(corpus);
+    std::cout << "bench: " << corpus.size() << " lines, " << buffer.size() << " bytes a pass\n";
+
+    InPlacePath inPlace;
+    timePath("in place", buffer, corpus.size(), options.seconds, [&]() { inPlace.pass(buffer); });
+    GetlinePath getline;
+    timePath("getline", buffer, corpus.size(), options.seconds, [&]() { getline.pass(buffer); });
+    if (inPlace.sink == 0 || getline.sink == 0) std::cout << "(nothing parsed)\n";
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    checkKnownAnswers();
+    std::vector<std::string> corpus = loadCorpus(options.corpus);
+    if (corpus.empty()) std::cerr << "No corpus lines under " << options.corpus << "\n";
+    fuzz(corpus, options);
+    if (g_failures) {
+        std::cerr << g_failures << " failures\n";
+        return 1;
+    }
+    bench(corpus, options);
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include "latencyProbe.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+const char kSpawnNick[] = "standinbot";
+const char kSpawnOauth[] = "oauth:standin";
+const std::chrono::seconds kForgetAfter{ 30 };
+
+std::string spawnedChannel(unsigned i) {
+    return "#loadgen" + std::to_string(i);
+}
+}
+
+LatencyProbe::LatencyProbe(boost::asio::io_context& io, const StandInOptions& options)
+    : m_options(options),
+    m_resolver(io),
+    m_ws(io) {
+    m_channel = options.spawn ? spawnedChannel(0) : options.channel;
+    std::transform(m_channel.begin(), m_channel.end(), m_channel.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (!m_channel.empty() && m_channel[0] != '#') m_channel.insert(m_channel.begin(), '#');
+}
+
+void LatencyProbe::start() {
+    if (m_channel.empty()) {
+        std::cerr << "probe: no channel to time (--spawn or --channel)\n";
+        return;
+    }
+    connect();
+}
+
+void LatencyProbe::connect() {
+    m_resolver.async_resolve(m_options.wsHost, m_options.wsPort,
+        [this](boost::system::error_code ec, boost::asio::ip::tcp::resolver::results_type endpoints) {
+            if (ec) {
+                if (!m_stopping) std::cerr << "probe: resolve " << m_options.wsHost << ": " << ec.message() << "\n";
+                return;
+            }
+            boost::asio::async_connect(m_ws.next_layer(), endpoints,
+                [this](boost::system::error_code ec, const auto&) {
+                    if (ec) {
+                        if (!m_stopping) std::cerr << "probe: connect: " << ec.message() << "\n";
+                        return;
+                    }
+                    m_ws.async_handshake(m_options.wsHost + ":" + m_options.wsPort, "/",
+                        [this](boost::system::error_code ec) {
+                            if (ec) {
+                                if (!m_stopping) std::cerr << "probe: handshake: " << ec.message() << "\n";
+                                return;
+                            }
+                            for (unsigned i = 0; i < m_options.spawn; ++i) {
+                                send(json{ {"type","spawn_bot"}, {"oauth",kSpawnOauth}, {"nick",kSpawnNick},
+                                    {"channel",spawnedChannel(i)} }.dump());
+                            }
+                            // The server keys rooms to channels without the '#'.
+                            send(json{ {"type","join"}, {"room",m_room}, {"channel",m_channel.substr(1)},
+                                {"payload","latency-probe"} }.dump());
+                            startRound();
+                            m_ready = true;
+                            doRead();
+                        });
+                });
+        });
+}
+
+void LatencyProbe::startRound() {
+    send(json{ {"type","start_round"}, {"room",m_room}, {"payload", {{"word",m_options.word}}} }.dump());
+}
+
+void LatencyProbe::stop() {
+    if (m_stopping) return;
+    m_stopping = true;
+    m_resolver.cancel();
+    if (!m_ready) {
+        boost::system::error_code ec;
+        m_ws.next_layer().close(ec);
+        return;
+    }
+    m_ready = false;
+    for (unsigned i = 0; i < m_options.spawn; ++i)
+        send(json{ {"type","stop_bot"}, {"channel",spawnedChannel(i)} }.dump());
+    if (!m_writing) doWrite(); // nothing queued: close now
+}
+
+void LatencyProbe::doRead() {
+    m_ws.async_read(m_buffer, [this](boost::system::error_code ec, std::size_t bytes) {
+        if (ec) {
+            if (!m_stopping) std::cerr << "probe: read: " << ec.message() << "\n";
+            m_ready = false;
+            return;
+        }
+        handleMessage(std::string_view(static_cast<const char*>(m_buffer.data().data()), bytes));
+        m_buffer.consume(bytes);
+        doRead();
+    });
+}
+
+void LatencyProbe::handleMessage(std::string_view text) {
+    json j = json::parse(text.begin(), text.end(), nullptr, false);
+    if (!j.is_object()) return;
+    std::string type = j.value("type", "");
+
+    if (type == "guesses") {
+        auto now = Clock::now();
+        const json& payload = j.value("payload", json::object());
+        for (const char* list : { "recent", "close" }) {
+            auto it = payload.find(list);
+            if (it == payload.end() || !it->is_array()) continue;
+            for (const auto& guess : *it) {
+                if (guess.is_object()) sample(guess.value("word", ""), now);
+            }
+        }
+    }
+    else if (type == "round_end" && !m_stopping) {
+        // Keep guesses flowing into an active round.
+        startRound();
+    }
+}
+
+void LatencyProbe::sample(std::string_view word, Clock::time_point now) {
+    if (word.size() < 3 || word.substr(0, 2) != "lg") return;
+    std::uint64_t seq = 0;
+    for (char c : word.substr(2)) {
+        if (c < '0' || c > '9') return;
+        seq = seq * 10 + static_cast<std::uint64_t>(c - '0');
+    }
+    auto it = m_sent.find(seq);
+    if (it == m_sent.end()) return; // already seen, in an earlier summary
+    m_samples.push_back(std::chrono::duration<double, std::milli>(now - it->second).count());
+    m_sent.erase(it);
+}
+
+std::vector<double> LatencyProbe::takeSamples() {
+    auto cutoff = Clock::now() - kForgetAfter;
+    for (auto it = m_sent.begin(); it != m_sent.end();) {
+        if (it->second < cutoff) it = m_sent.erase(it);
+        else ++it;
+    }
+    std::vector<double> out;
+    out.swap(m_samples);
+    return out;
+}
+
+void LatencyProbe::send(std::string text) {
+    m_outbox.push_back(std::move(text));
+    if (!m_writing) doWrite();
+}
+
+void LatencyProbe::doWrite() {
+    if (m_outbox.empty()) {
+        if (m_stopping) {
+            m_ws.async_close(boost::beast::websocket::close_code::normal, [](boost::system::error_code) {});
+        }
+        return;
+    }
+    m_writing = true;
+    m_ws.text(true);
+    m_ws.async_write(boost::asio::buffer(m_outbox.front()), [this](boost::system::error_code ec, std::size_t) {
+        m_writing = false;
+        m_outbox.pop_front();
+        if (ec) {
+            std::cerr << "probe: write: " << ec.message() << "\n";
+            m_outbox.clear();
+            return;
+        }
+        doWrite();
+    });
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "standInOptions.h"
+
+// Times chat lines through the game server. Joins a room mapped to the
+// timed channel over WebSocket and keeps a round running in it; guesses
+// sent there carry a sequence number in the word ("lg123"), and the
+// server's "guesses" summaries name some of them back. Only the summary's
+// recent and close lists are visible, so this samples rather than counts.
+//
+// Runs on the io_context's single thread, like StandInServer.
+class LatencyProbe {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    LatencyProbe(boost::asio::io_context& io, const StandInOptions& options);
+
+    void start();
+    // stop_bot for the spawned channels, then close.
+    void stop();
+
+    // "#name" whose guesses are timed.
+    const std::string& channel() const { return m_channel; }
+    bool ready() const { return m_ready; }
+    // A timed guess went out in the probe's channel.
+    void sent(std::uint64_t seq, Clock::time_point at) { m_sent.emplace(seq, at); }
+
+    // Latencies in ms seen since the last call. Guesses not seen within
+    // 30 s are forgotten.
+    std::vector<double> takeSamples();
+
+    static std::string guessWord(std::uint64_t seq) { return "lg" + std::to_string(seq); }
+
+private:
+    void connect();
+    void doRead();
+    void handleMessage(std::string_view text);
+    void sample(std::string_view word, Clock::time_point now);
+    void send(std::string text);
+    void doWrite();
+    void startRound();
+
+    const StandInOptions& m_options;
+    boost::asio::ip::tcp::resolver m_resolver;
+    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> m_ws;
+    boost::beast::flat_buffer m_buffer;
+    std::deque<std::string> m_outbox;
+    bool m_writing = false;
+    bool m_ready = false;
+    bool m_stopping = false;
+
+    std::string m_channel;
+    std::string m_room = "loadgen";
+    std::unordered_map<std::uint64_t, Clock::time_point> m_sent;
+    std::vector<double> m_samples;
+};
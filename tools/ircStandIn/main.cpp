@@ -0,0 +1,190 @@
+#include "latencyProbe.h"
+#include "standInServer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Local stand-in for irc.chat.twitch.tv with a chat load generator, so
+// Twitch ingestion can be benchmarked without Twitch. Point the game server
+// at it with TWITCH_IRC_HOST / TWITCH_IRC_PORT, then e.g.
+//
+//   IrcStandIn --rate 2000 --users 5000 --ws 127.0.0.1:9001 --spawn 50
+//
+// spawns 50 bots through the game server, pushes 2000 chat lines a second
+// across their channels and reports chat-to-broadcast latency.
+
+namespace {
+void usage() {
+    std::cout <<
+        "usage: IrcStandIn [options]\n"
+        "  --bind ADDR            listen address (127.0.0.1)\n"
+        "  --port N               listen port (6667)\n"
+        "  --rate N               chat lines per second over all channels (100)\n"
+        "  --users N              distinct chatters (1000)\n"
+        "  --command-mix F        share of lines that are !join (0.05)\n"
+        "  --bang-mix F           share of guesses sent as \"!guess word\" (0.5)\n"
+        "  --replay FILE          replay \"user: text\" lines instead of synthesizing\n"
+        "  --ping-every S         PING every connection (60)\n"
+        "  --reconnect-every S    send RECONNECT to every connection (0 = never)\n"
+        "  --reconnect-grace S    then close them after this long (5)\n"
+        "  --drop-every S         close one random connection without warning (0 = never)\n"
+        "  --ws HOST:PORT         game server to time chat through (off)\n"
+        "  --spawn N              spawn bots for #loadgen0..N-1 there and time #loadgen0\n"
+        "  --channel NAME         otherwise time this already-spawned channel\n"
+        "  --word WORD            the probe room's secret word (zebra)\n"
+        "  --duration S           stop after this long (0 = on Ctrl+C)\n"
+        "  --report S             report interval (5)\n";
+}
+
+bool parseArgs(int argc, char** argv, StandInOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            std::exit(0);
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            auto seconds = [&]() { return std::chrono::seconds(std::stol(value)); };
+            if (arg == "--bind") options.bind = value;
+            else if (arg == "--port") options.port = static_cast<unsigned short>(std::stoul(value));
+            else if (arg == "--rate") options.rate = std::stod(value);
+            else if (arg == "--users") options.users = static_cast<unsigned>(std::stoul(value));
+            else if (arg == "--command-mix") options.commandMix = std::stod(value);
+            else if (arg == "--bang-mix") options.bangMix = std::stod(value);
+            else if (arg == "--replay") options.replayFile = value;
+            else if (arg == "--ping-every") options.pingEvery = seconds();
+            else if (arg == "--reconnect-every") options.reconnectEvery = seconds();
+            else if (arg == "--reconnect-grace") options.reconnectGrace = seconds();
+            else if (arg == "--drop-every") options.dropEvery = seconds();
+            else if (arg == "--ws") {
+                std::size_t colon = value.rfind(':');
+                options.wsHost = value.substr(0, colon);
+                if (colon != std::string::npos) options.wsPort = value.substr(colon + 1);
+            }
+            else if (arg == "--spawn") options.spawn = static_cast<unsigned>(std::stoul(value));
+            else if (arg == "--channel") options.channel = value;
+            else if (arg == "--word") options.word = value;
+            else if (arg == "--duration") options.duration = seconds();
+            else if (arg == "--report") options.reportEvery = seconds();
+            else {
+                std::cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Bad value for " << arg << ": " << value << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Latency percentiles over one batch of samples, in ms.
+std::string summarize(std::vector<double> samples) {
+    if (samples.empty()) return "no samples";
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double q) { return samples[static_cast<std::size_t>(q * static_cast<double>(samples.size() - 1))]; };
+    char out[160];
+    std::snprintf(out, sizeof(out), "n=%zu p50=%.1fms p90=%.1fms p99=%.1fms max=%.1fms",
+        samples.size(), at(0.5), at(0.9), at(0.99), samples.back());
+    return out;
+}
+}
+
+int main(int argc, char** argv) {
+    StandInOptions options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    boost::asio::io_context io;
+    std::unique_ptr<LatencyProbe> probe;
+    if (!options.wsHost.empty()) probe = std::make_unique<LatencyProbe>(io, options);
+    StandInServer server(io, options, probe.get());
+    if (!server.start()) return 1;
+    if (probe) probe->start();
+    std::cout << "IRC stand-in listening on " << options.bind << ":" << options.port
+        << ", " << options.rate << " lines/s\n";
+
+    std::vector<double> allSamples;
+    StandInStats last;
+    auto started = std::chrono::steady_clock::now();
+    auto lastReport = started;
+
+    auto report = [&]() {
+        auto now = std::chrono::steady_clock::now();
+        double secs = std::max(1e-3, std::chrono::duration<double>(now - lastReport).count());
+        lastReport = now;
+        const StandInStats& s = server.stats();
+        std::vector<double> samples = probe ? probe->takeSamples() : std::vector<double>();
+        allSamples.insert(allSamples.end(), samples.begin(), samples.end());
+
+        char line[256];
+        std::snprintf(line, sizeof(line),
+            "conns=%zu channels=%zu chat=%.0f/s out=%.0f lines/s %.1f KB/s from bots=%.0f lines/s",
+            s.connections, s.channels,
+            static_cast<double>(s.chatLines - last.chatLines) / secs,
+            static_cast<double>(s.linesOut - last.linesOut) / secs,
+            static_cast<double>(s.bytesOut - last.bytesOut) / secs / 1024.0,
+            static_cast<double>(s.botLines - last.botLines) / secs);
+        std::cout << line;
+        if (probe) std::cout << " | latency " << summarize(std::move(samples));
+        std::cout << "\n";
+        last = s;
+    };
+
+    boost::asio::steady_timer reportTimer(io);
+    std::function<void()> scheduleReport = [&]() {
+        reportTimer.expires_after(std::max(std::chrono::seconds(1), options.reportEvery));
+        reportTimer.async_wait([&](boost::system::error_code ec) {
+            if (ec) return;
+            report();
+            scheduleReport();
+        });
+    };
+    scheduleReport();
+
+    boost::asio::steady_timer durationTimer(io);
+    boost::asio::signal_set signals(io, SIGINT, SIGTERM);
+    auto shutdown = [&]() {
+        signals.cancel();
+        durationTimer.cancel();
+        reportTimer.cancel();
+        server.stop();
+        if (probe) probe->stop();
+    };
+    signals.async_wait([&](boost::system::error_code ec, int) {
+        if (!ec) shutdown();
+    });
+    if (options.duration.count() > 0) {
+        durationTimer.expires_after(options.duration);
+        durationTimer.async_wait([&](boost::system::error_code ec) {
+            if (!ec) shutdown();
+        });
+    }
+
+    io.run();
+
+    report();
+    const StandInStats& s = server.stats();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::cout << "\nRan " << static_cast<long>(secs) << " s: " << s.chatLines << " chat lines, "
+        << s.linesOut << " lines / " << s.bytesOut << " bytes out, " << s.botLines << " lines from bots\n"
+        << "Bots: " << s.joins << " JOINs (" << s.joinsOverLimit << " over Twitch's limit), "
+        << s.botChat << " PRIVMSGs (" << s.chatOverLimit << " over)\n"
+        << "Faults: " << s.reconnectsSent << " RECONNECTs, " << s.dropped << " drops, "
+        << s.slowClosed << " slow consumers closed\n";
+    if (probe) std::cout << "Latency, chat line to room broadcast: " << summarize(std::move(allSamples)) << "\n";
+    return 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+// Command line of the IRC stand-in; see usage() in main.cpp. Point the game
+// server at it with TWITCH_IRC_HOST and TWITCH_IRC_PORT in config.json.
+struct StandInOptions {
+    // IRC side
+    std::string bind = "127.0.0.1";
+    unsigned short port = 6667;
+    std::chrono::seconds pingEvery{ 60 };
+    // Every connection is sent RECONNECT, then closed after the grace
+    // period; 0 turns it off.
+    std::chrono::seconds reconnectEvery{ 0 };
+    std::chrono::seconds reconnectGrace{ 5 };
+    // One random connection is closed without warning; 0 turns it off.
+    std::chrono::seconds dropEvery{ 0 };
+    // A bot that falls this far behind is disconnected, as Twitch would.
+    std::size_t maxQueuedBytes = 8 * 1024 * 1024;
+
+    // Chat, spread round-robin over every joined channel
+    double rate = 100;        // lines per second
+    unsigned users = 1000;    // distinct chatters
+    double commandMix = 0.05; // share of lines that are "!join"
+    double bangMix = 0.5;     // share of guesses sent as "!guess word" rather than bare
+    std::string replayFile;   // "user: text" per line, replayed in a loop instead
+
+    // Latency probe: a WebSocket client of the game server that maps a room
+    // to a channel, keeps a round running there and times guesses from chat
+    // line to "guesses" broadcast. Off unless wsHost is set.
+    std::string wsHost;
+    std::string wsPort = "9001";
+    unsigned spawn = 0;       // spawn_bot for #loadgen0..n-1; the probe times #loadgen0
+    std::string channel;      // otherwise the channel to time, e.g. the server's TWITCH_CHANNEL
+    std::string word = "zebra";
+
+    std::chrono::seconds duration{ 0 }; // 0 runs until Ctrl+C
+    std::chrono::seconds reportEvery{ 5 };
+};
@@ -0,0 +1,389 @@
+#include "standInServer.h"
+#include "latencyProbe.h"
+#include "ircMessage.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+
+namespace {
+const char kServer[] = "tmi.twitch.tv";
+const std::chrono::milliseconds kTick{ 10 };
+// Twitch's limits for a regular user: 20 JOINs per 10 s, 20 PRIVMSGs per 30 s.
+const std::size_t kJoinLimit = 20;
+const std::chrono::seconds kJoinWindow{ 10 };
+const std::size_t kChatLimit = 20;
+const std::chrono::seconds kChatWindow{ 30 };
+
+std::string lower(std::string_view s) {
+    std::string out(s);
+    std::transform(out.begin(), out.end(), out.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return out;
+}
+
+// True if this send puts the window past limit.
+bool overLimit(std::deque<std::chrono::steady_clock::time_point>& sends,
+    std::chrono::steady_clock::time_point now, std::size_t limit, std::chrono::seconds window) {
+    while (!sends.empty() && now - sends.front() >= window) sends.pop_front();
+    sends.push_back(now);
+    return sends.size() > limit;
+}
+}
+
+StandInServer::StandInServer(boost::asio::io_context& io, const StandInOptions& options, LatencyProbe* probe)
+    : m_io(io),
+    m_options(options),
+    m_probe(probe),
+    m_acceptor(io),
+    m_tickTimer(io),
+    m_pingTimer(io),
+    m_reconnectTimer(io),
+    m_dropTimer(io) {
+}
+
+bool StandInServer::start() {
+    if (!m_options.replayFile.empty()) {
+        std::ifstream in(m_options.replayFile);
+        if (!in) {
+            std::cerr << "Cannot open replay file " << m_options.replayFile << "\n";
+            return false;
+        }
+        for (std::string line; std::getline(in, line);) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            std::size_t colon = line.find(": ");
+            if (colon == std::string::npos || colon == 0) continue;
+            m_replay.emplace_back(line.substr(0, colon), line.substr(colon + 2));
+        }
+        if (m_replay.empty()) {
+            std::cerr << "No \"user: text\" lines in " << m_options.replayFile << "\n";
+            return false;
+        }
+    }
+
+    boost::system::error_code ec;
+    boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::make_address(m_options.bind, ec), m_options.port);
+    if (!ec) m_acceptor.open(endpoint.protocol(), ec);
+    if (!ec) m_acceptor.set_option(boost::asio::socket_base::reuse_address(true), ec);
+    if (!ec) m_acceptor.bind(endpoint, ec);
+    if (!ec) m_acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
+    if (ec) {
+        std::cerr << "Cannot listen on " << m_options.bind << ":" << m_options.port << ": " << ec.message() << "\n";
+        return false;
+    }
+
+    doAccept();
+    m_lastTick = std::chrono::steady_clock::now();
+    tick();
+    every(m_pingTimer, m_options.pingEvery, &StandInServer::pingAll);
+    every(m_reconnectTimer, m_options.reconnectEvery, &StandInServer::reconnectAll);
+    every(m_dropTimer, m_options.dropEvery, &StandInServer::dropOne);
+    return true;
+}
+
+void StandInServer::stop() {
+    if (m_stopped) return;
+    m_stopped = true;
+    boost::system::error_code ec;
+    m_acceptor.close(ec);
+    m_tickTimer.cancel();
+    m_pingTimer.cancel();
+    m_reconnectTimer.cancel();
+    m_dropTimer.cancel();
+    for (ConnPtr conn : std::vector<ConnPtr>(m_conns)) close(conn);
+}
+
+const StandInStats& StandInServer::stats() {
+    m_stats.connections = m_conns.size();
+    m_stats.channels = m_members.size();
+    return m_stats;
+}
+
+void StandInServer::every(boost::asio::steady_timer& timer, std::chrono::seconds period, void (StandInServer::*fn)()) {
+    if (period.count() <= 0 || m_stopped) return;
+    timer.expires_after(period);
+    timer.async_wait([this, &timer, period, fn](boost::system::error_code ec) {
+        if (ec || m_stopped) return;
+        (this->*fn)();
+        every(timer, period, fn);
+    });
+}
+
+void StandInServer::doAccept() {
+    m_acceptor.async_accept([this](boost::system::error_code ec, boost::asio::ip::tcp::socket socket) {
+        if (m_stopped) return;
+        if (!ec) {
+            socket.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+            auto conn = std::make_shared<Conn>(std::move(socket));
+            m_conns.push_back(conn);
+            doRead(conn);
+        }
+        doAccept();
+    });
+}
+
+void StandInServer::doRead(const ConnPtr& conn) {
+    boost::asio::async_read_until(conn->socket, conn->buffer, "\n",
+        [this, conn](boost::system::error_code ec, std::size_t) {
+            if (conn->closed) return;
+            if (ec) {
+                close(conn);
+                return;
+            }
+            auto data = conn->buffer.data();
+            std::string_view pending(static_cast<const char*>(data.data()), data.size());
+            std::size_t consumed = 0;
+            for (std::size_t eol; !conn->closed && (eol = pending.find('\n', consumed)) != std::string_view::npos; consumed = eol + 1) {
+                IrcMessage msg;
+                ++m_stats.botLines;
+                if (IrcMessage::parse(pending.substr(consumed, eol - consumed), msg)) handleLine(conn, msg);
+            }
+            if (conn->closed) return;
+            conn->buffer.consume(consumed);
+            doRead(conn);
+        });
+}
+
+void StandInServer::handleLine(const ConnPtr& conn, const IrcMessage& msg) {
+    if (msg.command == "CAP") {
+        if (msg.param(0) == "REQ") {
+            std::string_view caps = msg.lastParam();
+            conn->tags = caps.find("twitch.tv/tags") != std::string_view::npos;
+            queue(conn, ":" + std::string(kServer) + " CAP * ACK :" + std::string(caps));
+        }
+        else if (msg.param(0) == "LS") {
+            queue(conn, ":" + std::string(kServer) + " CAP * LS :twitch.tv/tags twitch.tv/commands twitch.tv/membership");
+        }
+        return;
+    }
+    if (msg.command == "PASS") return; // any token will do
+    if (msg.command == "NICK") {
+        if (conn->welcomed) return;
+        conn->nick = lower(msg.param(0));
+        conn->welcomed = true;
+        const std::string& n = conn->nick;
+        std::string head = ":" + std::string(kServer) + " ";
+        queue(conn, head + "001 " + n + " :Welcome, GLHF!");
+        queue(conn, head + "002 " + n + " :Your host is tmi.twitch.tv");
+        queue(conn, head + "003 " + n + " :This server is rather new");
+        queue(conn, head + "004 " + n + " :-");
+        queue(conn, head + "375 " + n + " :-");
+        queue(conn, head + "372 " + n + " :You are in a maze of twisty passages, all alike.");
+        queue(conn, head + "376 " + n + " :>");
+        return;
+    }
+    if (msg.command == "PING") {
+        queue(conn, ":" + std::string(kServer) + " PONG " + kServer + " :" + std::string(msg.lastParam()));
+        return;
+    }
+    if (msg.command == "PONG") return;
+    if (msg.command == "QUIT") {
+        close(conn);
+        return;
+    }
+    if (!conn->welcomed) return;
+
+    if (msg.command == "JOIN" || msg.command == "PART") {
+        // "JOIN #a,#b"
+        std::string_view list = msg.param(0);
+        while (!list.empty()) {
+            std::size_t comma = list.find(',');
+            std::string channel = lower(list.substr(0, comma));
+            list.remove_prefix(comma == std::string_view::npos ? list.size() : comma + 1);
+            if (channel.size() < 2 || channel[0] != '#') continue;
+            if (msg.command == "JOIN") join(conn, channel);
+            else part(conn, channel);
+        }
+        return;
+    }
+    if (msg.command == "PRIVMSG") {
+        ++m_stats.botChat;
+        if (overLimit(m_windows[conn->nick].chat, std::chrono::steady_clock::now(), kChatLimit, kChatWindow))
+            ++m_stats.chatOverLimit;
+        return;
+    }
+}
+
+void StandInServer::join(const ConnPtr& conn, const std::string& channel) {
+    ++m_stats.joins;
+    if (overLimit(m_windows[conn->nick].joins, std::chrono::steady_clock::now(), kJoinLimit, kJoinWindow))
+        ++m_stats.joinsOverLimit;
+    if (std::find(conn->channels.begin(), conn->channels.end(), channel) != conn->channels.end()) return;
+
+    conn->channels.push_back(channel);
+    auto& members = m_members[channel];
+    if (members.empty()) m_channelOrder.push_back(channel);
+    members.push_back(conn);
+
+    const std::string& n = conn->nick;
+    queue(conn, ":" + n + "!" + n + "@" + n + ".tmi.twitch.tv JOIN " + channel);
+    queue(conn, ":" + n + ".tmi.twitch.tv 353 " + n + " = " + channel + " :" + n);
+    queue(conn, ":" + n + ".tmi.twitch.tv 366 " + n + " " + channel + " :End of /NAMES list");
+    if (conn->tags) {
+        queue(conn, "@emote-only=0;followers-only=-1;r9k=0;room-id=1;slow=0;subs-only=0 :"
+            + std::string(kServer) + " ROOMSTATE " + channel);
+    }
+}
+
+void StandInServer::part(const ConnPtr& conn, const std::string& channel) {
+    auto mine = std::find(conn->channels.begin(), conn->channels.end(), channel);
+    if (mine == conn->channels.end()) return;
+    conn->channels.erase(mine);
+
+    auto it = m_members.find(channel);
+    if (it != m_members.end()) {
+        auto& members = it->second;
+        members.erase(std::remove(members.begin(), members.end(), conn), members.end());
+        if (members.empty()) {
+            m_members.erase(it);
+            m_channelOrder.erase(std::remove(m_channelOrder.begin(), m_channelOrder.end(), channel), m_channelOrder.end());
+        }
+    }
+    if (!conn->closed) {
+        const std::string& n = conn->nick;
+        queue(conn, ":" + n + "!" + n + "@" + n + ".tmi.twitch.tv PART " + channel);
+    }
+}
+
+void StandInServer::queue(const ConnPtr& conn, std::string_view line) {
+    if (conn->closed || conn->slow) return;
+    conn->pending.append(line);
+    conn->pending.append("\r\n");
+    ++m_stats.linesOut;
+    flush(conn);
+}
+
+void StandInServer::flush(const ConnPtr& conn) {
+    if (conn->writing || conn->pending.empty() || conn->closed || conn->slow) return;
+    if (conn->pending.size() > m_options.maxQueuedBytes) {
+        std::cerr << "Closing " << conn->nick << ": " << conn->pending.size() << " bytes behind\n";
+        ++m_stats.slowClosed;
+        // Not now: the caller may be walking a channel's members.
+        conn->slow = true;
+        boost::asio::post(m_io, [this, conn]() { close(conn); });
+        return;
+    }
+    // Everything queued since the last write goes out in one.
+    conn->inflight.clear();
+    conn->inflight.swap(conn->pending);
+    conn->writing = true;
+    boost::asio::async_write(conn->socket, boost::asio::buffer(conn->inflight),
+        [this, conn](boost::system::error_code ec, std::size_t bytes) {
+            conn->writing = false;
+            if (conn->closed) return;
+            if (ec) {
+                close(conn);
+                return;
+            }
+            m_stats.bytesOut += bytes;
+            flush(conn);
+        });
+}
+
+void StandInServer::close(const ConnPtr& conn) {
+    if (conn->closed) return;
+    conn->closed = true;
+    for (const std::string& channel : std::vector<std::string>(conn->channels)) part(conn, channel);
+    boost::system::error_code ec;
+    conn->socket.close(ec);
+    m_conns.erase(std::remove(m_conns.begin(), m_conns.end(), conn), m_conns.end());
+}
+
+void StandInServer::tick() {
+    auto now = std::chrono::steady_clock::now();
+    m_credit += m_options.rate * std::chrono::duration<double>(now - m_lastTick).count();
+    m_lastTick = now;
+    auto lines = static_cast<std::size_t>(m_credit);
+    m_credit -= static_cast<double>(lines);
+    // Nobody listening: the lines are lost, as they would be on Twitch.
+    if (!m_channelOrder.empty()) emitChat(lines);
+
+    m_tickTimer.expires_after(kTick);
+    m_tickTimer.async_wait([this](boost::system::error_code ec) {
+        if (!ec && !m_stopped) tick();
+    });
+}
+
+void StandInServer::emitChat(std::size_t lines) {
+    std::uniform_int_distribution<unsigned> pickUser(0, std::max(1u, m_options.users) - 1);
+    std::uniform_real_distribution<double> roll(0.0, 1.0);
+    std::string user;
+    std::string text;
+
+    for (std::size_t i = 0; i < lines; ++i) {
+        const std::string& channel = m_channelOrder[m_nextChannel++ % m_channelOrder.size()];
+        if (!m_replay.empty()) {
+            const auto& entry = m_replay[m_nextReplay++ % m_replay.size()];
+            user = entry.first;
+            text = entry.second;
+        }
+        else {
+            user = "user" + std::to_string(pickUser(m_rng));
+            if (roll(m_rng) < m_options.commandMix) {
+                text = "!join";
+            }
+            else {
+                std::uint64_t seq = m_seq++;
+                std::string word = LatencyProbe::guessWord(seq);
+                text = roll(m_rng) < m_options.bangMix ? "!guess " + word : word;
+                if (m_probe && m_probe->ready() && channel == m_probe->channel())
+                    m_probe->sent(seq, std::chrono::steady_clock::now());
+            }
+        }
+
+        std::string line = chatLine(channel, user, text);
+        for (const ConnPtr& conn : m_members[channel]) queue(conn, line);
+        ++m_stats.chatLines;
+    }
+}
+
+std::string StandInServer::chatLine(const std::string& channel, std::string_view user, std::string_view text) {
+    std::string login = lower(user);
+    auto sentMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::string line;
+    line.reserve(256 + text.size());
+    line += "@badge-info=;badges=;color=;display-name=";
+    line += user;
+    line += ";emotes=;first-msg=0;flags=;id=standin-";
+    line += std::to_string(m_stats.chatLines);
+    line += ";mod=0;returning-chatter=0;room-id=1;subscriber=0;tmi-sent-ts=";
+    line += std::to_string(sentMs);
+    line += ";turbo=0;user-id=1;user-type= :";
+    line += login + "!" + login + "@" + login + ".tmi.twitch.tv PRIVMSG ";
+    line += channel;
+    line += " :";
+    line += text;
+    return line;
+}
+
+void StandInServer::pingAll() {
+    for (const ConnPtr& conn : m_conns)
+        if (conn->welcomed) queue(conn, "PING :" + std::string(kServer));
+}
+
+void StandInServer::reconnectAll() {
+    // Like a Twitch server going down for maintenance: every client is
+    // warned, then cut off once the grace period is over.
+    auto doomed = std::make_shared<std::vector<ConnPtr>>();
+    for (const ConnPtr& conn : m_conns) {
+        if (!conn->welcomed) continue;
+        queue(conn, ":" + std::string(kServer) + " RECONNECT");
+        doomed->push_back(conn);
+        ++m_stats.reconnectsSent;
+    }
+    auto timer = std::make_shared<boost::asio::steady_timer>(m_io, m_options.reconnectGrace);
+    timer->async_wait([this, timer, doomed](boost::system::error_code ec) {
+        if (ec || m_stopped) return;
+        for (const ConnPtr& conn : *doomed) close(conn);
+    });
+}
+
+void StandInServer::dropOne() {
+    if (m_conns.empty()) return;
+    std::uniform_int_distribution<std::size_t> pick(0, m_conns.size() - 1);
+    ConnPtr conn = m_conns[pick(m_rng)];
+    std::cout << "Dropping " << (conn->nick.empty() ? "an unregistered connection" : conn->nick)
+        << " (" << conn->channels.size() << " channels)\n";
+    ++m_stats.dropped;
+    close(conn);
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "standInOptions.h"
+
+class LatencyProbe;
+struct IrcMessage;
+
+struct StandInStats {
+    std::size_t connections = 0;
+    std::size_t channels = 0;       // joined by at least one connection
+    std::uint64_t chatLines = 0;    // generated, once per channel
+    std::uint64_t linesOut = 0;     // written, once per joined connection
+    std::uint64_t bytesOut = 0;
+    std::uint64_t botLines = 0;     // lines read from the bots
+    std::uint64_t joins = 0;
+    std::uint64_t botChat = 0;      // PRIVMSG from the bots
+    std::uint64_t joinsOverLimit = 0; // JOINs past 20 per 10 s for one nick
+    std::uint64_t chatOverLimit = 0;  // PRIVMSGs past 20 per 30 s for one nick
+    std::uint64_t reconnectsSent = 0;
+    std::uint64_t dropped = 0;      // closed by --drop-every
+    std::uint64_t slowClosed = 0;   // closed past maxQueuedBytes
+};
+
+// Enough of Twitch's IRC dialect for TwitchClient: CAP, PASS/NICK with the
+// 001-376 welcome, JOIN/PART with their echoes, PING/PONG, tagged PRIVMSG
+// chat and RECONNECT. Chat is synthesized (or replayed) at a fixed rate and
+// fanned out to every connection in the channel, like Twitch does.
+//
+// Single-threaded: everything runs on the io_context it is given, so
+// nothing here locks.
+class StandInServer {
+public:
+    StandInServer(boost::asio::io_context& io, const StandInOptions& options, LatencyProbe* probe);
+
+    // False if the replay file or the listening socket could not be opened.
+    bool start();
+    void stop();
+    const StandInStats& stats();
+
+private:
+    struct Conn {
+        explicit Conn(boost::asio::ip::tcp::socket s) : socket(std::move(s)) {}
+
+        boost::asio::ip::tcp::socket socket;
+        boost::asio::streambuf buffer;
+        std::string pending;  // lines waiting for the write in flight
+        std::string inflight;
+        bool writing = false;
+        bool tags = false;    // CAP twitch.tv/tags acknowledged
+        bool welcomed = false;
+        bool closed = false;
+        bool slow = false;    // too far behind; closing
+        std::string nick;
+        std::vector<std::string> channels;
+    };
+    using ConnPtr = std::shared_ptr<Conn>;
+
+    // Sends per nick, for the Twitch limit counters.
+    struct Window {
+        std::deque<std::chrono::steady_clock::time_point> joins;
+        std::deque<std::chrono::steady_clock::time_point> chat;
+    };
+
+    void doAccept();
+    void doRead(const ConnPtr& conn);
+    void handleLine(const ConnPtr& conn, const IrcMessage& msg);
+    void join(const ConnPtr& conn, const std::string& channel);
+    void part(const ConnPtr& conn, const std::string& channel);
+    void queue(const ConnPtr& conn, std::string_view line); // line without "\r\n"
+    void flush(const ConnPtr& conn);
+    void close(const ConnPtr& conn);
+
+    void tick();
+    void emitChat(std::size_t lines);
+    std::string chatLine(const std::string& channel, std::string_view user, std::string_view text);
+    void pingAll();
+    void reconnectAll();
+    void dropOne();
+    void every(boost::asio::steady_timer& timer, std::chrono::seconds period, void (StandInServer::*fn)());
+
+    boost::asio::io_context& m_io;
+    const StandInOptions& m_options;
+    LatencyProbe* m_probe;
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    boost::asio::steady_timer m_tickTimer;
+    boost::asio::steady_timer m_pingTimer;
+    boost::asio::steady_timer m_reconnectTimer;
+    boost::asio::steady_timer m_dropTimer;
+    bool m_stopped = false;
+
+    std::vector<ConnPtr> m_conns;
+    std::unordered_map<std::string, std::vector<ConnPtr>> m_members; // channel -> connections in it
+    std::vector<std::string> m_channelOrder; // round-robin over m_members
+    std::size_t m_nextChannel = 0;
+    std::unordered_map<std::string, Window> m_windows; // by nick
+
+    std::vector<std::pair<std::string, std::string>> m_replay; // user, text
+    std::size_t m_nextReplay = 0;
+    std::mt19937 m_rng{ std::random_device{}() };
+    std::chrono::steady_clock::time_point m_lastTick;
+    double m_credit = 0; // lines owed to the rate
+    std::uint64_t m_seq = 0;
+
+    StandInStats m_stats;
+};
@@ -0,0 +1,181 @@
+#include "canvasRaster.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GUESSIO_RASTER_SSE2 1
+#endif
+
+// Times CanvasRaster against stroke counts and checks that the SSE2 span
+// fill and the scalar fallback paint the same pixels, e.g.
+//
+//   RasterBench --strokes 100,1000,10000 --seed 7
+//
+// draws the same random strokes twice per count, once per path, hashes
+// every pixel() of each raster and compares the hashes and the PNGs. The
+// PNG encode is timed too, as a checkpoint job pays for it once per raster.
+
+namespace {
+struct Options {
+    std::vector<std::size_t> strokeCounts = { 100, 1000, 10000 };
+    int width = 1280; // CheckpointOptions' default canvas
+    int height = 720;
+    std::uint32_t seed = 1;
+};
+
+void usage() {
+    std::cout <<
+        "usage: RasterBench [options]\n"
+        "  --strokes N,N,...  stroke counts to draw (100,1000,10000)\n"
+        "  --size WxH         canvas size (1280x720)\n"
+        "  --seed N           stroke seed (1)\n";
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            std::exit(0);
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--strokes") {
+                options.strokeCounts.clear();
+                std::istringstream in(value);
+                for (std::string n; std::getline(in, n, ',');) options.strokeCounts.push_back(std::stoul(n));
+            }
+            else if (arg == "--size") {
+                std::size_t x = value.find('x');
+                if (x == std::string::npos) throw std::invalid_argument(value);
+                options.width = std::stoi(value.substr(0, x));
+                options.height = std::stoi(value.substr(x + 1));
+            }
+            else if (arg == "--seed") options.seed = static_cast<std::uint32_t>(std::stoul(value));
+            else {
+                std::cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Bad value for " << arg << ": " << value << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Stroke {
+    std::uint32_t rgb;
+    float width;
+    std::vector<float> xs, ys;
+};
+
+// Freehand-looking strokes: a random walk with momentum, widths across
+// StrokeStore's 1..64 range, some dots, some running off the canvas.
+std::vector<Stroke> randomStrokes(std::size_t count, const Options& options, std::mt19937& rng) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<Stroke> strokes(count);
+    for (Stroke& s : strokes) {
+        s.rgb = rng() & 0xFFFFFF;
+        s.width = unit(rng) < 0.8f ? 1.0f + 11.0f * unit(rng) : 1.0f + 63.0f * unit(rng);
+        std::size_t points = unit(rng) < 0.05f ? 1 : 2 + rng() % 120;
+        float x = -40.0f + (float(options.width) + 80.0f) * unit(rng);
+        float y = -40.0f + (float(options.height) + 80.0f) * unit(rng);
+        float vx = 0, vy = 0;
+        for (std::size_t i = 0; i < points; ++i) {
+            s.xs.push_back(x);
+            s.ys.push_back(y);
+            vx = 0.8f * vx + 6.0f * (unit(rng) - 0.5f);
+            vy = 0.8f * vy + 6.0f * (unit(rng) - 0.5f);
+            x += vx;
+            y += vy;
+        }
+    }
+    return strokes;
+}
+
+// FNV-1a over every pixel, read back through pixel().
+std::uint64_t pixelHash(const CanvasRaster& raster) {
+    std::uint64_t h = 14695981039346656037ull;
+    for (int y = 0; y < raster.height(); ++y) {
+        for (int x = 0; x < raster.width(); ++x) {
+            std::uint32_t p = raster.pixel(x, y);
+            for (int b = 0; b < 3; ++b) {
+                h ^= (p >> (8 * b)) & 0xFF;
+                h *= 1099511628211ull;
+            }
+        }
+    }
+    return h;
+}
+
+struct Run {
+    double drawMs = 0;
+    double pngMs = 0;
+    std::uint64_t hash = 0;
+    std::string png;
+};
+
+Run draw(const std::vector<Stroke>& strokes, const Options& options, bool simd) {
+    CanvasRaster::setSimdEnabled(simd);
+    CanvasRaster raster(options.width, options.height);
+    auto started = std::chrono::steady_clock::now();
+    for (const Stroke& s : strokes) raster.drawStroke(s.rgb, s.width, s.xs.data(), s.ys.data(), s.xs.size());
+    Run run;
+    run.drawMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    run.hash = pixelHash(raster);
+    started = std::chrono::steady_clock::now();
+    run.png = raster.encodePng();
+    run.pngMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    CanvasRaster::setSimdEnabled(true);
+    return run;
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+#ifdef GUESSIO_RASTER_SSE2
+    std::cout << "SSE2 compiled in; " << options.width << "x" << options.height << " canvas\n";
+#else
+    std::cout << "SSE2 not compiled in, both runs are scalar; " << options.width << "x" << options.height << " canvas\n";
+#endif
+
+    int mismatches = 0;
+    for (std::size_t count : options.strokeCounts) {
+        std::mt19937 rng(options.seed);
+        std::vector<Stroke> strokes = randomStrokes(count, options, rng);
+        Run simd = draw(strokes, options, true);
+        Run scalar = draw(strokes, options, false);
+        bool same = simd.hash == scalar.hash && simd.png == scalar.png;
+        if (!same) ++mismatches;
+
+        char line[256];
+        std::snprintf(line, sizeof(line),
+            "%7zu strokes  sse2 %8.2f ms  scalar %8.2f ms  x%.2f  hash %016llx %s %016llx  png %6.2f ms %zu bytes%s",
+            count, simd.drawMs, scalar.drawMs, simd.drawMs > 0 ? scalar.drawMs / simd.drawMs : 0.0,
+            static_cast<unsigned long long>(simd.hash), simd.hash == scalar.hash ? "==" : "!=",
+            static_cast<unsigned long long>(scalar.hash), simd.pngMs, simd.png.size(), simd.png == scalar.png ? "" : " (PNGs differ)");
+        std::cout << line << "\n";
+    }
+    if (mismatches) {
+        std::cerr << mismatches << " stroke counts gave different pixels\n";
+        return 1;
+    }
+    return 0;
+}
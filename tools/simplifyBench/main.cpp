@@ -0,0 +1,196 @@
+#include "strokeSimplify.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Checks that StrokeSimplify's SSE2 farthest-point scan and its scalar
+// fallback keep the same points, and times both, e.g.
+//
+//   SimplifyBench --strokes 20000 --seed 3
+//
+// simplifies synthetic pointer strokes at several tolerance/minDistance
+// settings, then a batch of tie-heavy strokes (grid points, repeats,
+// straight lines) where the lowest-index tie break decides what is kept.
+
+namespace {
+struct Options {
+    std::size_t strokes = 20000;
+    std::uint32_t seed = 1;
+};
+
+void usage() {
+    std::cout <<
+        "usage: SimplifyBench [options]\n"
+        "  --strokes N       synthetic pointer strokes (20000)\n"
+        "  --seed N          stroke seed (1)\n";
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            usage();
+            std::exit(0);
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--strokes") options.strokes = std::stoul(value);
+            else if (arg == "--seed") options.seed = static_cast<std::uint32_t>(std::stoul(value));
+            else {
+                std::cerr << "Unknown option " << arg << "\n";
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Bad value for " << arg << ": " << value << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// All strokes back to back, as StrokeStore keeps them: SoA coordinates and
+// each stroke's first point and point count.
+struct Strokes {
+    std::vector<float> xs, ys;
+    std::vector<std::size_t> starts, counts;
+
+    std::size_t points() const { return xs.size(); }
+};
+
+// Pointer samples 1-3 px apart along a wandering path, with 0.3 px jitter.
+Strokes pointerStrokes(std::size_t count, std::mt19937& rng) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> jitter(0.0f, 0.3f);
+    Strokes s;
+    for (std::size_t n = 0; n < count; ++n) {
+        std::size_t points = 3 + rng() % 440;
+        s.starts.push_back(s.xs.size());
+        s.counts.push_back(points);
+        float x = 1280.0f * unit(rng), y = 720.0f * unit(rng);
+        float heading = 6.2831853f * unit(rng), turn = 0;
+        for (std::size_t i = 0; i < points; ++i) {
+            s.xs.push_back(x + jitter(rng));
+            s.ys.push_back(y + jitter(rng));
+            turn = 0.9f * turn + 0.08f * (unit(rng) - 0.5f);
+            heading += turn;
+            float step = 1.0f + 2.0f * unit(rng);
+            x += step * std::cos(heading);
+            y += step * std::sin(heading);
+        }
+    }
+    return s;
+}
+
+// Short strokes on a coarse integer grid, with repeated points and straight
+// runs, so many points sit at exactly the same distance from a segment.
+Strokes tieStrokes(std::size_t count, std::mt19937& rng) {
+    Strokes s;
+    for (std::size_t n = 0; n < count; ++n) {
+        std::size_t points = 3 + rng() % 40;
+        s.starts.push_back(s.xs.size());
+        s.counts.push_back(points);
+        unsigned shape = rng() % 3;
+        for (std::size_t i = 0; i < points; ++i) {
+            float x, y;
+            if (shape == 0) { x = float(rng() % 4); y = float(rng() % 4); }           // grid
+            else if (shape == 1) { x = float(i % 2 ? 0 : 3); y = float(i % 3 ? 1 : -1); } // zigzag, repeats
+            else { x = float(i); y = float(i % 4 == 2 ? 1 : 0); }                     // line with equal bumps
+            s.xs.push_back(x);
+            s.ys.push_back(y);
+        }
+    }
+    return s;
+}
+
+struct Result {
+    Strokes kept;
+    double ms = 0;
+};
+
+Result simplifyAll(const Strokes& in, const SimplifyOptions& options, bool simd) {
+    StrokeSimplify::setSimdEnabled(simd);
+    Result r;
+    r.kept = in;
+    auto started = std::chrono::steady_clock::now();
+    for (std::size_t n = 0; n < in.starts.size(); ++n) {
+        std::size_t start = in.starts[n];
+        r.kept.counts[n] = StrokeSimplify::simplify(r.kept.xs.data() + start, r.kept.ys.data() + start, in.counts[n], options);
+    }
+    r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    StrokeSimplify::setSimdEnabled(true);
+    return r;
+}
+
+std::size_t keptPoints(const Strokes& s) {
+    std::size_t total = 0;
+    for (std::size_t c : s.counts) total += c;
+    return total;
+}
+
+// Bit-for-bit, only over each stroke's kept prefix.
+bool sameKept(const Strokes& a, const Strokes& b) {
+    if (a.counts != b.counts) return false;
+    for (std::size_t n = 0; n < a.starts.size(); ++n) {
+        std::size_t start = a.starts[n], bytes = a.counts[n] * sizeof(float);
+        if (std::memcmp(a.xs.data() + start, b.xs.data() + start, bytes) != 0) return false;
+        if (std::memcmp(a.ys.data() + start, b.ys.data() + start, bytes) != 0) return false;
+    }
+    return true;
+}
+
+int compare(const char* label, const Strokes& strokes, const SimplifyOptions& options) {
+    Result simd = simplifyAll(strokes, options, true);
+    Result scalar = simplifyAll(strokes, options, false);
+    bool same = sameKept(simd.kept, scalar.kept);
+    char line[200];
+    std::snprintf(line, sizeof(line), "%-8s %5.2f / %-5.2f  kept %5.1f%%  sse2 %8.2f ms  scalar %8.2f ms  %s",
+        label, options.tolerance, options.minDistance,
+        100.0 * static_cast<double>(keptPoints(simd.kept)) / static_cast<double>(strokes.points()),
+        simd.ms, scalar.ms, same ? "same points" : "POINTS DIFFER");
+    std::cout << line << "\n";
+    return same ? 0 : 1;
+}
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+#if !(defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    std::cout << "SSE2 not compiled in, both runs are scalar\n";
+#endif
+
+    std::mt19937 rng(options.seed);
+    Strokes pointer = pointerStrokes(options.strokes, rng);
+    Strokes ties = tieStrokes(options.strokes, rng);
+    std::cout << pointer.starts.size() << " pointer strokes, " << pointer.points() << " points; "
+        << ties.starts.size() << " tie strokes, " << ties.points() << " points\n"
+        << "         tolerance / minDistance\n";
+
+    static const SimplifyOptions settings[] = {
+        { 0.5f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 2.0f, 1.0f }, { 4.0f, 0.0f },
+    };
+    int mismatches = 0;
+    for (const SimplifyOptions& s : settings) mismatches += compare("pointer", pointer, s);
+    for (const SimplifyOptions& s : { SimplifyOptions{ 0.1f, 0.0f }, SimplifyOptions{ 0.5f, 0.0f }, SimplifyOptions{ 1.0f, 1.0f } })
+        mismatches += compare("ties", ties, s);
+    if (mismatches) {
+        std::cerr << mismatches << " settings kept different points\n";
+        return 1;
+    }
+    return 0;
+}